@@ -4,13 +4,100 @@
 #include <string.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <sched.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
 
-// 定义页面置换算法类型
-typedef enum {
-    ALG_FIFO,
-    ALG_LRU,
-    ALG_OPT
-} Algorithm;
+typedef struct Simulator Simulator;
+
+// 页面置换策略接口。每个策略有自己的状态（由create创建），模拟器在访问路径上调用：
+// 命中时on_hit；缺页且没有空闲页框时先choose_victim选出页框，再on_evict通知其中的
+// 页面被换出；新页面装入页框后on_miss。next_use为该页面下一次被访问的位置，仅OPT使用
+typedef struct {
+    const char *name;       // 命令行中的算法名
+    const char *title;      // 输出中显示的算法名
+    bool needs_next_use;    // 需要预先计算每次访问的下次使用位置
+    bool needs_sequence;    // 需要内存中完整的访问序列（不支持trace回放）
+    void *(*create)(Simulator *sim);
+    void (*destroy)(void *state);
+    void (*on_hit)(void *state, int frame_index, int page_id, long long next_use);
+    void (*on_miss)(void *state, int frame_index, int page_id, long long next_use);
+    int (*choose_victim)(void *state, int page_id);
+    void (*on_evict)(void *state, int frame_index, int page_id);
+} PolicyOps;
+
+// 预取器接口。缺页时以及第一次命中预取进来的页面时调用on_access（fault区分两种情况），
+// 预取器把要预取的页号写入pages并返回个数（不超过max），已在内存中的页面由模拟器跳过
+typedef struct {
+    const char *name;       // 命令行中的预取器名
+    const char *title;      // 输出中显示的预取器名
+    void *(*create)(Simulator *sim);
+    void (*destroy)(void *state);
+    int (*on_access)(void *state, int page_id, bool fault, int *pages, int max);
+} PrefetchOps;
+
+// 以数组下标为节点的双向链表的表头
+typedef struct {
+    int head;   // 最近加入的节点
+    int tail;   // 最早加入的节点
+    int size;
+} IndexList;
+
+// 换页I/O代价模型（时间单位为微秒）。磁盘一次只处理一个请求：缺页读入和
+// 脏页写回排队使用同一个磁盘，后台刷写占用磁盘时会推迟之后的缺页读入
+typedef struct {
+    double mem_us;          // 命中时一次内存访问的时间
+    double read_us;         // 读入一页的时间
+    double write_us;        // 写回一页的时间
+    int flush_queue;        // 后台刷写队列长度（0表示不启用，脏页只在换出时同步写回）
+} DiskModel;
+
+// 地址转换模型：组相联TLB（LRU替换）和全相联的页表遍历缓存
+typedef struct {
+    int l1_entries;         // L1 TLB（4KB页）项数
+    int l1_ways;
+    int l2_entries;         // L2 TLB项数（4KB页与2MB页共用）
+    int l2_ways;
+    int pwc_entries;        // 每级页表遍历缓存的项数
+    double huge_ratio;      // 由2MB大页映射的2MB区域比例（0表示只用4KB页）
+} TlbModel;
+
+// CPU缓存层次模型，写法见-C
+#define CACHE_MAX_LEVELS 4
+#define CACHE_LRU 0
+#define CACHE_FIFO 1
+#define CACHE_PLRU 2        // 树形伪LRU（路数须为2的幂）
+#define CACHE_SRRIP 3       // 2位RRPV的静态重引用间隔预测
+#define CACHE_RANDOM 4
+#define NUM_CACHE_POLICIES 5
+#define CACHE_NINE 0        // 既不包含也不排他：缺失时装入，换出时不影响其他级
+#define CACHE_INCLUSIVE 1   // 包含上级：换出时使上级中的同一行失效
+#define CACHE_EXCLUSIVE 2   // 排他：只装入上一级换出的行，命中时行移到上级
+
+typedef struct {
+    long long size;         // 容量（字节）
+    int ways;
+    int policy;             // CACHE_LRU等
+    int inclusion;          // CACHE_NINE等
+} CacheLevelSpec;
+
+typedef struct {
+    int num_levels;         // 0表示不进行缓存模拟
+    int line_size;          // 缓存行大小（字节），各级相同
+    CacheLevelSpec levels[CACHE_MAX_LEVELS];
+} CacheModel;
 
 // 配置参数
 typedef struct {
@@ -18,69 +105,475 @@ typedef struct {
     int num_frames;         // 页框数量
     int total_instructions; // 总指令数
     int num_pages;          // 总页数
-    Algorithm algorithm;    // 使用的算法
-    int access_pattern;     // 访问模式：0-顺序，1-跳转，2-分支，3-循环，4-局部性随机
+    const PolicyOps *policy; // 使用的置换策略
+    const PrefetchOps *prefetcher; // 缺页时的预取器（NULL表示不预取）
+    int prefetch_window;    // 每次最多预取的页数（顺序预读的最大窗口）
+    int access_pattern;     // 访问模式：0-顺序，1-跳转，2-分支，3-循环，4-局部性随机，5-Zipf，6-冷热
     int *access_sequence;   // 访问序列
-    int seq_length;         // 访问序列长度
+    long long *next_use;    // 预先计算的下次使用位置（参数扫描时共享，NULL表示模拟前计算）
+    long long seq_length;   // 访问序列长度
     float locality_factor;  // 局部性因子（0-1），越大局部性越强
+    double zipf_exponent;   // Zipf访问模式的指数s
+    uint64_t seed;          // 生成访问序列的随机种子
+    double write_ratio;     // 生成的访问序列中写访问的比例
+    DiskModel disk;         // 换页I/O的代价模型
+    TlbModel tlb;           // 地址转换模式的TLB与页表遍历缓存参数
+    CacheModel cache;       // 缓存模拟模式的缓存层次（num_levels为0表示不启用）
+    bool mrc_mode;          // 一次扫描输出所有页框数下的LRU缺页曲线
+    bool tlb_mode;          // 模拟地址转换（TLB与四级页表遍历），不模拟页面置换
+    bool quiet;             // 不打印模拟过程（参数扫描等批量运行时使用）
+    double sample_rate;     // SHARDS采样率（1表示不采样，计算精确曲线）
+    int max_samples;        // SHARDS固定大小模式的采样页面上限（0表示固定采样率）
+    const char *trace_path;  // 回放的二进制trace文件（NULL表示使用生成的访问序列）
+    const char *export_path; // 将生成的访问序列导出为trace文件
+    long long report_interval; // 流式输入：每隔多少次访问输出一次窗口缺页率
+    bool pipelined;         // 流水线模式：边生成访问序列边模拟，不保存整个序列
+    int real_mode;          // 真实内存回放的换出方式REAL_*，0表示不回放
 } Config;
 
-// 页框结构
+#define NUM_PATTERNS 7
+
+// 伪随机数生成器状态，见rng_init
+#define RNG_LANES 4
+#define RNG_BLOCK 256
+
 typedef struct {
-    int page_id;    // 页号
-    int last_used;  // 最近使用时间（LRU用）
-    int load_time;  // 加载时间（FIFO用）
-    bool valid;     // 是否有效
-} Frame;
+    uint64_t s[4][RNG_LANES];   // RNG_LANES路xoshiro256**的状态，按分量存放
+    uint64_t block[RNG_BLOCK];  // 整块生成的随机数
+    int pos;                    // block中下一个未使用的位置
+} Rng;
 
-// 模拟器结构
+// 访问序列生成器的状态，可以按块续写，见seqgen_init
+#define SEQGEN_LOOPS 5
+
+typedef struct {
+    const Config *config;
+    Rng rng;
+    long long pos;              // 已生成的访问数
+    int current;                // 模式1/2/4：下一次访问的指令
+    uint64_t p;                 // 模式1-4使用的概率（prob32）
+    int loop_start[SEQGEN_LOOPS]; // 模式3：各循环区域的起点
+    int loop_size;
+    int loop_pos;               // 模式3：当前一圈中已访问的指令数
+    int current_loop;
+    uint64_t *prob;             // 模式5/6：别名表
+    int *alias;
+    int *perm;                  // 模式5/6：页面排列
+} SeqGen;
+
+// 页框表，按字段分别存放（结构数组），扫描类策略只读取一个连续的64字节对齐数组
+#define FRAME_ALIGN 64
+
+typedef struct {
+    int *page_id;           // 页号
+    long long *last_used;   // 最近使用时间（LRU用）
+    long long *load_time;   // 加载时间（FIFO用）
+    uint64_t *valid;        // 有效位图
+    uint64_t *dirty;        // 脏位图：装入后被写过且尚未写回
+    uint64_t *prefetched;   // 预取位图：由预取装入且尚未被访问（仅启用预取时分配）
+} FrameTable;
+
+// 模拟时钟与磁盘状态，见DiskModel
+typedef struct {
+    double clock_us;        // 当前模拟时间
+    double disk_free_us;    // 磁盘完成当前请求的时刻
+    double stall_us;        // 缺页时等待磁盘的总时间
+    long long writes;       // 写访问次数
+    long long writebacks;   // 换出脏页时的同步写回次数
+    long long flushes;      // 后台刷写次数
+    int *flush_frame;       // 后台刷写环形队列：页框和页号
+    int *flush_page;
+    int flush_head;
+    int flush_count;
+} IoState;
+
+// 真实内存回放：模拟页面换出时对映射区域中对应的系统页调用的madvise
+#define REAL_DONTNEED 1 // 丢弃页面，再次访问时次缺页（分配清零的新页）
+#define REAL_PAGEOUT 2  // 回收到交换区，再次访问时主缺页（需要交换分区）
+
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21 // Linux 5.4起支持，旧头文件中没有定义
+#endif
+
+typedef struct {
+    char *base;             // 映射区域，NULL表示不进行真实内存回放
+    size_t length;
+    long page_bytes;        // 系统页大小，每个模拟页面占一页
+    int advice;             // 换出时使用的madvise
+    int sink;               // 读访问的结果，避免读被优化掉
+    long long fault_touches; // 模拟缺页的访问次数
+    double fault_ns;        // 模拟缺页的访问在真实内存上的总耗时
+    long long evictions;    // madvise次数
+    long long evict_failures; // madvise失败的次数
+    int evict_errno;        // 第一次失败的errno
+    double evict_ns;
+    long minflt;            // 回放期间进程的次缺页/主缺页数
+    long majflt;
+    struct timespec start;
+    double seconds;         // 回放用时
+    long long resident;     // 回放结束时区域中驻留的页数（mincore）
+} RealMemory;
+
+// 二进制trace文件格式：TraceHeader + num_records条uint64记录（小端）。
+// 页号记录直接给出页号；地址记录按page_size换算为页号。记录的最高位为写访问标志
+#define TRACE_MAGIC "PGTRACE"
+#define TRACE_VERSION 1
+#define TRACE_RECORD_PAGE 0
+#define TRACE_RECORD_ADDR 1
+#define TRACE_WRITE_FLAG (1ULL << 63)
+#define INSN_BYTES 4                    // 生成的访问序列中每条指令的字节数，导出和缓存模拟按此换算为字节地址
+#define TRACE_WINDOW_RECORDS (1 << 20)  // 每次映射的记录数（8MB）
+#define MRC_MIN_CHUNK (1 << 22)         // 并行计算栈距离时每块的最少访问数
+#define STREAM_BATCH_RECORDS (1 << 16)  // 流式输入每次read的记录数（512KB）
+#define PIPE_CHUNK (1 << 16)            // 流水线模式每块的访问数（256KB）
+#define PIPE_SLOTS 8                    // 流水线环形缓冲区的块数
+
+typedef struct {
+    char magic[8];          // "PGTRACE\0"
+    uint32_t version;       // TRACE_VERSION
+    uint32_t record_type;   // TRACE_RECORD_PAGE / TRACE_RECORD_ADDR
+    uint64_t page_size;     // 地址记录的页大小，0表示使用-p指定的页大小
+    uint64_t num_records;   // 记录数
+} TraceHeader;
+
+// trace中的原始页号（如虚拟地址换算出的页号）到连续编号0..N-1的映射，编号保持原始页号
+// 的大小顺序，顺序预取器看到的“下一页”是trace中访问过的下一个页面。开放寻址哈希表，
+// 由trace_scan_pages建立
+#define PAGEID_EMPTY UINT64_MAX
+
+typedef struct {
+    uint64_t *keys;         // 原始页号，PAGEID_EMPTY表示空槽
+    int *values;            // 连续编号
+    size_t mask;
+    int size;
+} PageIdMap;
+
+// 按窗口映射的trace文件，整个文件不会一次性读入内存
 typedef struct {
+    int fd;
+    int record_type;
+    long long page_size;    // 地址记录换算页号使用的页大小
+    long long num_records;
+    void *map_base;         // 当前映射窗口（按系统页对齐）
+    size_t map_len;
+    const PageIdMap *ids;   // 原始页号的压缩编号（NULL表示页号本来就是0..N-1，直接使用）
+} TraceFile;
+
+// 预取统计
+typedef struct {
+    long long issued;       // 预取装入的页数
+    long long useful;       // 预取后在换出前被访问的页数
+    long long unused;       // 预取后未被访问就被换出的页数
+    long long pollution;    // 被预取挤出、之后又缺页的次数
+    uint64_t *evicted;      // 按页号的位图：被预取挤出且尚未再次缺页
+    double *ready_us;       // 按页框：预取读入完成的时刻，读入完成前访问需要等待
+    int *pages;             // 预取器输出的页号
+    int max;                // 每次最多预取的页数
+    IndexList buffer;       // 预取缓冲：已预取、尚未访问的页框，尾部为最早预取的
+    int *buf_prev;          // 预取缓冲链表（按页框下标）
+    int *buf_next;
+    int capacity;           // 预取缓冲最多容纳的页框数
+} PrefetchStats;
+
+// 模拟器结构
+struct Simulator {
     Config config;
     int *large_array;   // 大数组A模拟进程
-    Frame *frames;      // 页框数组
+    bool owns_sequence; // 访问序列由本模拟器分配（参数扫描时多个模拟器共享同一序列）
+    FrameTable frames;  // 页框表
     int *page_table;    // 页表
-    int page_faults;    // 缺页次数
-    int current_time;   // 当前时间
-} Simulator;
+    long long page_faults;  // 缺页次数
+    long long current_time; // 当前时间
+    int used_frames;    // 已使用的页框数（页框按下标顺序装入，不会再空出）
+    void *policy_state; // 置换策略的私有状态
+    long long *next_use; // OPT：每次访问的页面下一次被访问的位置（seq_length表示不再访问）
+    bool owns_next_use; // 下次使用位置由本模拟器分配并计算
+    int next_use_fd;    // trace模式共享的下次使用位置文件（-1表示由simulate_trace计算）
+    TraceFile *trace;   // trace回放模式的输入（NULL表示使用内存中的访问序列）
+    IoState io;         // 换页I/O代价
+    void *prefetch_state; // 预取器的私有状态
+    PrefetchStats prefetch; // 预取统计
+    RealMemory real;    // 真实内存回放（代替大数组A）
+};
+
+// SHARDS近似缺页曲线状态。页号哈希值模SHARDS_MODULUS小于threshold的页面被采样，
+// 采样页面通过哈希表映射到槽位，栈距离仍用带时间戳压缩的树状数组计算
+#define SHARDS_MODULUS (1ULL << 24)
+#define SHARDS_BINS 1024
+
+typedef struct {
+    uint64_t threshold;     // 采样阈值，采样率为threshold / SHARDS_MODULUS
+    int max_samples;        // 固定大小模式的采样页面上限（0表示固定采样率）
+    int num_samples;        // 当前采样页面数
+    int capacity;           // 槽位数
+    long long *table_keys;  // 开放寻址哈希表：页号（-1表示空）
+    int *table_slots;       // 哈希表：页号对应的槽位
+    int table_cap;
+    long long *slot_page;   // 槽位中的页号
+    uint64_t *slot_hash;    // 槽位中页面的采样哈希值
+    int *slot_stamp;        // 槽位中页面最近一次访问的时间戳
+    int *free_slots;
+    int num_free;
+    int *tree;              // 时间戳树状数组
+    int *owner;             // 时间戳对应的槽位（-1表示已失效）
+    int stamp_cap;
+    int now;
+    int *heap;              // 固定大小模式：按哈希值组织的最大堆
+    int *heap_pos;
+    int heap_size;
+    double *hist;           // 放大后的栈距离直方图，每档bin_width个页框
+    int num_bins;
+    long long bin_width;
+    int num_pages;          // 总页数（0表示未知：trace未扫描，分档随栈距离加倍）
+    long long max_distance; // 页数未知时：见过的最大放大栈距离
+    double cold_misses;     // 加权后的首次访问次数
+    long long accesses;     // 全部访问次数
+    long long sampled_refs; // 被采样的访问次数
+    double weighted_refs;   // 被采样的访问按1/采样率加权后的次数
+} Shards;
+
+// 参数扫描设置，各参数取值列表的写法见-h
+typedef struct {
+    const char *format;         // 结果格式csv/json，NULL表示不进行参数扫描
+    int num_threads;
+    const char *policy_spec;    // -a
+    const char *frames_spec;    // -f
+    const char *pattern_spec;   // -m
+    const char *locality_spec;  // -l
+    const char *sizes_spec;     // -s（仅基准测试使用取值列表）
+} SweepSpec;
+
+// 基准测试设置。未指定-S时用固定种子生成访问序列，保证不同版本之间的基准结果可比
+#define BENCH_SEED 20240601
+
+typedef struct {
+    const char *format;         // 结果格式csv/json，NULL表示不进行基准测试
+    const char *policy_spec;    // -a（默认all）
+    const char *frames_spec;    // -f
+    const char *sizes_spec;     // -s
+} BenchSpec;
+
+// 多进程模拟设置
+#define MULTI_GLOBAL 0  // 全局置换：所有进程共用页框，由-a指定的策略选择置换对象
+#define MULTI_LOCAL 1   // 局部置换：页框平均分给各进程
+#define MULTI_WS 2      // 工作集：进程只保留最近Δ次访问过的页面
+#define MULTI_PFF 3     // 缺页频率：按缺页间隔增减进程的驻留集
+#define NUM_MULTI_MODES 4
+
+static const char *multi_mode_names[] = { "global", "local", "ws", "pff" };
+static const char *multi_mode_titles[] = { "全局置换", "局部置换", "工作集", "缺页频率（PFF）" };
+
+typedef struct {
+    int num_procs;              // 进程数，0表示单进程模拟
+    int mode;                   // MULTI_*
+    long long window;           // 工作集窗口Δ（进程虚拟时间）
+    long long pff_threshold;    // PFF缺页间隔阈值
+    int quantum;                // 时间片（每次调度连续执行的访问次数）
+    const char *pattern_spec;   // 各进程的访问模式（-m，逗号分隔时轮流分配）
+} MultiSpec;
+
+// LRU栈距离计算状态。树状数组在每个页面最近一次访问的时间戳上置1，
+// 时间戳用尽时按先后顺序重新编号，内存只与页数有关而与序列长度无关
+typedef struct {
+    int num_pages;
+    int capacity;           // 时间戳上限
+    int now;                // 下一个时间戳（从1开始）
+    int *tree;              // 树状数组
+    int *owner;             // 时间戳对应的页号（-1表示已失效）
+    int *stamp;             // 页号对应的最近访问时间戳（0表示未访问过）
+    long long *hist;        // hist[d]为栈距离为d的访问次数
+    long long cold_misses;  // 首次访问次数
+} StackDist;
+
+// 地址转换模拟。页号按4KB虚拟页号处理，x86-64四级页表中虚拟页号的第27-35、18-26、
+// 9-17、0-8位依次为PML4、PDPT、PD、PT的下标；2MB大页由PD表项直接映射，遍历少读一级
+#define PT_LEVELS 4
+#define HUGE_PAGE_SHIFT 9       // 2MB大页 = 512个4KB页
+#define TLB_L1_HUGE_ENTRIES 32  // L1 TLB中2MB页的项数
+#define TLB_L1_HUGE_WAYS 4
+
+// 组相联、LRU替换的地址转换缓存（TLB或一级页表遍历缓存）
+typedef struct {
+    int sets;
+    int ways;
+    uint64_t *tags;         // sets*ways项，UINT64_MAX表示空
+    long long *stamp;       // 最近使用时间，空项为0
+    long long hits;
+    long long misses;
+} TlbCache;
+
+typedef struct {
+    uint64_t huge_p32;      // 大页区域比例（2^32定点）
+    TlbCache l1;            // L1 TLB（4KB页）
+    TlbCache l1_huge;       // L1 TLB（2MB页）
+    TlbCache l2;            // L2 TLB，4KB页与2MB页共用
+    TlbCache pwc[PT_LEVELS - 1]; // 页表遍历缓存：PML4E、PDPTE、PDE（只缓存非叶表项）
+    long long accesses;
+    long long huge_accesses; // 落在大页中的访问次数
+    long long walks;        // 页表遍历次数（L2 TLB缺失）
+    long long walk_refs;    // 页表遍历读取的表项数
+} TlbSim;
+
+// 缓存模拟中的一级缓存。每一路压缩为一个64位字：高56位为标签，第7位为有效位，
+// 低7位为替换状态（LRU/FIFO的次序或SRRIP的RRPV），查找时一次比较即可
+#define CACHE_VALID 0x80ULL
+#define CACHE_STATE_MASK 0x7FULL
+
+typedef struct {
+    int ways;
+    int set_bits;
+    uint64_t set_mask;
+    int policy;
+    int inclusion;
+    uint64_t *lines;        // sets*ways个压缩的行
+    uint64_t *plru;         // 树形伪LRU：每组ways-1个节点位
+    long long accesses;     // 查找次数
+    long long hits;
+    long long fills;        // 装入次数
+    long long evictions;    // 换出有效行的次数
+    long long back_invalidations; // 包含性导致上级失效的行数
+} CacheLevel;
+
+typedef struct {
+    int num_levels;
+    int line_shift;
+    CacheLevel levels[CACHE_MAX_LEVELS];
+    uint64_t rng;           // 随机替换使用的xorshift状态
+    uint64_t last_line;     // 上一次访问的行，一定在L1中
+    long long refs;
+} CacheSim;
 
 // 函数声明
 void init_config(Config *config);
 void init_simulator(Simulator *sim, Config *config);
+void rng_init(Rng *rng, uint64_t seed);
+uint64_t rng_stream_seed(uint64_t seed, uint64_t stream);
 void generate_access_sequence(Simulator *sim);
+void seqgen_init(SeqGen *gen, const Config *config);
+void seqgen_fill(SeqGen *gen, int *seq, long long count);
+void seqgen_free(SeqGen *gen);
 void simulate(Simulator *sim);
+int real_init(Simulator *sim);
+void real_begin(Simulator *sim);
+void real_end(Simulator *sim);
+void real_print(Simulator *sim);
+int simulate_trace(Simulator *sim);
+void access_page(Simulator *sim, int page_id, long long index, long long next_use, bool write);
+bool access_is_write(const Config *config, long long index);
 void print_results(Simulator *sim);
 void cleanup(Simulator *sim);
 
-// 页面置换算法函数
-int fifo_replace(Simulator *sim);
-int lru_replace(Simulator *sim);
-int opt_replace(Simulator *sim, int current_index);
+// 页面置换策略
+const PolicyOps *find_policy(const char *name);
+void print_policy_names(FILE *fp);
+const PrefetchOps *find_prefetcher(const char *name);
+void print_prefetcher_names(FILE *fp);
+void opt_prepare(Simulator *sim);
+int opt_prepare_trace(Simulator *sim);
+
+// 缺页率曲线（LRU栈距离）
+void stackdist_init(StackDist *sd, int num_pages, long long *hist);
+void stackdist_access(StackDist *sd, int page_id);
+void stackdist_free(StackDist *sd);
+int mrc_compute(Simulator *sim, int num_threads, long long *hist, long long *cold_misses);
+void mrc_print(Simulator *sim, const long long *hist, long long cold_misses);
+void shards_init(Shards *sh, double rate, int max_samples, int num_pages);
+void shards_access(Shards *sh, long long page_id);
+void shards_print(Shards *sh, int num_pages);
+void shards_free(Shards *sh);
+void shards_compute(Simulator *sim);
+
+// 地址转换（TLB与页表遍历）
+void tlb_compute(Simulator *sim);
+
+// CPU缓存层次
+int parse_cache_spec(const char *spec, int line_size, CacheModel *model);
+int cache_compute(Simulator *sim);
+
+// 流水线模式
+int run_pipeline(const Config *gen_config, Simulator *sims, int num_sims, int num_threads);
+
+// 参数扫描
+int run_sweep(Config *config, const SweepSpec *spec);
+
+// 性能基准
+int run_bench(Config *config, const BenchSpec *spec);
+
+// 多进程模拟
+int run_multi(Config *config, const MultiSpec *spec);
+
+// 二进制trace文件
+int trace_open(TraceFile *trace, const char *path, int default_page_size);
+int trace_open_stream(TraceFile *trace, const char *path, int default_page_size);
+bool trace_is_stream(const char *path);
+int simulate_stream(Simulator *sim);
+const uint64_t *trace_map(TraceFile *trace, long long start, long long count);
+int trace_scan_pages(TraceFile *trace, PageIdMap *ids, int *num_pages);
+void pageid_free(PageIdMap *ids);
+void trace_close(TraceFile *trace);
+int trace_export(const char *path, const Config *config);
 int find_page_in_frames(Simulator *sim, int page_id);
 void load_page(Simulator *sim, int page_id, int frame_index);
 
 // 辅助函数
 void print_frames(Simulator *sim);
 void print_access_sequence(Simulator *sim);
-void print_progress(int current, int total);
+void print_progress(long long current, long long total);
 
 int main(int argc, char *argv[]) {
-    // 设置随机种子
-    srand(time(NULL));
-    
     // 默认配置
     Config config = {
         .page_size = 10,
         .num_frames = 5,           // 增加默认页框数量
         .total_instructions = 2400,
-        .algorithm = ALG_FIFO,
+        .policy = NULL,
+        .prefetcher = NULL,
+        .prefetch_window = 8,
         .access_pattern = 3,       // 默认使用循环访问，局部性更好
         .seq_length = 1000,        // 减少访问序列长度
-        .locality_factor = 0.8f    // 增加局部性
+        .locality_factor = 0.8f,   // 增加局部性
+        .zipf_exponent = 0.99,
+        .seed = (uint64_t)time(NULL), // 未指定-S时按当前时间，运行时打印以便复现
+        .write_ratio = 0,
+        .disk = { .mem_us = 0.1, .read_us = 100, .write_us = 200, .flush_queue = 0 },
+        .tlb = { .l1_entries = 64, .l1_ways = 4, .l2_entries = 1536, .l2_ways = 12,
+                 .pwc_entries = 32, .huge_ratio = 0 },
+        .mrc_mode = false,
+        .tlb_mode = false,
+        .quiet = false,
+        .sample_rate = 1.0,
+        .max_samples = 0,
+        .trace_path = NULL,
+        .export_path = NULL,
+        .report_interval = 100000,
+        .pipelined = false,
+        .real_mode = 0
+    };
+    
+    SweepSpec sweep = {
+        .format = NULL,
+        .num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN)
+    };
+    
+    BenchSpec bench = {
+        .format = NULL
+    };
+    
+    MultiSpec multi = {
+        .num_procs = 0,
+        .mode = MULTI_GLOBAL,
+        .window = 200,
+        .pff_threshold = 50,
+        .quantum = 100
     };
     
     // 解析命令行参数
+    bool seed_given = false;
+    const char *cache_spec = NULL;
+    int line_size = 64;
+    int stream_pages = 1 << 20;
     int opt;
-    while ((opt = getopt(argc, argv, "p:f:a:m:l:s:h")) != -1) {
+    while ((opt = getopt(argc, argv, "p:f:a:m:l:s:S:Z:w:I:F:A:MR:K:XL:H:C:b:t:i:N:o:gr:W:j:P:G:D:T:q:B:h")) != -1) {
         switch (opt) {
             case 'p':
                 config.page_size = atoi(optarg);
@@ -89,98 +582,536 @@ int main(int argc, char *argv[]) {
                     return 1;
                 }
                 break;
+            // -f/-a/-m/-l在参数扫描模式下可以取多个值，解析完所有选项后再处理
             case 'f':
-                config.num_frames = atoi(optarg);
-                if (config.num_frames <= 0) {
-                    fprintf(stderr, "页框数量必须为正数\n");
-                    return 1;
-                }
+                sweep.frames_spec = optarg;
                 break;
             case 'a':
-                if (strcmp(optarg, "fifo") == 0) {
-                    config.algorithm = ALG_FIFO;
-                } else if (strcmp(optarg, "lru") == 0) {
-                    config.algorithm = ALG_LRU;
-                } else if (strcmp(optarg, "opt") == 0) {
-                    config.algorithm = ALG_OPT;
+                sweep.policy_spec = optarg;
+                break;
+            case 'm':
+                sweep.pattern_spec = optarg;
+                break;
+            case 'l':
+                sweep.locality_spec = optarg;
+                break;
+            case 'g':
+                config.pipelined = true;
+                break;
+            case 'r':
+                if (strcmp(optarg, "dontneed") == 0) {
+                    config.real_mode = REAL_DONTNEED;
+                } else if (strcmp(optarg, "pageout") == 0) {
+                    config.real_mode = REAL_PAGEOUT;
                 } else {
-                    fprintf(stderr, "未知的算法: %s\n", optarg);
-                    fprintf(stderr, "可用算法: fifo, lru, opt\n");
+                    fprintf(stderr, "换出方式必须为dontneed或pageout\n");
                     return 1;
                 }
                 break;
-            case 'm':
-                config.access_pattern = atoi(optarg);
-                if (config.access_pattern < 0 || config.access_pattern > 4) {
-                    fprintf(stderr, "访问模式必须为0-4之间的数字\n");
-                    fprintf(stderr, "0:顺序 1:跳转 2:分支 3:循环 4:局部性随机\n");
+            case 'W':
+                if (strcmp(optarg, "csv") != 0 && strcmp(optarg, "json") != 0) {
+                    fprintf(stderr, "扫描结果格式必须为csv或json\n");
                     return 1;
                 }
+                sweep.format = optarg;
                 break;
-            case 'l':
-                config.locality_factor = atof(optarg);
-                if (config.locality_factor < 0 || config.locality_factor > 1) {
-                    fprintf(stderr, "局部性因子必须在0-1之间\n");
+            case 'j':
+                sweep.num_threads = atoi(optarg);
+                if (sweep.num_threads <= 0) {
+                    fprintf(stderr, "线程数必须为正数\n");
                     return 1;
                 }
                 break;
             case 's':
-                config.seq_length = atoi(optarg);
+                sweep.sizes_spec = optarg;
+                config.seq_length = atoll(optarg);
                 if (config.seq_length <= 0) {
                     fprintf(stderr, "访问序列长度必须为正数\n");
                     return 1;
                 }
                 break;
+            case 'S':
+                config.seed = strtoull(optarg, NULL, 0);
+                seed_given = true;
+                break;
+            case 'Z':
+                config.zipf_exponent = atof(optarg);
+                if (config.zipf_exponent <= 0) {
+                    fprintf(stderr, "Zipf指数必须为正数\n");
+                    return 1;
+                }
+                break;
+            case 'w':
+                config.write_ratio = atof(optarg);
+                if (config.write_ratio < 0 || config.write_ratio > 1) {
+                    fprintf(stderr, "写访问比例必须在0-1之间\n");
+                    return 1;
+                }
+                break;
+            case 'I':
+                if (sscanf(optarg, "%lf,%lf,%lf", &config.disk.mem_us, &config.disk.read_us,
+                           &config.disk.write_us) != 3 ||
+                    config.disk.mem_us < 0 || config.disk.read_us < 0 || config.disk.write_us < 0) {
+                    fprintf(stderr, "I/O代价格式为: 内存访问,读入,写回（微秒）\n");
+                    return 1;
+                }
+                break;
+            case 'F':
+                config.disk.flush_queue = atoi(optarg);
+                if (config.disk.flush_queue < 0) {
+                    fprintf(stderr, "刷写队列长度不能为负数\n");
+                    return 1;
+                }
+                break;
+            case 'A': {
+                // 预取器名[,窗口]
+                char name[32];
+                const char *comma = strchr(optarg, ',');
+                size_t len = comma != NULL ? (size_t)(comma - optarg) : strlen(optarg);
+                snprintf(name, sizeof(name), "%.*s", (int)len, optarg);
+                config.prefetcher = find_prefetcher(name);
+                if (config.prefetcher == NULL) {
+                    fprintf(stderr, "未知的预取器: %s\n", name);
+                    fprintf(stderr, "可用预取器: ");
+                    print_prefetcher_names(stderr);
+                    fprintf(stderr, "\n");
+                    return 1;
+                }
+                if (comma != NULL) {
+                    config.prefetch_window = atoi(comma + 1);
+                    if (config.prefetch_window <= 0) {
+                        fprintf(stderr, "预取窗口必须为正数\n");
+                        return 1;
+                    }
+                }
+                break;
+            }
+            case 'M':
+                config.mrc_mode = true;
+                break;
+            case 'R':
+                config.sample_rate = atof(optarg);
+                if (config.sample_rate <= 0 || config.sample_rate > 1) {
+                    fprintf(stderr, "采样率必须在(0, 1]之间\n");
+                    return 1;
+                }
+                break;
+            case 'K':
+                config.max_samples = atoi(optarg);
+                if (config.max_samples <= 0) {
+                    fprintf(stderr, "采样页面上限必须为正数\n");
+                    return 1;
+                }
+                break;
+            case 'X':
+                config.tlb_mode = true;
+                break;
+            case 'L': {
+                TlbModel *tlb = &config.tlb;
+                if (sscanf(optarg, "%d,%d,%d,%d,%d", &tlb->l1_entries, &tlb->l1_ways,
+                           &tlb->l2_entries, &tlb->l2_ways, &tlb->pwc_entries) != 5 ||
+                    tlb->l1_ways <= 0 || tlb->l2_ways <= 0 || tlb->pwc_entries <= 0 ||
+                    tlb->l1_entries < tlb->l1_ways || tlb->l1_entries % tlb->l1_ways != 0 ||
+                    tlb->l2_entries < tlb->l2_ways || tlb->l2_entries % tlb->l2_ways != 0) {
+                    fprintf(stderr, "TLB参数格式为: L1项数,L1路数,L2项数,L2路数,遍历缓存项数"
+                            "（项数须为路数的整数倍）\n");
+                    return 1;
+                }
+                break;
+            }
+            case 'H':
+                config.tlb.huge_ratio = atof(optarg);
+                if (config.tlb.huge_ratio < 0 || config.tlb.huge_ratio > 1) {
+                    fprintf(stderr, "大页比例必须在0-1之间\n");
+                    return 1;
+                }
+                break;
+            case 'C':
+                cache_spec = optarg;
+                break;
+            case 'b':
+                line_size = atoi(optarg);
+                break;
+            case 't':
+                config.trace_path = optarg;
+                break;
+            case 'i':
+                config.report_interval = atoll(optarg);
+                if (config.report_interval <= 0) {
+                    fprintf(stderr, "输出间隔必须为正数\n");
+                    return 1;
+                }
+                break;
+            case 'N':
+                stream_pages = atoi(optarg);
+                if (stream_pages <= 0) {
+                    fprintf(stderr, "页号上限必须为正数\n");
+                    return 1;
+                }
+                break;
+            case 'o':
+                config.export_path = optarg;
+                break;
+            case 'B':
+                if (strcmp(optarg, "csv") != 0 && strcmp(optarg, "json") != 0) {
+                    fprintf(stderr, "基准测试结果格式必须为csv或json\n");
+                    return 1;
+                }
+                bench.format = optarg;
+                break;
+            case 'P':
+                multi.num_procs = atoi(optarg);
+                if (multi.num_procs <= 0) {
+                    fprintf(stderr, "进程数必须为正数\n");
+                    return 1;
+                }
+                break;
+            case 'G':
+                multi.mode = -1;
+                for (int i = 0; i < NUM_MULTI_MODES; i++) {
+                    if (strcmp(optarg, multi_mode_names[i]) == 0) {
+                        multi.mode = i;
+                    }
+                }
+                if (multi.mode < 0) {
+                    fprintf(stderr, "分配方式必须为global、local、ws或pff\n");
+                    return 1;
+                }
+                break;
+            case 'D':
+                multi.window = atoll(optarg);
+                if (multi.window <= 0) {
+                    fprintf(stderr, "工作集窗口必须为正数\n");
+                    return 1;
+                }
+                break;
+            case 'T':
+                multi.pff_threshold = atoll(optarg);
+                if (multi.pff_threshold <= 0) {
+                    fprintf(stderr, "PFF阈值必须为正数\n");
+                    return 1;
+                }
+                break;
+            case 'q':
+                multi.quantum = atoi(optarg);
+                if (multi.quantum <= 0) {
+                    fprintf(stderr, "时间片必须为正数\n");
+                    return 1;
+                }
+                break;
             case 'h':
                 printf("页面置换算法模拟器\n");
                 printf("用法: %s [选项]\n", argv[0]);
                 printf("选项:\n");
                 printf("  -p <数字>   页面大小（默认: 10）\n");
                 printf("  -f <数字>   页框数量（默认: 5）\n");
-                printf("  -a <算法>   算法: fifo, lru, opt（默认: fifo）\n");
-                printf("  -m <模式>   访问模式: 0-4（默认: 3）\n");
-                printf("              0:顺序 1:跳转 2:分支 3:循环 4:局部性随机\n");
-                printf("  -l <因子>   局部性因子 0-1（默认: 0.8）\n");
+                printf("  -a <算法>   算法（默认: fifo）:\n");
+                printf("              ");
+                print_policy_names(stdout);
+                printf("\n");
+                printf("  -m <模式>   访问模式: 0-6（默认: 3）\n");
+                printf("              0:顺序 1:跳转 2:分支 3:循环 4:局部性随机 5:Zipf 6:冷热\n");
+                printf("  -l <因子>   局部性因子 0-1（默认: 0.8），冷热模式下为热页面（20%%）的访问比例\n");
+                printf("  -Z <指数>   Zipf模式的指数s（默认: 0.99）\n");
                 printf("  -s <长度>   访问序列长度（默认: 1000）\n");
+                printf("  -S <种子>   随机种子（默认按当前时间），相同种子生成相同的访问序列\n");
+                printf("  -w <比例>   生成的访问中写访问的比例（默认: 0）；trace记录最高位为写标志\n");
+                printf("  -I <m,r,w>  I/O代价（微秒）: 内存访问,读入一页,写回一页（默认: 0.1,100,200）\n");
+                printf("  -F <数字>   后台刷写队列长度，提前写回脏页（默认: 0，不启用）\n");
+                printf("  -A <预取器>[,<窗口>]  缺页时预取，每次最多预取窗口页（默认: 8）:\n");
+                printf("              ");
+                print_prefetcher_names(stdout);
+                printf("\n");
+                printf("              seq为自适应窗口的顺序预读，stride按缺页步长，markov按页面后继关系\n");
+                printf("              预取的页面在第一次访问前不参与置换，最多占页框数的一半，至少需要2个页框\n");
+                printf("  -M          一次扫描输出页框数1~总页数的LRU缺页曲线\n");
+                printf("  -R <比例>   配合-M：按页号哈希以该比例采样，估计近似曲线（SHARDS）\n");
+                printf("  -K <数字>   配合-M：采样页面数上限，超出时自动降低采样率，内存恒定\n");
+                printf("  -X          地址转换模拟：页号视为4KB虚拟页号，模拟TLB和四级页表遍历，\n");
+                printf("              输出TLB命中率、页表遍历次数和每次访问的访存次数\n");
+                printf("  -L <参数>   配合-X：L1项数,L1路数,L2项数,L2路数,遍历缓存项数\n");
+                printf("              （默认: 64,4,1536,12,32）\n");
+                printf("  -H <比例>   配合-X：由2MB大页映射的区域比例（0-1），同时输出只用4KB页的对照\n");
+                printf("  -C <层次>   缓存模拟：按缓存行模拟CPU缓存层次，各级用/分隔，每级为\n");
+                printf("              容量,路数[,策略][,包含性]，策略为lru（默认）、fifo、plru、srrip、random，\n");
+                printf("              包含性为nine（默认）、incl、excl，例如 32K,8,plru/1M,16/32M,16,srrip,excl\n");
+                printf("              生成的访问序列按每条指令4字节换算地址，trace须为按字节的地址记录\n");
+                printf("  -b <字节>   配合-C：缓存行大小（默认: 64）\n");
+                printf("  -t <文件>   回放二进制trace文件（按窗口mmap，不整体读入内存）；\n");
+                printf("              页号可以是任意的原始页号或地址，模拟时按不同页面压缩编号\n");
+                printf("              文件为-（标准输入）或FIFO时为流式模式：分批读取、边读边模拟，\n");
+                printf("              内存占用固定，输入关闭或Ctrl-C时输出总体结果\n");
+                printf("  -i <数字>   流式模式：每隔多少次访问输出一次窗口缺页率（默认: 100000）\n");
+                printf("  -N <数字>   流式模式：页号上限，页表等按此分配（默认: 1048576），\n");
+                printf("              超出上限的记录跳过并计数\n");
+                printf("  -o <文件>   将生成的访问序列导出为二进制trace文件（字节地址，每条指令4字节）\n");
+                printf("  -g          流水线模式：生成线程按块生成访问序列，经环形缓冲区交给模拟线程，\n");
+                printf("              不保存整个序列，-s不受总指令数限制；配合-W时同一组访问模式和\n");
+                printf("              局部性因子的所有算法和页框数共用一条生成的序列\n");
+                printf("  -r <方式>   真实内存回放：每个页面对应一个真实的系统页，换出时调用madvise，\n");
+                printf("              驻留页数不超过页框数；对照模拟与实际（getrusage）的缺页次数和代价。\n");
+                printf("              方式为dontneed（丢弃，次缺页）或pageout（回收到交换区，主缺页）。\n");
+                printf("              -s不受总指令数限制；页数为总指令数2400除以页面大小，可用-p 1增加页数\n");
+                printf("  -W <格式>   参数扫描：多线程运行-a/-f/-m/-l所有取值组合，输出csv或json\n");
+                printf("              取值写法: 4,8,16  4-64（步长1）  4-64:4  4-1024*2（按倍数）\n");
+                printf("              -a可用逗号分隔多个算法或all（只含当前输入支持的算法），\n");
+                printf("              -l可写成0.5-0.9:0.1\n");
+                printf("  -j <数字>   参数扫描、-M和-g的线程数（默认: CPU核数）\n");
+                printf("  -B <格式>   性能基准：固定种子序列上单线程运行-a/-f/-s所有组合，不打印过程，\n");
+                printf("              输出每秒访问次数、每次访问纳秒数和峰值RSS（csv或json）\n");
+                printf("              默认 -f 4,64,1024 -s 100000,1000000，访问模式默认4；未指定-a时\n");
+                printf("              测试除扫描版（*-scan，仅作正确性参照）以外的全部算法\n");
+                printf("  -P <数字>   多进程模拟：各进程的访问序列按时间片轮转交织，共享-f个页框\n");
+                printf("              -m可用逗号分隔，各进程轮流使用其中的访问模式\n");
+                printf("  -G <方式>   多进程页框分配: global（全局置换，默认）、local（局部置换）、\n");
+                printf("              ws（工作集）、pff（缺页频率）\n");
+                printf("  -D <数字>   工作集窗口Δ，按进程虚拟时间计（默认: 200）\n");
+                printf("  -T <数字>   PFF缺页间隔阈值（默认: 50）\n");
+                printf("  -q <数字>   多进程模拟的时间片长度（默认: 100次访问）\n");
                 printf("  -h          显示此帮助信息\n");
                 return 0;
         }
     }
     
-    // 验证配置
-    if (config.total_instructions % config.page_size != 0) {
-        fprintf(stderr, "总指令数必须是页面大小的整数倍\n");
+    if (cache_spec != NULL && parse_cache_spec(cache_spec, line_size, &config.cache) < 0) {
+        return 1;
+    }
+    if (config.real_mode && (bench.format != NULL || sweep.format != NULL || multi.num_procs > 0)) {
+        fprintf(stderr, "真实内存回放只用于单次模拟，不能与-B、-W或-P同时使用\n");
+        return 1;
+    }
+    
+    if (bench.format != NULL) {
+        if (sweep.format != NULL || multi.num_procs > 0 || config.mrc_mode ||
+            config.tlb_mode || config.cache.num_levels > 0 || config.trace_path != NULL ||
+            config.pipelined) {
+            fprintf(stderr, "基准测试不能与-W、-P、-M、-X、-C、-t或-g同时使用\n");
+            return 1;
+        }
+        bench.policy_spec = sweep.policy_spec;
+        bench.frames_spec = sweep.frames_spec;
+        bench.sizes_spec = sweep.sizes_spec;
+        if (sweep.pattern_spec == NULL) {
+            config.access_pattern = 4;
+        } else {
+            config.access_pattern = atoi(sweep.pattern_spec);
+            if (config.access_pattern < 0 || config.access_pattern >= NUM_PATTERNS) {
+                fprintf(stderr, "访问模式必须为0-6之间的数字\n");
+                return 1;
+            }
+        }
+        if (!seed_given) {
+            config.seed = BENCH_SEED;
+        }
+        return run_bench(&config, &bench);
+    }
+    
+    if (sweep.format != NULL) {
+        if (multi.num_procs > 0) {
+            fprintf(stderr, "参数扫描不能与-P同时使用\n");
+            return 1;
+        }
+        if (config.mrc_mode || config.tlb_mode || config.cache.num_levels > 0) {
+            fprintf(stderr, "参数扫描不能与-M、-X或-C同时使用\n");
+            return 1;
+        }
+        if (config.pipelined && config.trace_path != NULL) {
+            fprintf(stderr, "流水线模式不能与-t同时使用\n");
+            return 1;
+        }
+        return run_sweep(&config, &sweep);
+    }
+    
+    // 单次运行：每个参数只取一个值
+    if ((sweep.frames_spec != NULL && strpbrk(sweep.frames_spec, ",-:*") != NULL) ||
+        (sweep.sizes_spec != NULL && strpbrk(sweep.sizes_spec, ",-:*") != NULL) ||
+        (sweep.policy_spec != NULL && (strchr(sweep.policy_spec, ',') != NULL ||
+                                       strcmp(sweep.policy_spec, "all") == 0)) ||
+        (sweep.pattern_spec != NULL && multi.num_procs == 0 &&
+         strpbrk(sweep.pattern_spec, ",-:*") != NULL) ||
+        (sweep.locality_spec != NULL && strpbrk(sweep.locality_spec, ",-:") != NULL)) {
+        fprintf(stderr, "参数取多个值时需配合-W进行参数扫描（-s取多个值需配合-B）\n");
+        return 1;
+    }
+    if (sweep.frames_spec != NULL) {
+        config.num_frames = atoi(sweep.frames_spec);
+        if (config.num_frames <= 0) {
+            fprintf(stderr, "页框数量必须为正数\n");
+            return 1;
+        }
+    }
+    // 预取缓冲占页框数的一半，只有一个页框时无法预取
+    if (config.prefetcher != NULL && config.num_frames < 2) {
+        fprintf(stderr, "预取至少需要2个页框\n");
         return 1;
     }
+    if (sweep.policy_spec != NULL) {
+        config.policy = find_policy(sweep.policy_spec);
+        if (config.policy == NULL) {
+            fprintf(stderr, "未知的算法: %s\n", sweep.policy_spec);
+            fprintf(stderr, "可用算法: ");
+            print_policy_names(stderr);
+            fprintf(stderr, "\n");
+            return 1;
+        }
+    } else {
+        config.policy = find_policy("fifo");
+    }
+    if (sweep.pattern_spec != NULL) {
+        config.access_pattern = atoi(sweep.pattern_spec);
+        if (config.access_pattern < 0 || config.access_pattern >= NUM_PATTERNS) {
+            fprintf(stderr, "访问模式必须为0-6之间的数字\n");
+            fprintf(stderr, "0:顺序 1:跳转 2:分支 3:循环 4:局部性随机 5:Zipf 6:冷热\n");
+            return 1;
+        }
+    }
+    if (sweep.locality_spec != NULL) {
+        config.locality_factor = atof(sweep.locality_spec);
+        if (config.locality_factor < 0 || config.locality_factor > 1) {
+            fprintf(stderr, "局部性因子必须在0-1之间\n");
+            return 1;
+        }
+    }
+    
+    if (multi.num_procs > 0) {
+        if (config.trace_path != NULL || config.mrc_mode || config.tlb_mode ||
+            config.cache.num_levels > 0 || config.export_path != NULL ||
+            config.prefetcher != NULL || config.pipelined) {
+            fprintf(stderr, "多进程模拟不支持-t、-M、-X、-C、-o、-A和-g\n");
+            return 1;
+        }
+        // 多进程模拟只统计缺页，不模拟换页I/O
+        if (config.write_ratio > 0 || config.disk.flush_queue > 0) {
+            fprintf(stderr, "多进程模拟不模拟写回，不能与-w或-F同时使用\n");
+            return 1;
+        }
+        multi.pattern_spec = sweep.pattern_spec;
+        return run_multi(&config, &multi);
+    }
     
-    if (config.seq_length > config.total_instructions) {
-        fprintf(stderr, "访问序列长度不能超过总指令数\n");
-        config.seq_length = config.total_instructions;
+    if (config.mrc_mode + config.tlb_mode + (config.cache.num_levels > 0) > 1) {
+        fprintf(stderr, "-M、-X和-C只能选择一个\n");
+        return 1;
+    }
+    // 地址转换和缓存模拟模式不模拟页面置换，不使用页框、置换算法和页表
+    bool replacing = !config.tlb_mode && config.cache.num_levels == 0;
+    if (config.pipelined) {
+        if (config.trace_path != NULL || !replacing || config.mrc_mode ||
+            config.export_path != NULL) {
+            fprintf(stderr, "流水线模式不能与-t、-M、-X、-C或-o同时使用\n");
+            return 1;
+        }
+        if (config.policy->needs_next_use || config.policy->needs_sequence) {
+            fprintf(stderr, "流水线模式不支持%s（需要预知之后的访问）\n", config.policy->name);
+            return 1;
+        }
+    }
+    // 真实内存回放期间进程自身的缺页也会计入，trace窗口映射、流水线缓冲区都会产生额外缺页
+    if (config.real_mode && (config.trace_path != NULL || config.pipelined || !replacing ||
+                             config.mrc_mode || config.prefetcher != NULL)) {
+        fprintf(stderr, "真实内存回放不能与-t、-g、-M、-X、-C或-A同时使用\n");
+        return 1;
     }
     
-    config.num_pages = config.total_instructions / config.page_size;
+    // trace回放模式：页数和序列长度由trace文件决定
+    TraceFile trace;
+    PageIdMap trace_ids = { NULL, NULL, 0, 0 };
+    bool streaming = config.trace_path != NULL && trace_is_stream(config.trace_path);
+    if (streaming) {
+        // 流式输入：边读边模拟，长度未知，页表按-N的页数上限分配
+        if (!replacing || config.mrc_mode) {
+            fprintf(stderr, "流式输入只支持页面置换模拟\n");
+            return 1;
+        }
+        if (config.policy->needs_next_use || config.policy->needs_sequence) {
+            fprintf(stderr, "流式输入不支持%s（需要预知之后的访问）\n", config.policy->name);
+            return 1;
+        }
+        if (trace_open_stream(&trace, config.trace_path, config.page_size) < 0) {
+            return 1;
+        }
+        config.num_pages = stream_pages;
+        config.seq_length = 0;
+    } else if (config.trace_path != NULL) {
+        if (config.policy->needs_sequence && replacing) {
+            fprintf(stderr, "trace回放模式不支持%s\n", config.policy->name);
+            return 1;
+        }
+        if (trace_open(&trace, config.trace_path, config.page_size) < 0) {
+            return 1;
+        }
+        // 不模拟页面置换时不需要页表，直接使用原始页号；SHARDS只对采样页面建哈希表，
+        // 同样不需要页表，页数未知时缺页曲线的分档随最大栈距离增长
+        bool sampling = config.mrc_mode && (config.sample_rate < 1 || config.max_samples > 0);
+        if (replacing && !sampling &&
+            trace_scan_pages(&trace, &trace_ids, &config.num_pages) < 0) {
+            trace_close(&trace);
+            return 1;
+        }
+        config.seq_length = trace.num_records;
+    } else {
+        // 验证配置
+        if (config.total_instructions % config.page_size != 0) {
+            fprintf(stderr, "总指令数必须是页面大小的整数倍\n");
+            return 1;
+        }
+        
+        // 流水线模式不保存整个序列，各访问模式按总指令数循环，长度不受限制；真实内存回放
+        // 同样不限制，否则只有总指令数次访问，真实缺页的计时几乎没有样本
+        if (!config.pipelined && !config.real_mode &&
+            config.seq_length > config.total_instructions) {
+            fprintf(stderr, "访问序列长度不能超过总指令数\n");
+            config.seq_length = config.total_instructions;
+        }
+        
+        config.num_pages = config.total_instructions / config.page_size;
+    }
     
     printf("=== 页面置换算法模拟器配置 ===\n");
-    printf("页面大小: %d 条指令\n", config.page_size);
-    printf("页框数量: %d\n", config.num_frames);
-    printf("总页数: %d\n", config.num_pages);
-    printf("总指令数: %d\n", config.total_instructions);
-    printf("访问序列长度: %d\n", config.seq_length);
-    printf("局部性因子: %.2f\n", config.locality_factor);
+    if (config.trace_path != NULL) {
+        printf("trace文件: %s（%s记录）\n", config.trace_path,
+               trace.record_type == TRACE_RECORD_ADDR ? "地址" : "页号");
+        if (trace.record_type == TRACE_RECORD_ADDR) {
+            printf("页面大小: %lld\n", trace.page_size);
+        }
+    } else {
+        printf("页面大小: %d 条指令\n", config.page_size);
+    }
+    if (replacing) {
+        printf("页框数量: %d\n", config.num_frames);
+    }
+    if (streaming) {
+        printf("页号上限: %d\n", config.num_pages);
+    } else if (config.num_pages > 0) {
+        printf("总页数: %d\n", config.num_pages);
+    }
+    if (config.trace_path == NULL) {
+        printf("总指令数: %d\n", config.total_instructions);
+    }
+    if (streaming) {
+        printf("访问序列长度: 流式输入，每%lld次访问输出一次\n", config.report_interval);
+    } else {
+        printf("访问序列长度: %lld\n", config.seq_length);
+    }
+    if (config.trace_path == NULL) {
+        printf("局部性因子: %.2f\n", config.locality_factor);
+    }
     
-    switch (config.algorithm) {
-        case ALG_FIFO:
-            printf("使用算法: FIFO\n");
-            break;
-        case ALG_LRU:
-            printf("使用算法: LRU\n");
-            break;
-        case ALG_OPT:
-            printf("使用算法: OPT\n");
-            break;
+    if (replacing) {
+        printf("使用算法: %s\n", config.policy->title);
+        if (config.prefetcher != NULL) {
+            printf("预取器: %s（窗口%d）\n", config.prefetcher->title, config.prefetch_window);
+        }
+        if (config.real_mode) {
+            printf("真实内存回放: %s\n", config.real_mode == REAL_PAGEOUT ? "MADV_PAGEOUT" :
+                   "MADV_DONTNEED");
+        }
     }
     
-    switch (config.access_pattern) {
+    switch (config.trace_path != NULL ? -1 : config.access_pattern) {
+        case -1:
+            printf("访问模式: trace回放\n");
+            break;
         case 0:
             printf("访问模式: 顺序\n");
             break;
@@ -196,235 +1127,952 @@ int main(int argc, char *argv[]) {
         case 4:
             printf("访问模式: 局部性随机\n");
             break;
+        case 5:
+            printf("访问模式: Zipf（s=%.2f）\n", config.zipf_exponent);
+            break;
+        case 6:
+            printf("访问模式: 冷热\n");
+            break;
+    }
+    if (config.trace_path == NULL) {
+        printf("随机种子: %llu\n", (unsigned long long)config.seed);
     }
     printf("=============================\n\n");
     
     // 初始化模拟器
     Simulator sim;
     init_simulator(&sim, &config);
+    if (config.real_mode && real_init(&sim) < 0) {
+        cleanup(&sim);
+        return 1;
+    }
     
-    // 生成访问序列
-    generate_access_sequence(&sim);
-    
-    // 运行模拟
-    simulate(&sim);
+    if (config.trace_path != NULL) {
+        sim.trace = &trace;
+    } else if (!config.pipelined) {
+        // 生成访问序列
+        generate_access_sequence(&sim);
+        
+        if (config.export_path != NULL) {
+            if (trace_export(config.export_path, &sim.config) < 0) {
+                cleanup(&sim);
+                return 1;
+            }
+            printf("访问序列已导出到: %s\n\n", config.export_path);
+        }
+    }
     
-    // 打印结果
-    print_results(&sim);
+    int ret = 0;
+    if (config.mrc_mode && (config.sample_rate < 1 || config.max_samples > 0)) {
+        // 只对采样页面计算栈距离，按采样率放大得到近似曲线
+        shards_compute(&sim);
+    } else if (config.tlb_mode) {
+        // 只模拟地址转换，不模拟页面置换
+        tlb_compute(&sim);
+    } else if (config.cache.num_levels > 0) {
+        // 只模拟CPU缓存层次
+        if (cache_compute(&sim) < 0) {
+            ret = 1;
+        }
+    } else if (config.mrc_mode) {
+        // 一次扫描得到所有页框数下的LRU缺页次数
+        long long *hist = (long long*)calloc(config.num_pages + 1, sizeof(long long));
+        long long cold_misses = 0;
+        if (mrc_compute(&sim, sweep.num_threads, hist, &cold_misses) < 0) {
+            ret = 1;
+        } else {
+            mrc_print(&sim, hist, cold_misses);
+        }
+        free(hist);
+    } else if (streaming) {
+        // 边读边模拟，结束（输入关闭或Ctrl-C）后输出总体结果
+        if (simulate_stream(&sim) < 0) {
+            ret = 1;
+        } else {
+            print_results(&sim);
+        }
+    } else if (config.pipelined) {
+        // 生成线程与模拟线程流水线执行
+        printf("开始流水线模拟...\n\n");
+        if (run_pipeline(&sim.config, &sim, 1, sweep.num_threads) < 0) {
+            ret = 1;
+        } else {
+            printf("模拟完成！\n\n");
+            print_results(&sim);
+        }
+    } else if (config.trace_path != NULL) {
+        // 按窗口映射trace文件运行模拟
+        if (simulate_trace(&sim) < 0) {
+            ret = 1;
+        } else {
+            print_results(&sim);
+        }
+    } else {
+        // 运行模拟
+        simulate(&sim);
+        
+        // 打印结果
+        print_results(&sim);
+    }
     
     // 清理资源
     cleanup(&sim);
+    if (config.trace_path != NULL) {
+        trace_close(&trace);
+        pageid_free(&trace_ids);
+    }
     
-    return 0;
+    return ret;
 }
 
-void init_simulator(Simulator *sim, Config *config) {
-    sim->config = *config;
-    
-    // 分配大数组A
-    sim->large_array = (int*)malloc(config->total_instructions * sizeof(int));
-    
-    // 初始化大数组，填充随机值（1-1000）
-    for (int i = 0; i < config->total_instructions; i++) {
-        sim->large_array[i] = rand() % 1000 + 1;
+// ========== 随机数生成 ==========
+
+// xoshiro256**，RNG_LANES路独立状态按分量存放，整块生成时内层循环可以向量化。
+// 同一种子在任何平台上生成相同的序列
+static inline uint64_t rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// 由种子和流编号派生出互不相关的种子（多进程模拟中每个进程一条流）
+uint64_t rng_stream_seed(uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ULL);
+    return splitmix64(&x);
+}
+
+void rng_init(Rng *rng, uint64_t seed) {
+    uint64_t x = seed;
+    for (int k = 0; k < 4; k++) {
+        for (int l = 0; l < RNG_LANES; l++) {
+            rng->s[k][l] = splitmix64(&x);
+        }
     }
-    
-    // 分配页框数组
-    sim->frames = (Frame*)malloc(config->num_frames * sizeof(Frame));
-    for (int i = 0; i < config->num_frames; i++) {
-        sim->frames[i].page_id = -1;
-        sim->frames[i].last_used = -1;
-        sim->frames[i].load_time = -1;
-        sim->frames[i].valid = false;
+    rng->pos = RNG_BLOCK;
+}
+
+static void rng_refill(Rng *rng) {
+    for (int i = 0; i < RNG_BLOCK; i += RNG_LANES) {
+        for (int l = 0; l < RNG_LANES; l++) {
+            uint64_t s0 = rng->s[0][l], s1 = rng->s[1][l];
+            uint64_t s2 = rng->s[2][l], s3 = rng->s[3][l];
+            rng->block[i + l] = rotl64(s1 * 5, 7) * 9;
+            uint64_t t = s1 << 17;
+            s2 ^= s0;
+            s3 ^= s1;
+            s1 ^= s2;
+            s0 ^= s3;
+            s2 ^= t;
+            rng->s[0][l] = s0;
+            rng->s[1][l] = s1;
+            rng->s[2][l] = s2;
+            rng->s[3][l] = rotl64(s3, 45);
+        }
     }
-    
-    // 分配页表（简化版，只记录页号到页框的映射）
-    sim->page_table = (int*)malloc(config->num_pages * sizeof(int));
-    for (int i = 0; i < config->num_pages; i++) {
-        sim->page_table[i] = -1;  // -1表示不在内存中
+    rng->pos = 0;
+}
+
+static inline uint64_t rng_next(Rng *rng) {
+    if (rng->pos == RNG_BLOCK) {
+        rng_refill(rng);
+    }
+    return rng->block[rng->pos++];
+}
+
+// [0, n)内的整数（乘法取高位，n < 2^32时偏差可以忽略）
+static inline int rng_below(Rng *rng, int n) {
+    return (int)(((rng_next(rng) >> 32) * (uint64_t)n) >> 32);
+}
+
+// 以概率p返回true，p预先换算为2^32的定点数
+static inline bool rng_chance(Rng *rng, uint64_t p32) {
+    return (rng_next(rng) >> 32) < p32;
+}
+
+static inline uint64_t prob32(double p) {
+    return (uint64_t)(p * 4294967296.0);
+}
+
+// Vose别名表：按weights构造，之后每次抽样O(1)。prob为2^32定点概率
+static void alias_build(const double *weights, int n, uint64_t *prob, int *alias) {
+    double total = 0;
+    for (int i = 0; i < n; i++) {
+        total += weights[i];
+    }
+    
+    double *scaled = (double*)malloc(n * sizeof(double));
+    int *small = (int*)malloc(n * sizeof(int));
+    int *large = (int*)malloc(n * sizeof(int));
+    int num_small = 0, num_large = 0;
+    for (int i = 0; i < n; i++) {
+        scaled[i] = weights[i] * n / total;
+        if (scaled[i] < 1) {
+            small[num_small++] = i;
+        } else {
+            large[num_large++] = i;
+        }
     }
     
-    // 分配访问序列
-    sim->config.access_sequence = (int*)malloc(config->seq_length * sizeof(int));
+    while (num_small > 0 && num_large > 0) {
+        int s = small[--num_small];
+        int l = large[--num_large];
+        prob[s] = prob32(scaled[s]);
+        alias[s] = l;
+        scaled[l] -= 1 - scaled[s];
+        if (scaled[l] < 1) {
+            small[num_small++] = l;
+        } else {
+            large[num_large++] = l;
+        }
+    }
+    // 剩余的列由于舍入误差只差一点点，直接视为满列
+    while (num_large > 0) {
+        int l = large[--num_large];
+        prob[l] = 1ULL << 32;
+        alias[l] = l;
+    }
+    while (num_small > 0) {
+        int s = small[--num_small];
+        prob[s] = 1ULL << 32;
+        alias[s] = s;
+    }
     
-    sim->page_faults = 0;
-    sim->current_time = 0;
+    free(scaled);
+    free(small);
+    free(large);
 }
 
-void generate_access_sequence(Simulator *sim) {
-    Config *config = &sim->config;
-    int *seq = config->access_sequence;
+static inline int alias_sample(Rng *rng, const uint64_t *prob, const int *alias, int n) {
+    uint64_t r = rng_next(rng);
+    int column = (int)(((r & 0xFFFFFFFFULL) * (uint64_t)n) >> 32);
+    return (r >> 32) < prob[column] ? column : alias[column];
+}
+
+// 按页面权重抽样的访问模式（Zipf、冷热）：页面按随机排列分散在地址空间中，
+// 页内偏移均匀随机
+// 模式5/6：按权重建立别名表，并随机打乱页面，使热页面分散在地址空间中
+static void seqgen_weighted(SeqGen *gen, double *weights) {
+    int n = gen->config->num_pages;
+    
+    gen->prob = (uint64_t*)malloc(n * sizeof(uint64_t));
+    gen->alias = (int*)malloc(n * sizeof(int));
+    gen->perm = (int*)malloc(n * sizeof(int));
+    
+    alias_build(weights, n, gen->prob, gen->alias);
+    for (int i = 0; i < n; i++) {
+        gen->perm[i] = i;
+    }
+    for (int i = n - 1; i > 0; i--) {
+        int j = rng_below(&gen->rng, i + 1);
+        int t = gen->perm[i];
+        gen->perm[i] = gen->perm[j];
+        gen->perm[j] = t;
+    }
+}
+
+// 初始化生成器：各模式的初始随机抽取（循环区域、起点、页面排列）在这里完成，
+// 之后seqgen_fill按块续写，分块方式不影响生成的序列
+void seqgen_init(SeqGen *gen, const Config *config) {
     int total_inst = config->total_instructions;
     
+    gen->config = config;
+    gen->pos = 0;
+    gen->current = 0;
+    gen->p = 0;
+    gen->loop_size = 0;
+    gen->loop_pos = 0;
+    gen->current_loop = 0;
+    gen->prob = NULL;
+    gen->alias = NULL;
+    gen->perm = NULL;
+    rng_init(&gen->rng, config->seed);
+    
     switch (config->access_pattern) {
-        case 0: // 顺序访问（强局部性）
-            for (int i = 0; i < config->seq_length; i++) {
-                seq[i] = i % total_inst;
+        case 0:
+            break;
+        case 1:
+            gen->p = prob32(0.7);
+            break;
+        case 2:
+            gen->p = prob32(0.8);
+            break;
+        case 3: // 创建几个循环区域，每个循环3个页面
+            gen->loop_size = config->page_size * 3;
+            gen->p = prob32(0.3);
+            for (int i = 0; i < SEQGEN_LOOPS; i++) {
+                gen->loop_start[i] = rng_below(&gen->rng, total_inst - gen->loop_size);
             }
             break;
-            
-        case 1: // 跳转访问（中度局部性）
+        case 4:
+            gen->p = prob32(config->locality_factor);
+            gen->current = rng_below(&gen->rng, total_inst);
+            break;
+        case 5: // Zipf：第k热的页面被访问的概率正比于1/k^s
             {
-                int current = 0;
-                for (int i = 0; i < config->seq_length; i++) {
-                    seq[i] = current;
-                    // 70%概率顺序执行，30%概率跳转
-                    if (rand() % 100 < 70) {
-                        current = (current + 1) % total_inst;
+                double *weights = (double*)malloc(config->num_pages * sizeof(double));
+                for (int k = 0; k < config->num_pages; k++) {
+                    weights[k] = 1.0 / pow(k + 1, config->zipf_exponent);
+                }
+                seqgen_weighted(gen, weights);
+                free(weights);
+            }
+            break;
+        case 6: // 冷热：20%的热页面承担locality_factor比例的访问
+        default:
+            {
+                int n = config->num_pages;
+                int hot = n / 5 > 0 ? n / 5 : 1;
+                double *weights = (double*)malloc(n * sizeof(double));
+                for (int k = 0; k < n; k++) {
+                    if (hot == n) {
+                        weights[k] = 1;
+                    } else if (k < hot) {
+                        weights[k] = config->locality_factor / hot;
                     } else {
-                        int jump_distance = (rand() % 50) + 10; // 跳转10-60条指令
-                        current = (current + jump_distance) % total_inst;
+                        weights[k] = (1 - config->locality_factor) / (n - hot);
+                    }
+                }
+                seqgen_weighted(gen, weights);
+                free(weights);
+            }
+            break;
+    }
+}
+
+// 接着已生成的部分再生成count次访问，写入seq[0..count)
+void seqgen_fill(SeqGen *gen, int *seq, long long count) {
+    const Config *config = gen->config;
+    int total_inst = config->total_instructions;
+    Rng *rng = &gen->rng;
+    int current = gen->current;
+    
+    switch (config->access_pattern) {
+        case 0: // 顺序访问（强局部性）：按总指令数循环
+            {
+                int next = (int)(gen->pos % total_inst);
+                for (long long i = 0; i < count; i++) {
+                    seq[i] = next;
+                    if (++next == total_inst) {
+                        next = 0;
                     }
                 }
             }
             break;
             
+        case 1: // 跳转访问（中度局部性）
+            for (long long i = 0; i < count; i++) {
+                seq[i] = current;
+                // 70%概率顺序执行，30%概率跳转10-59条指令
+                uint64_t r = rng_next(rng);
+                if ((r >> 32) < gen->p) {
+                    current++;
+                } else {
+                    current += 10 + (int)(((r & 0xFFFFFFFFULL) * 50) >> 32);
+                }
+                if (current >= total_inst) {
+                    current %= total_inst;
+                }
+            }
+            break;
+            
         case 2: // 分支访问（模拟if-else模式，较强局部性）
             {
-                int current = 0;
-                for (int i = 0; i < config->seq_length; i++) {
+                int page_size = config->page_size;
+                for (long long i = 0; i < count; i++) {
                     seq[i] = current;
                     // 80%概率在当前页面内移动
-                    if (rand() % 100 < 80) {
-                        current = (current + 1) % config->page_size + 
-                                 (current / config->page_size) * config->page_size;
+                    if (rng_chance(rng, gen->p)) {
+                        current = (current + 1) % page_size + (current / page_size) * page_size;
                     } else {
                         // 20%概率跳转到其他页面
-                        int new_page = rand() % config->num_pages;
-                        current = new_page * config->page_size + rand() % config->page_size;
+                        int new_page = rng_below(rng, config->num_pages);
+                        current = new_page * page_size + rng_below(rng, page_size);
                     }
                     current %= total_inst;
                 }
             }
             break;
             
-        case 3: // 循环访问（强局部性）
-            {
-                // 创建几个循环区域
-                int num_loops = 5;
-                int loop_size = config->page_size * 3; // 每个循环3个页面
-                int loop_start[num_loops];
-                for (int i = 0; i < num_loops; i++) {
-                    loop_start[i] = rand() % (total_inst - loop_size);
+        case 3: // 循环访问（强局部性）：每圈循环体是一段连续地址
+            for (long long i = 0; i < count; ) {
+                long long n = gen->loop_size - gen->loop_pos;
+                if (n > count - i) {
+                    n = count - i;
                 }
+                int base = gen->loop_start[gen->current_loop] + gen->loop_pos;
+                for (long long k = 0; k < n; k++) {
+                    seq[i + k] = base + (int)k;
+                }
+                i += n;
+                gen->loop_pos += (int)n;
                 
-                int current_loop = 0;
-                int pos_in_loop = 0;
-                
-                for (int i = 0; i < config->seq_length; i++) {
-                    seq[i] = loop_start[current_loop] + pos_in_loop;
-                    pos_in_loop = (pos_in_loop + 1) % loop_size;
-                    
-                    // 偶尔切换到其他循环
-                    if (pos_in_loop == 0 && rand() % 100 < 30) {
-                        current_loop = rand() % num_loops;
+                // 每圈结束时偶尔切换到其他循环
+                if (gen->loop_pos == gen->loop_size) {
+                    gen->loop_pos = 0;
+                    if (rng_chance(rng, gen->p)) {
+                        gen->current_loop = rng_below(rng, SEQGEN_LOOPS);
                     }
                 }
             }
             break;
             
         case 4: // 局部性随机访问
-        default:
+            for (long long i = 0; i < count; i++) {
+                seq[i] = current;
+                
+                // 根据局部性因子决定下一步
+                uint64_t r = rng_next(rng);
+                if ((r >> 32) < gen->p) {
+                    // 高概率在附近访问（±20条指令范围内）
+                    int delta = (int)(((r & 0xFFFFFFFFULL) * 41) >> 32) - 20;
+                    current = (current + delta + total_inst) % total_inst;
+                } else {
+                    // 低概率随机跳转
+                    current = rng_below(rng, total_inst);
+                }
+            }
+            break;
+            
+        default: // 5/6：按别名表抽取页面，页内偏移均匀
             {
-                int current = rand() % total_inst;
-                for (int i = 0; i < config->seq_length; i++) {
-                    seq[i] = current;
-                    
-                    // 根据局部性因子决定下一步
-                    if ((float)rand() / RAND_MAX < config->locality_factor) {
-                        // 高概率在附近访问（±20条指令范围内）
-                        int delta = (rand() % 41) - 20; // -20 到 +20
-                        current = (current + delta + total_inst) % total_inst;
-                    } else {
-                        // 低概率随机跳转
-                        current = rand() % total_inst;
-                    }
+                int n = config->num_pages;
+                int page_size = config->page_size;
+                for (long long i = 0; i < count; i++) {
+                    int page = gen->perm[alias_sample(rng, gen->prob, gen->alias, n)];
+                    seq[i] = page * page_size + rng_below(rng, page_size);
                 }
             }
             break;
     }
+    
+    gen->current = current;
+    gen->pos += count;
 }
 
-int find_page_in_frames(Simulator *sim, int page_id) {
-    for (int i = 0; i < sim->config.num_frames; i++) {
-        if (sim->frames[i].valid && sim->frames[i].page_id == page_id) {
-            return i; // 找到页框
+void seqgen_free(SeqGen *gen) {
+    free(gen->prob);
+    free(gen->alias);
+    free(gen->perm);
+}
+
+void generate_access_sequence(Simulator *sim) {
+    SeqGen gen;
+    
+    seqgen_init(&gen, &sim->config);
+    seqgen_fill(&gen, sim->config.access_sequence, sim->config.seq_length);
+    seqgen_free(&gen);
+}
+
+// 按FRAME_ALIGN对齐分配，长度向上取整到对齐大小
+static void *alloc_aligned(size_t size) {
+    size_t rounded = (size + FRAME_ALIGN - 1) / FRAME_ALIGN * FRAME_ALIGN;
+    return aligned_alloc(FRAME_ALIGN, rounded > 0 ? rounded : FRAME_ALIGN);
+}
+
+void init_simulator(Simulator *sim, Config *config) {
+    sim->config = *config;
+    sim->trace = NULL;
+    sim->large_array = NULL;
+    sim->owns_sequence = false;
+    
+    memset(&sim->real, 0, sizeof(sim->real));
+    
+    // 配置中已给出访问序列时直接共享，不再分配；流水线模式按块生成，不保存整个序列
+    if (config->trace_path == NULL && config->access_sequence == NULL) {
+        // 分配大数组A（真实内存回放时由real_init映射的区域代替）
+        if (!config->real_mode) {
+            sim->large_array = (int*)malloc(config->total_instructions * sizeof(int));
+            
+            // 初始化大数组，填充随机值（1-1000），使用与访问序列不同的随机流
+            Rng rng;
+            rng_init(&rng, rng_stream_seed(config->seed, 0));
+            for (int i = 0; i < config->total_instructions; i++) {
+                sim->large_array[i] = rng_below(&rng, 1000) + 1;
+            }
+        }
+        
+        // 分配访问序列（trace模式按窗口映射文件，不分配）
+        if (!config->pipelined) {
+            sim->config.access_sequence = (int*)malloc(config->seq_length * sizeof(int));
+            sim->owns_sequence = true;
+        }
+    }
+    
+    sim->page_faults = 0;
+    sim->current_time = 0;
+    sim->used_frames = 0;
+    sim->next_use = NULL;
+    sim->owns_next_use = false;
+    sim->next_use_fd = -1;
+    memset(&sim->frames, 0, sizeof(sim->frames));
+    memset(&sim->io, 0, sizeof(sim->io));
+    sim->page_table = NULL;
+    sim->policy_state = NULL;
+    sim->prefetch_state = NULL;
+    memset(&sim->prefetch, 0, sizeof(sim->prefetch));
+    
+    // 缺页曲线、地址转换和缓存模拟模式不模拟页框，也不分配按页数增长的页表
+    if (config->mrc_mode || config->tlb_mode || config->cache.num_levels > 0) {
+        return;
+    }
+    
+    // 分配页框表
+    FrameTable *frames = &sim->frames;
+    frames->page_id = (int*)alloc_aligned(config->num_frames * sizeof(int));
+    frames->last_used = (long long*)alloc_aligned(config->num_frames * sizeof(long long));
+    frames->load_time = (long long*)alloc_aligned(config->num_frames * sizeof(long long));
+    frames->valid = (uint64_t*)calloc((config->num_frames + 63) / 64, sizeof(uint64_t));
+    frames->dirty = (uint64_t*)calloc((config->num_frames + 63) / 64, sizeof(uint64_t));
+    if (config->prefetcher != NULL) {
+        frames->prefetched = (uint64_t*)calloc((config->num_frames + 63) / 64, sizeof(uint64_t));
+    }
+    for (int i = 0; i < config->num_frames; i++) {
+        frames->page_id[i] = -1;
+        frames->last_used[i] = -1;
+        frames->load_time[i] = -1;
+    }
+    
+    if (config->disk.flush_queue > 0) {
+        sim->io.flush_frame = (int*)malloc(config->disk.flush_queue * sizeof(int));
+        sim->io.flush_page = (int*)malloc(config->disk.flush_queue * sizeof(int));
+    }
+    
+    // 分配页表（简化版，只记录页号到页框的映射）
+    sim->page_table = (int*)malloc(config->num_pages * sizeof(int));
+    for (int i = 0; i < config->num_pages; i++) {
+        sim->page_table[i] = -1;  // -1表示不在内存中
+    }
+    
+    // 预知未来的策略需要每次访问的下次使用位置；trace模式存放在临时文件中，见opt_prepare_trace。
+    // 配置中已给出时直接共享
+    if (config->policy->needs_next_use && config->trace_path == NULL) {
+        if (config->next_use != NULL) {
+            sim->next_use = config->next_use;
+        } else {
+            sim->next_use = (long long*)malloc(config->seq_length * sizeof(long long));
+            sim->owns_next_use = true;
+        }
+    }
+    
+    // 策略状态在页表分配之后创建，部分策略直接使用页表把页号换算为页框
+    sim->policy_state = config->policy->create(sim);
+    
+    // 预取的页面在第一次被访问之前不交给置换策略，而是放在最多占页框数一半的预取缓冲中，
+    // 缓冲满时挤出最早预取的页面。顺序预读访问到标记页时缓冲中还有当前窗口的其余页面，
+    // 每次预取的页数不超过缓冲的一半，才能同时容纳当前窗口和预读的下一个窗口
+    if (config->prefetcher != NULL) {
+        PrefetchStats *pf = &sim->prefetch;
+        pf->capacity = config->num_frames / 2;
+        pf->max = (pf->capacity + 1) / 2;
+        if (config->prefetch_window < pf->max) {
+            pf->max = config->prefetch_window;
         }
+        pf->pages = (int*)malloc((pf->max > 0 ? pf->max : 1) * sizeof(int));
+        pf->evicted = (uint64_t*)calloc((config->num_pages + 63) / 64, sizeof(uint64_t));
+        pf->ready_us = (double*)calloc(config->num_frames, sizeof(double));
+        pf->buf_prev = (int*)malloc(config->num_frames * sizeof(int));
+        pf->buf_next = (int*)malloc(config->num_frames * sizeof(int));
+        pf->buffer.head = -1;
+        pf->buffer.tail = -1;
+        pf->buffer.size = 0;
+        sim->prefetch_state = config->prefetcher->create(sim);
     }
-    return -1; // 未找到
+}
+
+int find_page_in_frames(Simulator *sim, int page_id) {
+    // 页表已记录页号到页框的映射，置换时会清除旧映射，无需扫描页框
+    return sim->page_table[page_id]; // -1表示未找到
 }
 
 void load_page(Simulator *sim, int page_id, int frame_index) {
     // 更新页框
-    sim->frames[frame_index].page_id = page_id;
-    sim->frames[frame_index].last_used = sim->current_time;
-    sim->frames[frame_index].load_time = sim->current_time;
-    sim->frames[frame_index].valid = true;
+    sim->frames.page_id[frame_index] = page_id;
+    sim->frames.last_used[frame_index] = sim->current_time;
+    sim->frames.load_time[frame_index] = sim->current_time;
+    sim->frames.valid[frame_index / 64] |= 1ULL << (frame_index % 64);
     
     // 更新页表
     sim->page_table[page_id] = frame_index;
 }
 
-int fifo_replace(Simulator *sim) {
-    int oldest_index = 0;
-    int oldest_time = sim->frames[0].load_time;
+// ========== 页面置换策略 ==========
+
+// 以数组下标为节点的双向链表，prev/next数组由同一节点空间的多个链表共享
+// （每个节点同一时刻至多在一个链表中），插入删除均为O(1)
+static void ilist_init(IndexList *list) {
+    list->head = -1;
+    list->tail = -1;
+    list->size = 0;
+}
+
+static void ilist_push_front(IndexList *list, int *prev, int *next, int node) {
+    prev[node] = -1;
+    next[node] = list->head;
+    if (list->head != -1) {
+        prev[list->head] = node;
+    } else {
+        list->tail = node;
+    }
+    list->head = node;
+    list->size++;
+}
+
+static void ilist_remove(IndexList *list, int *prev, int *next, int node) {
+    if (prev[node] != -1) {
+        next[prev[node]] = next[node];
+    } else {
+        list->head = next[node];
+    }
+    if (next[node] != -1) {
+        prev[next[node]] = prev[node];
+    } else {
+        list->tail = prev[node];
+    }
+    prev[node] = -1;
+    next[node] = -1;
+    list->size--;
+}
+
+static int *alloc_links(int n) {
+    int *links = (int*)malloc(n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        links[i] = -1;
+    }
+    return links;
+}
+
+static void policy_noop_frame(void *state, int frame_index, int page_id, long long next_use) {
+    (void)state;
+    (void)frame_index;
+    (void)page_id;
+    (void)next_use;
+}
+
+static void policy_noop_evict(void *state, int frame_index, int page_id) {
+    (void)state;
+    (void)frame_index;
+    (void)page_id;
+}
+
+// 只读取模拟器页框信息的策略，状态即模拟器本身
+static void *policy_sim_create(Simulator *sim) {
+    return sim;
+}
+
+static void policy_sim_destroy(void *state) {
+    (void)state;
+}
+
+// ---------- 扫描类策略共用：求时间数组中最小值的下标 ----------
+// 只在页框全部装满后调用，无需检查有效位。有多个最小值时返回最小的下标
+
+static inline __attribute__((always_inline))
+int min_index_scalar(const long long *values, int n) {
+    int best = 0;
+    long long best_value = values[0];
     
-    for (int i = 1; i < sim->config.num_frames; i++) {
-        if (sim->frames[i].load_time < oldest_time) {
-            oldest_time = sim->frames[i].load_time;
-            oldest_index = i;
+    for (int i = 1; i < n; i++) {
+        if (values[i] < best_value) {
+            best_value = values[i];
+            best = i;
         }
     }
+    return best;
+}
+
+#ifdef HAVE_X86_SIMD
+// AVX2：两组4路并行保存各自的最小值和下标（两条独立的依赖链），最后归约
+__attribute__((target("avx2")))
+static int min_index_avx2(const long long *values, int n) {
+    int blocks = n / 8 * 8;
+    __m256i best0 = _mm256_load_si256((const __m256i*)values);
+    __m256i best1 = _mm256_load_si256((const __m256i*)(values + 4));
+    __m256i index0 = _mm256_setr_epi64x(0, 1, 2, 3);
+    __m256i index1 = _mm256_setr_epi64x(4, 5, 6, 7);
+    __m256i best_index0 = index0;
+    __m256i best_index1 = index1;
+    const __m256i step = _mm256_set1_epi64x(8);
+    
+    for (int i = 8; i < blocks; i += 8) {
+        __m256i v0 = _mm256_load_si256((const __m256i*)(values + i));
+        __m256i v1 = _mm256_load_si256((const __m256i*)(values + i + 4));
+        index0 = _mm256_add_epi64(index0, step);
+        index1 = _mm256_add_epi64(index1, step);
+        // 严格小于才替换，每一路保留最早出现的最小值
+        __m256i less0 = _mm256_cmpgt_epi64(best0, v0);
+        __m256i less1 = _mm256_cmpgt_epi64(best1, v1);
+        best0 = _mm256_blendv_epi8(best0, v0, less0);
+        best1 = _mm256_blendv_epi8(best1, v1, less1);
+        best_index0 = _mm256_blendv_epi8(best_index0, index0, less0);
+        best_index1 = _mm256_blendv_epi8(best_index1, index1, less1);
+    }
     
-    // 从页表中删除旧页面的映射
-    int old_page = sim->frames[oldest_index].page_id;
-    if (old_page >= 0) {
-        sim->page_table[old_page] = -1;
+    long long lane_value[8], lane_index[8];
+    _mm256_storeu_si256((__m256i*)lane_value, best0);
+    _mm256_storeu_si256((__m256i*)(lane_value + 4), best1);
+    _mm256_storeu_si256((__m256i*)lane_index, best_index0);
+    _mm256_storeu_si256((__m256i*)(lane_index + 4), best_index1);
+    long long result_value = lane_value[0];
+    long long result = lane_index[0];
+    for (int l = 1; l < 8; l++) {
+        if (lane_value[l] < result_value ||
+            (lane_value[l] == result_value && lane_index[l] < result)) {
+            result_value = lane_value[l];
+            result = lane_index[l];
+        }
+    }
+    for (int i = blocks; i < n; i++) {
+        if (values[i] < result_value) {
+            result_value = values[i];
+            result = i;
+        }
+    }
+    return (int)result;
+}
+#endif
+
+// 常用的小页框数使用编译期固定长度的版本（循环完全展开），较大的页框数在支持时使用AVX2
+static int min_index(const long long *values, int n) {
+    switch (n) {
+        case 3: return min_index_scalar(values, 3);
+        case 4: return min_index_scalar(values, 4);
+        case 5: return min_index_scalar(values, 5);
+        case 8: return min_index_scalar(values, 8);
+        case 16: return min_index_scalar(values, 16);
     }
+#ifdef HAVE_X86_SIMD
+    if (n >= 32 && __builtin_cpu_supports("avx2")) {
+        return min_index_avx2(values, n);
+    }
+#endif
+    return min_index_scalar(values, n);
+}
+
+// ---------- FIFO：扫描load_time最小的页框 ----------
+
+static int fifo_choose_victim(void *state, int page_id) {
+    Simulator *sim = (Simulator*)state;
+    (void)page_id;
+    return min_index(sim->frames.load_time, sim->config.num_frames);
+}
+
+// ---------- LRU：按页框下标组织的双向链表，头部最近使用，尾部为置换对象 ----------
+
+typedef struct {
+    int *prev;
+    int *next;
+    IndexList list;
+} LruState;
+
+static void *lru_create(Simulator *sim) {
+    LruState *lru = (LruState*)malloc(sizeof(LruState));
+    lru->prev = alloc_links(sim->config.num_frames);
+    lru->next = alloc_links(sim->config.num_frames);
+    ilist_init(&lru->list);
+    return lru;
+}
+
+static void lru_destroy(void *state) {
+    LruState *lru = (LruState*)state;
+    free(lru->prev);
+    free(lru->next);
+    free(lru);
+}
+
+static void lru_on_hit(void *state, int frame_index, int page_id, long long next_use) {
+    LruState *lru = (LruState*)state;
+    (void)page_id;
+    (void)next_use;
     
-    return oldest_index;
+    if (lru->list.head != frame_index) {
+        ilist_remove(&lru->list, lru->prev, lru->next, frame_index);
+        ilist_push_front(&lru->list, lru->prev, lru->next, frame_index);
+    }
+}
+
+static void lru_on_miss(void *state, int frame_index, int page_id, long long next_use) {
+    LruState *lru = (LruState*)state;
+    (void)page_id;
+    (void)next_use;
+    ilist_push_front(&lru->list, lru->prev, lru->next, frame_index);
+}
+
+static int lru_choose_victim(void *state, int page_id) {
+    (void)page_id;
+    return ((LruState*)state)->list.tail;
 }
 
-int lru_replace(Simulator *sim) {
-    int lru_index = 0;
-    int lru_time = sim->frames[0].last_used;
+static void lru_on_evict(void *state, int frame_index, int page_id) {
+    LruState *lru = (LruState*)state;
+    (void)page_id;
+    ilist_remove(&lru->list, lru->prev, lru->next, frame_index);
+}
+
+// ---------- LRU（扫描版）：每次缺页扫描所有页框的last_used ----------
+
+static int lru_scan_choose_victim(void *state, int page_id) {
+    Simulator *sim = (Simulator*)state;
+    (void)page_id;
+    return min_index(sim->frames.last_used, sim->config.num_frames);
+}
+
+// ---------- OPT：驻留页面按下次使用位置组织成最大堆 ----------
+
+typedef struct {
+    long long *key;     // 每个页框中页面的下一次使用位置
+    int *heap;          // 按key组织的最大堆（存放页框下标）
+    int *heap_pos;      // 页框在堆中的位置（-1表示不在堆中）
+    int heap_size;
+} OptState;
+
+// 一次反向扫描，计算每次访问的页面下一次被访问的位置
+void opt_prepare(Simulator *sim) {
+    Config *config = &sim->config;
+    int *seq = config->access_sequence;
+    int page_size = config->page_size;
+    long long *last_seen = (long long*)malloc(config->num_pages * sizeof(long long));
+    
+    for (int i = 0; i < config->num_pages; i++) {
+        last_seen[i] = config->seq_length; // 未来不再使用
+    }
+    for (long long i = config->seq_length - 1; i >= 0; i--) {
+        int page_id = seq[i] / page_size;
+        sim->next_use[i] = last_seen[page_id];
+        last_seen[page_id] = i;
+    }
     
-    for (int i = 1; i < sim->config.num_frames; i++) {
-        if (sim->frames[i].last_used < lru_time) {
-            lru_time = sim->frames[i].last_used;
-            lru_index = i;
+    free(last_seen);
+}
+
+static void *opt_create(Simulator *sim) {
+    OptState *opt = (OptState*)malloc(sizeof(OptState));
+    opt->key = (long long*)malloc(sim->config.num_frames * sizeof(long long));
+    opt->heap = (int*)malloc(sim->config.num_frames * sizeof(int));
+    opt->heap_pos = alloc_links(sim->config.num_frames);
+    opt->heap_size = 0;
+    return opt;
+}
+
+static void opt_destroy(void *state) {
+    OptState *opt = (OptState*)state;
+    free(opt->key);
+    free(opt->heap);
+    free(opt->heap_pos);
+    free(opt);
+}
+
+static void opt_heap_swap(OptState *opt, int a, int b) {
+    int fa = opt->heap[a];
+    int fb = opt->heap[b];
+    opt->heap[a] = fb;
+    opt->heap[b] = fa;
+    opt->heap_pos[fb] = a;
+    opt->heap_pos[fa] = b;
+}
+
+static void opt_sift_up(OptState *opt, int pos) {
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (opt->key[opt->heap[parent]] >= opt->key[opt->heap[pos]]) {
+            break;
         }
+        opt_heap_swap(opt, parent, pos);
+        pos = parent;
     }
+}
+
+static void opt_sift_down(OptState *opt, int pos) {
+    int n = opt->heap_size;
+    for (;;) {
+        int left = pos * 2 + 1;
+        int largest = pos;
+        if (left < n && opt->key[opt->heap[left]] > opt->key[opt->heap[largest]]) {
+            largest = left;
+        }
+        if (left + 1 < n && opt->key[opt->heap[left + 1]] > opt->key[opt->heap[largest]]) {
+            largest = left + 1;
+        }
+        if (largest == pos) {
+            break;
+        }
+        opt_heap_swap(opt, pos, largest);
+        pos = largest;
+    }
+}
+
+// 页框被访问（命中或新装入）后更新其下次使用位置
+static void opt_update(void *state, int frame_index, int page_id, long long next_use) {
+    OptState *opt = (OptState*)state;
+    (void)page_id;
     
-    // 从页表中删除旧页面的映射
-    int old_page = sim->frames[lru_index].page_id;
-    if (old_page >= 0) {
-        sim->page_table[old_page] = -1;
+    opt->key[frame_index] = next_use;
+    if (opt->heap_pos[frame_index] == -1) {
+        // 新装入的页框（空闲或刚换出），加入堆
+        int pos = opt->heap_size++;
+        opt->heap[pos] = frame_index;
+        opt->heap_pos[frame_index] = pos;
+        opt_sift_up(opt, pos);
+    } else {
+        // 命中时键值变大需上浮，变小需下沉
+        opt_sift_up(opt, opt->heap_pos[frame_index]);
+        opt_sift_down(opt, opt->heap_pos[frame_index]);
     }
+}
+
+// 换出的页框移出堆：页框可能先用于预取，第一次被访问时才重新加入
+static void opt_on_evict(void *state, int frame_index, int page_id) {
+    OptState *opt = (OptState*)state;
+    int pos = opt->heap_pos[frame_index];
+    (void)page_id;
     
-    return lru_index;
+    opt->heap_pos[frame_index] = -1;
+    if (--opt->heap_size > pos) {
+        int last = opt->heap[opt->heap_size];
+        opt->heap[pos] = last;
+        opt->heap_pos[last] = pos;
+        opt_sift_up(opt, pos);
+        opt_sift_down(opt, opt->heap_pos[last]);
+    }
+}
+
+static int opt_choose_victim(void *state, int page_id) {
+    (void)page_id;
+    // 堆顶即下次使用最远（或不再使用）的页面
+    return ((OptState*)state)->heap[0];
 }
 
-int opt_replace(Simulator *sim, int current_index) {
+// ---------- OPT（扫描版）：每次缺页向后扫描访问序列 ----------
+
+static int opt_scan_choose_victim(void *state, int page_id) {
     // 找到未来最长时间不会使用的页面
+    Simulator *sim = (Simulator*)state;
     int *seq = sim->config.access_sequence;
-    int seq_length = sim->config.seq_length;
+    long long seq_length = sim->config.seq_length;
+    long long current_index = sim->current_time;
     int page_size = sim->config.page_size;
     int farthest_index = 0;
-    int farthest_distance = -1;
+    long long farthest_distance = -1;
+    (void)page_id;
     
     for (int i = 0; i < sim->config.num_frames; i++) {
-        if (!sim->frames[i].valid) {
-            return i; // 有空闲页框
-        }
+        int resident = sim->frames.page_id[i];
+        long long next_use = seq_length; // 默认未来不再使用
         
-        int page_id = sim->frames[i].page_id;
-        int next_use = seq_length; // 默认未来不再使用
+        // 预取缓冲中的页面尚未交给置换策略
+        if (sim->frames.prefetched != NULL &&
+            (sim->frames.prefetched[i / 64] & (1ULL << (i % 64)))) {
+            continue;
+        }
         
         // 查找页面在未来何时被使用
-        for (int j = current_index + 1; j < seq_length; j++) {
+        for (long long j = current_index + 1; j < seq_length; j++) {
             int accessed_page = seq[j] / page_size;
-            if (accessed_page == page_id) {
+            if (accessed_page == resident) {
                 next_use = j;
                 break;
             }
@@ -432,8 +2080,6 @@ int opt_replace(Simulator *sim, int current_index) {
         
         // 如果页面在未来不再使用，直接替换它
         if (next_use == seq_length) {
-            // 从页表中删除旧页面的映射
-            sim->page_table[page_id] = -1;
             return i;
         }
         
@@ -444,75 +2090,4425 @@ int opt_replace(Simulator *sim, int current_index) {
         }
     }
     
-    // 从页表中删除旧页面的映射
-    int old_page = sim->frames[farthest_index].page_id;
-    sim->page_table[old_page] = -1;
-    
     return farthest_index;
 }
 
-void simulate(Simulator *sim) {
-    Config *config = &sim->config;
-    int *seq = config->access_sequence;
-    int page_size = config->page_size;
-    
-    printf("开始模拟...\n\n");
+// ---------- CLOCK：页框组成环形队列，指针扫过时清除访问位 ----------
+
+typedef struct {
+    unsigned char *referenced;  // 每个页框的访问位
+    const uint64_t *prefetched; // 预取缓冲中的页框（不参与置换，未启用预取时为NULL）
+    int hand;                   // 时钟指针
+    int num_frames;
+} ClockState;
+
+static void *clock_create(Simulator *sim) {
+    ClockState *clock = (ClockState*)malloc(sizeof(ClockState));
+    clock->referenced = (unsigned char*)calloc(sim->config.num_frames, 1);
+    clock->prefetched = sim->frames.prefetched;
+    clock->hand = 0;
+    clock->num_frames = sim->config.num_frames;
+    return clock;
+}
+
+static void clock_destroy(void *state) {
+    ClockState *clock = (ClockState*)state;
+    free(clock->referenced);
+    free(clock);
+}
+
+static void clock_on_access(void *state, int frame_index, int page_id, long long next_use) {
+    (void)page_id;
+    (void)next_use;
+    ((ClockState*)state)->referenced[frame_index] = 1;
+}
+
+// 每个页框的访问位至多被清除一次，均摊O(1)；预取缓冲中的页框直接跳过
+static int clock_choose_victim(void *state, int page_id) {
+    ClockState *clock = (ClockState*)state;
+    (void)page_id;
     
-    for (int i = 0; i < config->seq_length; i++) {
-        sim->current_time = i;
-        int instruction_index = seq[i];
-        int page_id = instruction_index / page_size;
-        
-        // 检查页面是否在内存中
-        int frame_index = find_page_in_frames(sim, page_id);
-        
-        if (frame_index == -1) {
-            // 缺页！
-            sim->page_faults++;
-            
-            // 检查是否有空闲页框
-            bool has_free_frame = false;
-            for (int j = 0; j < config->num_frames; j++) {
-                if (!sim->frames[j].valid) {
-                    frame_index = j;
-                    has_free_frame = true;
-                    break;
-                }
-            }
-            
-            // 如果没有空闲页框，需要置换
-            if (!has_free_frame) {
-                switch (config->algorithm) {
-                    case ALG_FIFO:
-                        frame_index = fifo_replace(sim);
-                        break;
-                    case ALG_LRU:
-                        frame_index = lru_replace(sim);
-                        break;
-                    case ALG_OPT:
-                        frame_index = opt_replace(sim, i);
-                        break;
-                }
-            }
-            
-            // 加载页面
-            load_page(sim, page_id, frame_index);
+    for (;;) {
+        int hand = clock->hand;
+        if (clock->prefetched != NULL &&
+            (clock->prefetched[hand / 64] & (1ULL << (hand % 64)))) {
+            clock->hand = (hand + 1) % clock->num_frames;
+        } else if (clock->referenced[hand]) {
+            clock->referenced[hand] = 0;
+            clock->hand = (hand + 1) % clock->num_frames;
         } else {
-            // 页面命中，更新LRU信息
-            sim->frames[frame_index].last_used = i;
+            break;
         }
-        
-        // 每200条指令打印一次进度
-        if (i % 200 == 0 && i > 0) {
+    }
+    int victim = clock->hand;
+    clock->hand = (clock->hand + 1) % clock->num_frames;
+    return victim;
+}
+
+// ---------- 二次机会：FIFO队列，队首页面访问位为1时清零并移到队尾 ----------
+// 与CLOCK的置换结果相同，区别在于显式移动队列元素而不是移动指针
+
+typedef struct {
+    int *queue;                 // 页框下标组成的环形FIFO队列
+    unsigned char *referenced;
+    int front;
+    int count;
+    int num_frames;
+} SecondChanceState;
+
+static void *second_chance_create(Simulator *sim) {
+    SecondChanceState *sc = (SecondChanceState*)malloc(sizeof(SecondChanceState));
+    sc->queue = (int*)malloc(sim->config.num_frames * sizeof(int));
+    sc->referenced = (unsigned char*)calloc(sim->config.num_frames, 1);
+    sc->front = 0;
+    sc->count = 0;
+    sc->num_frames = sim->config.num_frames;
+    return sc;
+}
+
+static void second_chance_destroy(void *state) {
+    SecondChanceState *sc = (SecondChanceState*)state;
+    free(sc->queue);
+    free(sc->referenced);
+    free(sc);
+}
+
+static void second_chance_on_miss(void *state, int frame_index, int page_id, long long next_use) {
+    SecondChanceState *sc = (SecondChanceState*)state;
+    (void)page_id;
+    (void)next_use;
+    
+    sc->queue[(sc->front + sc->count) % sc->num_frames] = frame_index;
+    sc->count++;
+    sc->referenced[frame_index] = 1;
+}
+
+static void second_chance_on_hit(void *state, int frame_index, int page_id, long long next_use) {
+    (void)page_id;
+    (void)next_use;
+    ((SecondChanceState*)state)->referenced[frame_index] = 1;
+}
+
+static int second_chance_choose_victim(void *state, int page_id) {
+    SecondChanceState *sc = (SecondChanceState*)state;
+    (void)page_id;
+    
+    for (;;) {
+        int frame_index = sc->queue[sc->front];
+        sc->front = (sc->front + 1) % sc->num_frames;
+        if (!sc->referenced[frame_index]) {
+            sc->count--;
+            return frame_index;
+        }
+        // 给第二次机会：清除访问位，重新排到队尾
+        sc->referenced[frame_index] = 0;
+        sc->queue[(sc->front + sc->count - 1) % sc->num_frames] = frame_index;
+    }
+}
+
+// ---------- LFU：访问次数最少的页面被置换，次数相同时置换最久未使用的 ----------
+// 相同访问次数的页框组成一个桶，桶按次数递增串成链表，命中时页框移入下一个桶，O(1)
+
+typedef struct {
+    long long *bucket_freq; // 桶对应的访问次数
+    IndexList *bucket;      // 桶内的页框链表（头部最近使用）
+    int *bucket_prev;       // 桶链表（按次数递增）
+    int *bucket_next;
+    IndexList buckets;
+    int *free_buckets;      // 空闲桶栈
+    int num_free;
+    int *frame_bucket;      // 页框所在的桶
+    int *frame_prev;
+    int *frame_next;
+} LfuState;
+
+static void *lfu_create(Simulator *sim) {
+    int n = sim->config.num_frames;
+    LfuState *lfu = (LfuState*)malloc(sizeof(LfuState));
+    
+    // 不同访问次数至多有n种，另留一个给命中时新建的桶
+    lfu->bucket_freq = (long long*)malloc((n + 1) * sizeof(long long));
+    lfu->bucket = (IndexList*)malloc((n + 1) * sizeof(IndexList));
+    lfu->bucket_prev = alloc_links(n + 1);
+    lfu->bucket_next = alloc_links(n + 1);
+    ilist_init(&lfu->buckets);
+    lfu->free_buckets = (int*)malloc((n + 1) * sizeof(int));
+    for (int i = 0; i <= n; i++) {
+        lfu->free_buckets[i] = n - i;
+    }
+    lfu->num_free = n + 1;
+    lfu->frame_bucket = alloc_links(n);
+    lfu->frame_prev = alloc_links(n);
+    lfu->frame_next = alloc_links(n);
+    return lfu;
+}
+
+static void lfu_destroy(void *state) {
+    LfuState *lfu = (LfuState*)state;
+    free(lfu->bucket_freq);
+    free(lfu->bucket);
+    free(lfu->bucket_prev);
+    free(lfu->bucket_next);
+    free(lfu->free_buckets);
+    free(lfu->frame_bucket);
+    free(lfu->frame_prev);
+    free(lfu->frame_next);
+    free(lfu);
+}
+
+// 在after之后（after为-1时在表头）插入访问次数为freq的新桶
+static int lfu_new_bucket(LfuState *lfu, int after, long long freq) {
+    int b = lfu->free_buckets[--lfu->num_free];
+    lfu->bucket_freq[b] = freq;
+    ilist_init(&lfu->bucket[b]);
+    
+    int next = after == -1 ? lfu->buckets.head : lfu->bucket_next[after];
+    lfu->bucket_prev[b] = after;
+    lfu->bucket_next[b] = next;
+    if (after == -1) {
+        lfu->buckets.head = b;
+    } else {
+        lfu->bucket_next[after] = b;
+    }
+    if (next == -1) {
+        lfu->buckets.tail = b;
+    } else {
+        lfu->bucket_prev[next] = b;
+    }
+    lfu->buckets.size++;
+    return b;
+}
+
+// 页框移出所在的桶，桶空时回收
+static void lfu_detach(LfuState *lfu, int frame_index) {
+    int b = lfu->frame_bucket[frame_index];
+    ilist_remove(&lfu->bucket[b], lfu->frame_prev, lfu->frame_next, frame_index);
+    lfu->frame_bucket[frame_index] = -1;
+    if (lfu->bucket[b].size == 0) {
+        ilist_remove(&lfu->buckets, lfu->bucket_prev, lfu->bucket_next, b);
+        lfu->free_buckets[lfu->num_free++] = b;
+    }
+}
+
+static void lfu_on_miss(void *state, int frame_index, int page_id, long long next_use) {
+    LfuState *lfu = (LfuState*)state;
+    int b = lfu->buckets.head;
+    (void)page_id;
+    (void)next_use;
+    
+    if (b == -1 || lfu->bucket_freq[b] != 1) {
+        b = lfu_new_bucket(lfu, -1, 1);
+    }
+    ilist_push_front(&lfu->bucket[b], lfu->frame_prev, lfu->frame_next, frame_index);
+    lfu->frame_bucket[frame_index] = b;
+}
+
+static void lfu_on_hit(void *state, int frame_index, int page_id, long long next_use) {
+    LfuState *lfu = (LfuState*)state;
+    int b = lfu->frame_bucket[frame_index];
+    long long freq = lfu->bucket_freq[b] + 1;
+    int next = lfu->bucket_next[b];
+    (void)page_id;
+    (void)next_use;
+    
+    if (next == -1 || lfu->bucket_freq[next] != freq) {
+        next = lfu_new_bucket(lfu, b, freq);
+    }
+    lfu_detach(lfu, frame_index);
+    ilist_push_front(&lfu->bucket[next], lfu->frame_prev, lfu->frame_next, frame_index);
+    lfu->frame_bucket[frame_index] = next;
+}
+
+static int lfu_choose_victim(void *state, int page_id) {
+    LfuState *lfu = (LfuState*)state;
+    (void)page_id;
+    return lfu->bucket[lfu->buckets.head].tail;
+}
+
+static void lfu_on_evict(void *state, int frame_index, int page_id) {
+    (void)page_id;
+    lfu_detach((LfuState*)state, frame_index);
+}
+
+// ---------- 2Q：新页面进入FIFO队列A1in，被换出后记入A1out，
+// 在A1out中再次被访问的页面才进入LRU队列Am（Johnson & Shasha） ----------
+
+enum { Q2_NONE, Q2_A1IN, Q2_A1OUT, Q2_AM };
+
+typedef struct {
+    int *page_table;
+    int *prev;          // 按页号组织的链表节点
+    int *next;
+    unsigned char *where;
+    IndexList a1in;     // 驻留，FIFO
+    IndexList a1out;    // 不驻留，只记录页号
+    IndexList am;       // 驻留，LRU
+    int kin;            // A1in目标大小
+    int kout;           // A1out容量
+} TwoQState;
+
+static void *twoq_create(Simulator *sim) {
+    TwoQState *q = (TwoQState*)malloc(sizeof(TwoQState));
+    int num_pages = sim->config.num_pages;
+    
+    q->page_table = sim->page_table;
+    q->prev = alloc_links(num_pages);
+    q->next = alloc_links(num_pages);
+    q->where = (unsigned char*)calloc(num_pages, 1);
+    ilist_init(&q->a1in);
+    ilist_init(&q->a1out);
+    ilist_init(&q->am);
+    q->kin = sim->config.num_frames / 4 > 0 ? sim->config.num_frames / 4 : 1;
+    q->kout = sim->config.num_frames / 2 > 0 ? sim->config.num_frames / 2 : 1;
+    return q;
+}
+
+static void twoq_destroy(void *state) {
+    TwoQState *q = (TwoQState*)state;
+    free(q->prev);
+    free(q->next);
+    free(q->where);
+    free(q);
+}
+
+static void twoq_on_hit(void *state, int frame_index, int page_id, long long next_use) {
+    TwoQState *q = (TwoQState*)state;
+    (void)frame_index;
+    (void)next_use;
+    
+    // A1in中的命中不改变顺序，以免短期的重复访问把页面留在内存中
+    if (q->where[page_id] == Q2_AM) {
+        ilist_remove(&q->am, q->prev, q->next, page_id);
+        ilist_push_front(&q->am, q->prev, q->next, page_id);
+    }
+}
+
+static void twoq_on_miss(void *state, int frame_index, int page_id, long long next_use) {
+    TwoQState *q = (TwoQState*)state;
+    (void)frame_index;
+    (void)next_use;
+    
+    if (q->where[page_id] == Q2_A1OUT) {
+        ilist_remove(&q->a1out, q->prev, q->next, page_id);
+        ilist_push_front(&q->am, q->prev, q->next, page_id);
+        q->where[page_id] = Q2_AM;
+    } else {
+        ilist_push_front(&q->a1in, q->prev, q->next, page_id);
+        q->where[page_id] = Q2_A1IN;
+    }
+}
+
+static int twoq_choose_victim(void *state, int page_id) {
+    TwoQState *q = (TwoQState*)state;
+    int victim;
+    (void)page_id;
+    
+    if (q->a1in.size > q->kin || q->am.size == 0) {
+        victim = q->a1in.tail;
+    } else {
+        victim = q->am.tail;
+    }
+    return q->page_table[victim];
+}
+
+static void twoq_on_evict(void *state, int frame_index, int page_id) {
+    TwoQState *q = (TwoQState*)state;
+    (void)frame_index;
+    
+    if (q->where[page_id] == Q2_A1IN) {
+        // 从A1in换出的页面记入A1out，A1out满时丢弃最旧的记录
+        ilist_remove(&q->a1in, q->prev, q->next, page_id);
+        ilist_push_front(&q->a1out, q->prev, q->next, page_id);
+        q->where[page_id] = Q2_A1OUT;
+        if (q->a1out.size > q->kout) {
+            int oldest = q->a1out.tail;
+            ilist_remove(&q->a1out, q->prev, q->next, oldest);
+            q->where[oldest] = Q2_NONE;
+        }
+    } else {
+        ilist_remove(&q->am, q->prev, q->next, page_id);
+        q->where[page_id] = Q2_NONE;
+    }
+}
+
+// ---------- ARC：T1/T2分别保存只访问过一次和多次的驻留页面，B1/B2记录
+// 从中换出的页面，按幽灵命中自适应调整T1的目标大小p（Megiddo & Modha） ----------
+
+enum { ARC_NONE, ARC_T1, ARC_T2, ARC_B1, ARC_B2 };
+
+typedef struct {
+    int *page_table;
+    int *prev;
+    int *next;
+    unsigned char *where;
+    IndexList list[5];  // 按ARC_*下标，ARC_NONE不使用
+    int p;              // T1的目标大小
+    int c;              // 页框数
+    int evict_to;       // choose_victim决定被换出页面记入的幽灵链表（ARC_NONE表示丢弃）
+} ArcState;
+
+static void *arc_create(Simulator *sim) {
+    ArcState *arc = (ArcState*)malloc(sizeof(ArcState));
+    int num_pages = sim->config.num_pages;
+    
+    arc->page_table = sim->page_table;
+    arc->prev = alloc_links(num_pages);
+    arc->next = alloc_links(num_pages);
+    arc->where = (unsigned char*)calloc(num_pages, 1);
+    for (int i = 0; i < 5; i++) {
+        ilist_init(&arc->list[i]);
+    }
+    arc->p = 0;
+    arc->c = sim->config.num_frames;
+    arc->evict_to = ARC_NONE;
+    return arc;
+}
+
+static void arc_destroy(void *state) {
+    ArcState *arc = (ArcState*)state;
+    free(arc->prev);
+    free(arc->next);
+    free(arc->where);
+    free(arc);
+}
+
+static void arc_move(ArcState *arc, int page_id, int to) {
+    if (arc->where[page_id] != ARC_NONE) {
+        ilist_remove(&arc->list[arc->where[page_id]], arc->prev, arc->next, page_id);
+    }
+    if (to != ARC_NONE) {
+        ilist_push_front(&arc->list[to], arc->prev, arc->next, page_id);
+    }
+    arc->where[page_id] = (unsigned char)to;
+}
+
+static void arc_on_hit(void *state, int frame_index, int page_id, long long next_use) {
+    (void)frame_index;
+    (void)next_use;
+    arc_move((ArcState*)state, page_id, ARC_T2);
+}
+
+static void arc_on_miss(void *state, int frame_index, int page_id, long long next_use) {
+    ArcState *arc = (ArcState*)state;
+    (void)frame_index;
+    (void)next_use;
+    
+    // 幽灵命中说明页面被多次访问，进入T2
+    if (arc->where[page_id] == ARC_B1 || arc->where[page_id] == ARC_B2) {
+        arc_move(arc, page_id, ARC_T2);
+    } else {
+        arc_move(arc, page_id, ARC_T1);
+    }
+}
+
+// 论文中的REPLACE：T1超过目标大小时从T1换出，否则从T2换出
+static int arc_replace(ArcState *arc, int page_id) {
+    int t1 = arc->list[ARC_T1].size;
+    bool from_t1 = t1 >= 1 &&
+                   ((arc->where[page_id] == ARC_B2 && t1 == arc->p) || t1 > arc->p);
+    
+    if (arc->list[from_t1 ? ARC_T1 : ARC_T2].size == 0) {
+        from_t1 = !from_t1;
+    }
+    arc->evict_to = from_t1 ? ARC_B1 : ARC_B2;
+    return arc->list[from_t1 ? ARC_T1 : ARC_T2].tail;
+}
+
+static void arc_drop_ghost(ArcState *arc, int ghost) {
+    arc_move(arc, arc->list[ghost].tail, ARC_NONE);
+}
+
+// 页框已满时每次缺页恰好换出一个页面，对应论文的情形II~IV
+static int arc_choose_victim(void *state, int page_id) {
+    ArcState *arc = (ArcState*)state;
+    int b1 = arc->list[ARC_B1].size;
+    int b2 = arc->list[ARC_B2].size;
+    int victim;
+    
+    if (arc->where[page_id] == ARC_B1) {
+        int delta = b2 / b1 > 1 ? b2 / b1 : 1;
+        arc->p = arc->p + delta < arc->c ? arc->p + delta : arc->c;
+        victim = arc_replace(arc, page_id);
+    } else if (arc->where[page_id] == ARC_B2) {
+        int delta = b1 / b2 > 1 ? b1 / b2 : 1;
+        arc->p = arc->p - delta > 0 ? arc->p - delta : 0;
+        victim = arc_replace(arc, page_id);
+    } else if (arc->list[ARC_T1].size + b1 >= arc->c) {
+        // 预取缓冲占用页框时驻留页面少于c，T1+B1可能超过c
+        if (b1 > 0) {
+            arc_drop_ghost(arc, ARC_B1);
+            victim = arc_replace(arc, page_id);
+        } else {
+            // B1为空且T1已满：直接丢弃T1中最久的页面，不留记录
+            arc->evict_to = ARC_NONE;
+            victim = arc->list[ARC_T1].tail;
+        }
+    } else {
+        if (arc->list[ARC_T1].size + arc->list[ARC_T2].size + b1 + b2 == 2 * arc->c) {
+            arc_drop_ghost(arc, ARC_B2);
+        }
+        victim = arc_replace(arc, page_id);
+    }
+    
+    return arc->page_table[victim];
+}
+
+static void arc_on_evict(void *state, int frame_index, int page_id) {
+    ArcState *arc = (ArcState*)state;
+    (void)frame_index;
+    arc_move(arc, page_id, arc->evict_to);
+}
+
+// ---------- LIRS：按重用距离把页面分为LIR和HIR，栈S记录近期访问过的页面，
+// 队列Q保存驻留的HIR页面并从中置换（Jiang & Zhang） ----------
+
+enum { LIRS_NONE, LIRS_LIR, LIRS_HIR, LIRS_HIR_NONRES };
+
+typedef struct {
+    int *page_table;
+    int *s_prev;        // 栈S（头部为栈顶）
+    int *s_next;
+    int *q_prev;        // 队列Q（头部最新，尾部为置换对象）
+    int *q_next;
+    unsigned char *status;
+    unsigned char *in_s;
+    IndexList s;
+    IndexList q;
+    int lir_count;
+    int lir_limit;      // LIR页面数上限，其余页框（至少1个）留给驻留的HIR页面
+} LirsState;
+
+static void *lirs_create(Simulator *sim) {
+    LirsState *lirs = (LirsState*)malloc(sizeof(LirsState));
+    int num_pages = sim->config.num_pages;
+    int hir_frames = sim->config.num_frames / 100 > 0 ? sim->config.num_frames / 100 : 1;
+    
+    lirs->page_table = sim->page_table;
+    lirs->s_prev = alloc_links(num_pages);
+    lirs->s_next = alloc_links(num_pages);
+    lirs->q_prev = alloc_links(num_pages);
+    lirs->q_next = alloc_links(num_pages);
+    lirs->status = (unsigned char*)calloc(num_pages, 1);
+    lirs->in_s = (unsigned char*)calloc(num_pages, 1);
+    ilist_init(&lirs->s);
+    ilist_init(&lirs->q);
+    lirs->lir_count = 0;
+    lirs->lir_limit = sim->config.num_frames - hir_frames;
+    return lirs;
+}
+
+static void lirs_destroy(void *state) {
+    LirsState *lirs = (LirsState*)state;
+    free(lirs->s_prev);
+    free(lirs->s_next);
+    free(lirs->q_prev);
+    free(lirs->q_next);
+    free(lirs->status);
+    free(lirs->in_s);
+    free(lirs);
+}
+
+static void lirs_push_top(LirsState *lirs, int page_id) {
+    if (lirs->in_s[page_id]) {
+        ilist_remove(&lirs->s, lirs->s_prev, lirs->s_next, page_id);
+    }
+    ilist_push_front(&lirs->s, lirs->s_prev, lirs->s_next, page_id);
+    lirs->in_s[page_id] = 1;
+}
+
+// 栈剪枝：移除栈底的HIR页面，保证栈底总是LIR页面。每个页面入栈一次至多出栈一次，均摊O(1)
+static void lirs_prune(LirsState *lirs) {
+    while (lirs->s.tail != -1 && lirs->status[lirs->s.tail] != LIRS_LIR) {
+        int bottom = lirs->s.tail;
+        ilist_remove(&lirs->s, lirs->s_prev, lirs->s_next, bottom);
+        lirs->in_s[bottom] = 0;
+        if (lirs->status[bottom] == LIRS_HIR_NONRES) {
+            lirs->status[bottom] = LIRS_NONE;
+        }
+    }
+}
+
+// 把栈底的LIR页面降为HIR并移入队列Q
+static void lirs_demote_bottom(LirsState *lirs) {
+    lirs_prune(lirs);
+    int bottom = lirs->s.tail;
+    ilist_remove(&lirs->s, lirs->s_prev, lirs->s_next, bottom);
+    lirs->in_s[bottom] = 0;
+    lirs->status[bottom] = LIRS_HIR;
+    ilist_push_front(&lirs->q, lirs->q_prev, lirs->q_next, bottom);
+    lirs->lir_count--;
+    lirs_prune(lirs);
+}
+
+// 页面成为LIR；LIR页面超过上限时把栈底的LIR页面降为HIR
+static void lirs_make_lir(LirsState *lirs, int page_id) {
+    lirs->status[page_id] = LIRS_LIR;
+    lirs->lir_count++;
+    if (lirs->lir_count > lirs->lir_limit) {
+        lirs_demote_bottom(lirs);
+    }
+}
+
+static void lirs_on_hit(void *state, int frame_index, int page_id, long long next_use) {
+    LirsState *lirs = (LirsState*)state;
+    (void)frame_index;
+    (void)next_use;
+    
+    if (lirs->status[page_id] == LIRS_LIR) {
+        bool was_bottom = lirs->s.tail == page_id;
+        lirs_push_top(lirs, page_id);
+        if (was_bottom) {
+            lirs_prune(lirs);
+        }
+    } else if (lirs->in_s[page_id]) {
+        // 驻留HIR页面仍在栈中：重用距离小于栈底LIR页面，升为LIR
+        lirs_push_top(lirs, page_id);
+        ilist_remove(&lirs->q, lirs->q_prev, lirs->q_next, page_id);
+        lirs_make_lir(lirs, page_id);
+    } else {
+        lirs_push_top(lirs, page_id);
+        ilist_remove(&lirs->q, lirs->q_prev, lirs->q_next, page_id);
+        ilist_push_front(&lirs->q, lirs->q_prev, lirs->q_next, page_id);
+    }
+}
+
+static void lirs_on_miss(void *state, int frame_index, int page_id, long long next_use) {
+    LirsState *lirs = (LirsState*)state;
+    (void)frame_index;
+    (void)next_use;
+    
+    if (lirs->lir_count < lirs->lir_limit) {
+        // 预热阶段：先装满LIR页面
+        lirs_push_top(lirs, page_id);
+        lirs->status[page_id] = LIRS_LIR;
+        lirs->lir_count++;
+    } else if (lirs->status[page_id] == LIRS_HIR_NONRES) {
+        lirs_push_top(lirs, page_id);
+        lirs_make_lir(lirs, page_id);
+    } else {
+        lirs_push_top(lirs, page_id);
+        lirs->status[page_id] = LIRS_HIR;
+        ilist_push_front(&lirs->q, lirs->q_prev, lirs->q_next, page_id);
+    }
+}
+
+static int lirs_choose_victim(void *state, int page_id) {
+    LirsState *lirs = (LirsState*)state;
+    (void)page_id;
+    // 预取缓冲占用页框时驻留页面可能全是LIR，此时先把栈底的LIR页面降为HIR
+    if (lirs->q.tail == -1) {
+        lirs_demote_bottom(lirs);
+    }
+    return lirs->page_table[lirs->q.tail];
+}
+
+static void lirs_on_evict(void *state, int frame_index, int page_id) {
+    LirsState *lirs = (LirsState*)state;
+    (void)frame_index;
+    
+    // 仍在栈中的页面保留为非驻留HIR，用于判断下次访问时的重用距离
+    ilist_remove(&lirs->q, lirs->q_prev, lirs->q_next, page_id);
+    lirs->status[page_id] = lirs->in_s[page_id] ? LIRS_HIR_NONRES : LIRS_NONE;
+}
+
+// ---------- 策略表 ----------
+
+static const PolicyOps policies[] = {
+    { "fifo", "FIFO", false, false, policy_sim_create, policy_sim_destroy,
+      policy_noop_frame, policy_noop_frame, fifo_choose_victim, policy_noop_evict },
+    { "lru", "LRU", false, false, lru_create, lru_destroy,
+      lru_on_hit, lru_on_miss, lru_choose_victim, lru_on_evict },
+    { "lru-scan", "LRU（扫描版）", false, false, policy_sim_create, policy_sim_destroy,
+      policy_noop_frame, policy_noop_frame, lru_scan_choose_victim, policy_noop_evict },
+    { "opt", "OPT", true, false, opt_create, opt_destroy,
+      opt_update, opt_update, opt_choose_victim, opt_on_evict },
+    { "opt-scan", "OPT（扫描版）", false, true, policy_sim_create, policy_sim_destroy,
+      policy_noop_frame, policy_noop_frame, opt_scan_choose_victim, policy_noop_evict },
+    { "clock", "CLOCK", false, false, clock_create, clock_destroy,
+      clock_on_access, clock_on_access, clock_choose_victim, policy_noop_evict },
+    { "second-chance", "二次机会", false, false, second_chance_create, second_chance_destroy,
+      second_chance_on_hit, second_chance_on_miss, second_chance_choose_victim, policy_noop_evict },
+    { "lfu", "LFU", false, false, lfu_create, lfu_destroy,
+      lfu_on_hit, lfu_on_miss, lfu_choose_victim, lfu_on_evict },
+    { "2q", "2Q", false, false, twoq_create, twoq_destroy,
+      twoq_on_hit, twoq_on_miss, twoq_choose_victim, twoq_on_evict },
+    { "arc", "ARC", false, false, arc_create, arc_destroy,
+      arc_on_hit, arc_on_miss, arc_choose_victim, arc_on_evict },
+    { "lirs", "LIRS", false, false, lirs_create, lirs_destroy,
+      lirs_on_hit, lirs_on_miss, lirs_choose_victim, lirs_on_evict },
+};
+
+#define NUM_POLICIES ((int)(sizeof(policies) / sizeof(policies[0])))
+
+const PolicyOps *find_policy(const char *name) {
+    for (int i = 0; i < NUM_POLICIES; i++) {
+        if (strcmp(policies[i].name, name) == 0) {
+            return &policies[i];
+        }
+    }
+    return NULL;
+}
+
+// 以逗号分隔打印所有策略名
+void print_policy_names(FILE *fp) {
+    for (int i = 0; i < NUM_POLICIES; i++) {
+        fprintf(fp, "%s%s", i > 0 ? ", " : "", policies[i].name);
+    }
+}
+
+// ========== 预取器 ==========
+
+// ---------- 顺序预读：自适应窗口 ----------
+// 缺页与上次缺页相邻或落在上次预读的范围内时认为是顺序访问，窗口加倍（不超过上限），
+// 否则窗口减半直至不再预读。每次预读的第一页作为标记，访问到标记时异步预读下一个
+// 窗口，顺序访问时始终领先一个窗口
+
+#define SEQ_INITIAL_WINDOW 4
+
+typedef struct {
+    int window;             // 当前窗口
+    int max_window;
+    int last_fault;
+    int ra_start;           // 上次预读的范围
+    int ra_size;
+    int marker;             // 访问到该页时预读下一个窗口
+} SeqState;
+
+static void *seq_create(Simulator *sim) {
+    SeqState *seq = (SeqState*)malloc(sizeof(SeqState));
+    seq->max_window = sim->prefetch.max;
+    seq->window = SEQ_INITIAL_WINDOW < seq->max_window ? SEQ_INITIAL_WINDOW : seq->max_window;
+    seq->last_fault = -2;
+    seq->ra_start = 0;
+    seq->ra_size = 0;
+    seq->marker = -1;
+    return seq;
+}
+
+static void seq_destroy(void *state) {
+    free(state);
+}
+
+static int seq_on_access(void *state, int page_id, bool fault, int *pages, int max) {
+    SeqState *seq = (SeqState*)state;
+    int start;
+    
+    if (fault) {
+        bool sequential = page_id == seq->last_fault + 1 ||
+                          (page_id >= seq->ra_start && page_id < seq->ra_start + seq->ra_size);
+        seq->last_fault = page_id;
+        if (sequential) {
+            seq->window = seq->window > 0 ? seq->window * 2 : 1;
+        } else {
+            seq->window /= 2;
+        }
+        start = page_id + 1;
+    } else {
+        if (page_id != seq->marker) {
+            return 0;
+        }
+        seq->window *= 2;
+        start = seq->ra_start + seq->ra_size;
+    }
+    if (seq->window > seq->max_window) {
+        seq->window = seq->max_window;
+    }
+    
+    int n = seq->window < max ? seq->window : max;
+    for (int i = 0; i < n; i++) {
+        pages[i] = start + i;
+    }
+    if (n > 0) {
+        seq->ra_start = start;
+        seq->ra_size = n;
+        seq->marker = start;
+    }
+    return n;
+}
+
+// ---------- 步长预取 ----------
+// 相邻两次事件（缺页或第一次访问预取页）的页号差连续两次相同时，按该步长向前预取
+
+typedef struct {
+    int last;
+    int stride;
+    bool confirmed;
+} StrideState;
+
+static void *stride_create(Simulator *sim) {
+    (void)sim;
+    StrideState *st = (StrideState*)malloc(sizeof(StrideState));
+    st->last = 0;
+    st->stride = 0;
+    st->confirmed = false;
+    return st;
+}
+
+static void stride_destroy(void *state) {
+    free(state);
+}
+
+static int stride_on_access(void *state, int page_id, bool fault, int *pages, int max) {
+    StrideState *st = (StrideState*)state;
+    int delta = page_id - st->last;
+    (void)fault;
+    
+    st->confirmed = delta != 0 && delta == st->stride;
+    st->stride = delta;
+    st->last = page_id;
+    if (!st->confirmed) {
+        return 0;
+    }
+    // 在64位中计算，越界的页号不再预取（越界检查之后的页号都在int范围内）
+    int n = 0;
+    while (n < max) {
+        long long next = (long long)page_id + (long long)st->stride * (n + 1);
+        if (next < 0 || next > INT_MAX) {
+            break;
+        }
+        pages[n++] = (int)next;
+    }
+    return n;
+}
+
+// ---------- Markov预取 ----------
+// 记录每个页面之后紧接着出现的页面（每页最近的MARKOV_WAYS个，最近的在前），
+// 事件发生时预取当前页面的后继
+
+#define MARKOV_WAYS 4
+
+typedef struct {
+    int *succ;              // succ[page * MARKOV_WAYS + i]，-1表示空
+    int prev;
+} MarkovState;
+
+static void *markov_create(Simulator *sim) {
+    MarkovState *mk = (MarkovState*)malloc(sizeof(MarkovState));
+    size_t n = (size_t)sim->config.num_pages * MARKOV_WAYS;
+    mk->succ = (int*)malloc(n * sizeof(int));
+    for (size_t i = 0; i < n; i++) {
+        mk->succ[i] = -1;
+    }
+    mk->prev = -1;
+    return mk;
+}
+
+static void markov_destroy(void *state) {
+    MarkovState *mk = (MarkovState*)state;
+    free(mk->succ);
+    free(mk);
+}
+
+static int markov_on_access(void *state, int page_id, bool fault, int *pages, int max) {
+    MarkovState *mk = (MarkovState*)state;
+    (void)fault;
+    
+    if (mk->prev >= 0 && mk->prev != page_id) {
+        // 把page_id移到prev的后继表最前面
+        int *succ = mk->succ + (size_t)mk->prev * MARKOV_WAYS;
+        int pos = MARKOV_WAYS - 1;
+        for (int i = 0; i < MARKOV_WAYS - 1; i++) {
+            if (succ[i] == page_id) {
+                pos = i;
+                break;
+            }
+        }
+        memmove(succ + 1, succ, pos * sizeof(int));
+        succ[0] = page_id;
+    }
+    mk->prev = page_id;
+    
+    const int *succ = mk->succ + (size_t)page_id * MARKOV_WAYS;
+    int n = 0;
+    for (int i = 0; i < MARKOV_WAYS && n < max && succ[i] >= 0; i++) {
+        pages[n++] = succ[i];
+    }
+    return n;
+}
+
+static const PrefetchOps prefetchers[] = {
+    { "seq", "顺序预读（自适应窗口）", seq_create, seq_destroy, seq_on_access },
+    { "stride", "步长预取", stride_create, stride_destroy, stride_on_access },
+    { "markov", "Markov预取", markov_create, markov_destroy, markov_on_access },
+};
+
+#define NUM_PREFETCHERS ((int)(sizeof(prefetchers) / sizeof(prefetchers[0])))
+
+const PrefetchOps *find_prefetcher(const char *name) {
+    for (int i = 0; i < NUM_PREFETCHERS; i++) {
+        if (strcmp(prefetchers[i].name, name) == 0) {
+            return &prefetchers[i];
+        }
+    }
+    return NULL;
+}
+
+void print_prefetcher_names(FILE *fp) {
+    for (int i = 0; i < NUM_PREFETCHERS; i++) {
+        fprintf(fp, "%s%s", i > 0 ? ", " : "", prefetchers[i].name);
+    }
+}
+
+// ---------- 换页I/O代价 ----------
+
+static inline bool frame_dirty(const Simulator *sim, int frame_index) {
+    return (sim->frames.dirty[frame_index / 64] >> (frame_index % 64)) & 1;
+}
+
+static inline void frame_clear_dirty(Simulator *sim, int frame_index) {
+    sim->frames.dirty[frame_index / 64] &= ~(1ULL << (frame_index % 64));
+}
+
+// 在磁盘上排队执行一次耗时duration的请求，返回完成时刻
+static inline double disk_submit(IoState *io, double ready_us, double duration) {
+    double start = io->disk_free_us > ready_us ? io->disk_free_us : ready_us;
+    io->disk_free_us = start + duration;
+    return io->disk_free_us;
+}
+
+// 后台刷写：磁盘空闲时按变脏的先后顺序检查队首的页面，只写回至少num_frames次
+// 访问没有被访问过的页面（即将被换出、不太可能再被写）。出队时页面已被换出或已写回
+// 则丢弃；队首页面仍在使用时放回队尾并结束本次检查，每次访问至多放回一个页面，
+// 丢弃和写回的页面每次变脏只入队一次，均摊O(1)
+static void io_flush(Simulator *sim) {
+    IoState *io = &sim->io;
+    int capacity = sim->config.disk.flush_queue;
+    
+    while (io->flush_count > 0 && io->disk_free_us <= io->clock_us) {
+        int head = io->flush_head;
+        int frame_index = io->flush_frame[head];
+        int page_id = io->flush_page[head];
+        io->flush_head = (head + 1) % capacity;
+        io->flush_count--;
+        if (sim->frames.page_id[frame_index] != page_id || !frame_dirty(sim, frame_index)) {
+            continue;
+        }
+        if (sim->current_time - sim->frames.last_used[frame_index] < sim->config.num_frames) {
+            int tail = (io->flush_head + io->flush_count) % capacity;
+            io->flush_frame[tail] = frame_index;
+            io->flush_page[tail] = page_id;
+            io->flush_count++;
+            break;
+        }
+        disk_submit(io, io->clock_us, sim->config.disk.write_us);
+        frame_clear_dirty(sim, frame_index);
+        io->flushes++;
+    }
+}
+
+// 写访问：页面变脏时放入后台刷写队列（队列已满则只能在换出时同步写回）
+static void io_mark_dirty(Simulator *sim, int frame_index, int page_id) {
+    IoState *io = &sim->io;
+    int capacity = sim->config.disk.flush_queue;
+    
+    io->writes++;
+    if (frame_dirty(sim, frame_index)) {
+        return;
+    }
+    sim->frames.dirty[frame_index / 64] |= 1ULL << (frame_index % 64);
+    if (io->flush_count < capacity) {
+        int tail = (io->flush_head + io->flush_count) % capacity;
+        io->flush_frame[tail] = frame_index;
+        io->flush_page[tail] = page_id;
+        io->flush_count++;
+    }
+}
+
+// 缺页：换出的页面为脏时先同步写回，再读入新页面，进程等待到读入完成
+static void io_page_fault(Simulator *sim, int victim_frame) {
+    IoState *io = &sim->io;
+    const DiskModel *disk = &sim->config.disk;
+    
+    io_flush(sim);
+    if (victim_frame >= 0 && frame_dirty(sim, victim_frame)) {
+        disk_submit(io, io->clock_us, disk->write_us);
+        frame_clear_dirty(sim, victim_frame);
+        io->writebacks++;
+    }
+    double done = disk_submit(io, io->clock_us, disk->read_us);
+    io->stall_us += done - io->clock_us;
+    io->clock_us = done;
+}
+
+// 生成的访问序列中第index次访问是否为写：按种子和位置哈希，不需要额外存储
+bool access_is_write(const Config *config, long long index) {
+    if (config->write_ratio <= 0) {
+        return false;
+    }
+    uint64_t x = config->seed ^ ((uint64_t)index * 0xA0761D6478BD642FULL);
+    return (splitmix64(&x) >> 32) < prob32(config->write_ratio);
+}
+
+// ========== 真实内存回放 ==========
+
+// 每个模拟页面对应映射区域中的一个系统页。模拟器换出页面时对该系统页调用madvise，
+// 使区域中驻留的页数始终不超过页框数；每次访问读或写该页的第一个字节，
+// 由内核产生真实的缺页
+int real_init(Simulator *sim) {
+    RealMemory *rm = &sim->real;
+    
+    rm->page_bytes = sysconf(_SC_PAGESIZE);
+    rm->length = (size_t)sim->config.num_pages * rm->page_bytes;
+    rm->base = (char*)mmap(NULL, rm->length, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (rm->base == MAP_FAILED) {
+        perror("mmap");
+        rm->base = NULL;
+        return -1;
+    }
+    // 透明大页会把相邻的模拟页面合并为一个2MB页，按页换出时需要逐页控制
+    madvise(rm->base, rm->length, MADV_NOHUGEPAGE);
+    
+    rm->advice = sim->config.real_mode == REAL_PAGEOUT ? MADV_PAGEOUT : MADV_DONTNEED;
+    if (madvise(rm->base, rm->page_bytes, rm->advice) < 0) {
+        perror(sim->config.real_mode == REAL_PAGEOUT ? "madvise(MADV_PAGEOUT)" :
+               "madvise(MADV_DONTNEED)");
+        munmap(rm->base, rm->length);
+        rm->base = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static inline double real_elapsed_ns(const struct timespec *a, const struct timespec *b) {
+    return (double)(b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec);
+}
+
+// 访问页面的第一个字节。模拟缺页的访问单独计时，即真实缺页的延迟
+static inline void real_touch(Simulator *sim, int page_id, bool fault, bool write) {
+    RealMemory *rm = &sim->real;
+    volatile char *p = rm->base + (size_t)page_id * rm->page_bytes;
+    struct timespec t0, t1;
+    
+    if (fault) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+    }
+    // 写访问直接写入，不先读，否则未驻留的页面会先映射共享零页再写时复制，缺页两次
+    if (write) {
+        *p = 1;
+    } else {
+        rm->sink += *p;
+    }
+    if (fault) {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        rm->fault_touches++;
+        rm->fault_ns += real_elapsed_ns(&t0, &t1);
+    }
+}
+
+static void real_evict(Simulator *sim, int page_id) {
+    RealMemory *rm = &sim->real;
+    struct timespec t0, t1;
+    
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int ret = madvise(rm->base + (size_t)page_id * rm->page_bytes, rm->page_bytes, rm->advice);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (ret < 0 && rm->evict_failures++ == 0) {
+        rm->evict_errno = errno;
+    }
+    rm->evictions++;
+    rm->evict_ns += real_elapsed_ns(&t0, &t1);
+}
+
+// 回放开始和结束时各取一次进程的缺页计数和时间
+void real_begin(Simulator *sim) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    sim->real.minflt = usage.ru_minflt;
+    sim->real.majflt = usage.ru_majflt;
+    clock_gettime(CLOCK_MONOTONIC, &sim->real.start);
+}
+
+void real_end(Simulator *sim) {
+    RealMemory *rm = &sim->real;
+    struct rusage usage;
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    getrusage(RUSAGE_SELF, &usage);
+    rm->minflt = usage.ru_minflt - rm->minflt;
+    rm->majflt = usage.ru_majflt - rm->majflt;
+    rm->seconds = real_elapsed_ns(&rm->start, &now) / 1e9;
+    
+    // 用mincore检查预算是否生效
+    unsigned char *vec = (unsigned char*)malloc(sim->config.num_pages);
+    rm->resident = -1;
+    if (vec != NULL && mincore(rm->base, rm->length, vec) == 0) {
+        rm->resident = 0;
+        for (int i = 0; i < sim->config.num_pages; i++) {
+            rm->resident += vec[i] & 1;
+        }
+    }
+    free(vec);
+}
+
+// 模拟代价与真实代价对照。真实缺页计数来自getrusage，包含模拟器自身数据结构首次访问的
+// 少量缺页；读后再写的页面在读时映射共享零页、写时才分配，会比模拟多一次缺页
+void real_print(Simulator *sim) {
+    const RealMemory *rm = &sim->real;
+    const Config *config = &sim->config;
+    double sim_fault_us = config->disk.read_us;
+    double real_fault_us = rm->fault_touches > 0 ? rm->fault_ns / rm->fault_touches / 1000 : 0;
+    
+    printf("\n=== 真实内存回放 ===\n");
+    printf("换出方式: %s\n", config->real_mode == REAL_PAGEOUT ? "MADV_PAGEOUT" : "MADV_DONTNEED");
+    printf("映射区域: %d页 × %ld字节\n", config->num_pages, rm->page_bytes);
+    if (rm->resident >= 0) {
+        printf("结束时驻留页数: %lld（页框数%d）\n", rm->resident, config->num_frames);
+        if (rm->resident > config->num_frames) {
+            // 匿名页只能回收到交换区，没有交换分区时MADV_PAGEOUT不起作用
+            printf("驻留页数超出预算：内核未回收页面（没有可用的交换分区？），可改用-r dontneed\n");
+        }
+    }
+    printf("缺页次数: 模拟 %lld，实际 %ld（其中主缺页 %ld）\n",
+           sim->page_faults, rm->minflt + rm->majflt, rm->majflt);
+    printf("每次缺页代价: 模拟 %.3f us，实际 %.3f us\n", sim_fault_us, real_fault_us);
+    printf("每次换出代价: 实际 %.3f us（madvise %lld次）\n",
+           rm->evictions > 0 ? rm->evict_ns / rm->evictions / 1000 : 0, rm->evictions);
+    if (rm->evict_failures > 0) {
+        // 换出失败的页面仍然驻留，实际缺页次数和代价不能与模拟对照
+        printf("madvise失败 %lld次（%s），这些页面没有被换出，实际数据偏低\n",
+               rm->evict_failures, strerror(rm->evict_errno));
+    }
+    printf("有效访问时间: 模拟 %.3f us，实际 %.3f us\n", sim->io.clock_us / config->seq_length,
+           rm->seconds * 1e6 / config->seq_length);
+    printf("实际回放用时: %.6f 秒（含模拟器本身的开销）\n", rm->seconds);
+}
+
+// 为page_id取得一个页框：有空闲页框时直接使用，否则由策略选出置换的页框并换出其中的
+// 页面。*evicted表示是否换出了页面（换出的页框需按脏位处理I/O）。by_prefetch表示
+// 页框用于预取，被挤出的页面之后再缺页时计为预取污染
+static int take_frame(Simulator *sim, int page_id, bool by_prefetch, bool *evicted) {
+    // 页框按下标顺序装入，下一个空闲页框即used_frames
+    if (sim->used_frames < sim->config.num_frames) {
+        *evicted = false;
+        return sim->used_frames++;
+    }
+    
+    int frame_index = sim->config.policy->choose_victim(sim->policy_state, page_id);
+    int old_page = sim->frames.page_id[frame_index];
+    sim->config.policy->on_evict(sim->policy_state, frame_index, old_page);
+    *evicted = true;
+    
+    if (by_prefetch) {
+        sim->prefetch.evicted[old_page / 64] |= 1ULL << (old_page % 64);
+    }
+    
+    if (sim->real.base != NULL) {
+        real_evict(sim, old_page);
+    }
+    
+    // 从页表中删除旧页面的映射
+    sim->page_table[old_page] = -1;
+    return frame_index;
+}
+
+// 预取缓冲已满：挤出最早预取、一直未被访问的页面，返回空出的页框
+static int recycle_prefetched(Simulator *sim) {
+    PrefetchStats *pf = &sim->prefetch;
+    int frame_index = pf->buffer.tail;
+    int old_page = sim->frames.page_id[frame_index];
+    
+    ilist_remove(&pf->buffer, pf->buf_prev, pf->buf_next, frame_index);
+    sim->frames.prefetched[frame_index / 64] &= ~(1ULL << (frame_index % 64));
+    pf->unused++;
+    if (sim->real.base != NULL) {
+        real_evict(sim, old_page);
+    }
+    sim->page_table[old_page] = -1;
+    return frame_index;
+}
+
+// 预取：按预取器给出的页号把不在内存中的页面装入页框。预取缓冲未满时由当前策略选择
+// 置换对象，已满时挤出缓冲中最早预取的页面。读入异步进行，只占用磁盘，进程在读入
+// 完成前访问该页面时才需要等待
+static void prefetch_pages(Simulator *sim, int page_id, bool fault) {
+    PrefetchStats *pf = &sim->prefetch;
+    int n = sim->config.prefetcher->on_access(sim->prefetch_state, page_id, fault,
+                                              pf->pages, pf->max);
+    
+    for (int i = 0; i < n; i++) {
+        int page = pf->pages[i];
+        if (page < 0 || page >= sim->config.num_pages || sim->page_table[page] != -1) {
+            continue;
+        }
+        bool evicted = false;
+        int frame_index = pf->buffer.size >= pf->capacity ? recycle_prefetched(sim) :
+                          take_frame(sim, page, true, &evicted);
+        if (evicted && frame_dirty(sim, frame_index)) {
+            disk_submit(&sim->io, sim->io.clock_us, sim->config.disk.write_us);
+            frame_clear_dirty(sim, frame_index);
+            sim->io.writebacks++;
+        }
+        pf->ready_us[frame_index] = disk_submit(&sim->io, sim->io.clock_us,
+                                                sim->config.disk.read_us);
+        
+        load_page(sim, page, frame_index);
+        sim->frames.prefetched[frame_index / 64] |= 1ULL << (frame_index % 64);
+        pf->evicted[page / 64] &= ~(1ULL << (page % 64));
+        pf->issued++;
+        // 第一次访问之前不交给置换策略（否则未访问的预取页面在LRU类策略中最早被换出，
+        // OPT也不知道它何时被访问）。扫描页框表的策略按时间取最小值，置为最大值使其不被选中
+        sim->frames.load_time[frame_index] = LLONG_MAX;
+        sim->frames.last_used[frame_index] = LLONG_MAX;
+        ilist_push_front(&pf->buffer, pf->buf_prev, pf->buf_next, frame_index);
+    }
+}
+
+// 处理一次页面访问：命中时通知策略，缺页时分配空闲页框或由策略选出置换的页框。
+// index为访问在序列中的位置，next_use为该页面下一次被访问的位置（仅OPT使用），
+// write表示写访问（页面变脏，换出时需要写回）
+void access_page(Simulator *sim, int page_id, long long index, long long next_use, bool write) {
+    const PolicyOps *policy = sim->config.policy;
+    sim->current_time = index;
+    
+    // 检查页面是否在内存中
+    int frame_index = find_page_in_frames(sim, page_id);
+    bool fault = frame_index == -1;
+    bool prefetch = false;  // 缺页或第一次访问预取的页面时触发预取
+    
+    if (fault) {
+        // 缺页！
+        sim->page_faults++;
+        
+        bool evicted;
+        frame_index = take_frame(sim, page_id, false, &evicted);
+        io_page_fault(sim, evicted ? frame_index : -1);
+        
+        // 加载页面
+        load_page(sim, page_id, frame_index);
+        policy->on_miss(sim->policy_state, frame_index, page_id, next_use);
+        
+        if (sim->config.prefetcher != NULL) {
+            uint64_t *evicted_bits = &sim->prefetch.evicted[page_id / 64];
+            if (*evicted_bits & (1ULL << (page_id % 64))) {
+                *evicted_bits &= ~(1ULL << (page_id % 64));
+                sim->prefetch.pollution++;
+            }
+            prefetch = true;
+        }
+    } else {
+        // 页面命中，更新LRU信息
+        sim->frames.last_used[frame_index] = index;
+        
+        if (sim->config.prefetcher != NULL &&
+            (sim->frames.prefetched[frame_index / 64] & (1ULL << (frame_index % 64)))) {
+            // 第一次访问预取进来的页面：移出预取缓冲，按这次访问时装入交给置换策略
+            sim->frames.prefetched[frame_index / 64] &= ~(1ULL << (frame_index % 64));
+            ilist_remove(&sim->prefetch.buffer, sim->prefetch.buf_prev, sim->prefetch.buf_next,
+                         frame_index);
+            sim->frames.load_time[frame_index] = index;
+            policy->on_miss(sim->policy_state, frame_index, page_id, next_use);
+            sim->prefetch.useful++;
+            prefetch = true;
+            double ready = sim->prefetch.ready_us[frame_index];
+            if (ready > sim->io.clock_us) {
+                sim->io.stall_us += ready - sim->io.clock_us;
+                sim->io.clock_us = ready;
+            }
+        } else {
+            policy->on_hit(sim->policy_state, frame_index, page_id, next_use);
+        }
+    }
+    
+    if (write) {
+        io_mark_dirty(sim, frame_index, page_id);
+    }
+    // 在记录写访问之后预取，预取可能换出刚访问的页面
+    if (prefetch) {
+        prefetch_pages(sim, page_id, fault);
+    }
+    sim->io.clock_us += sim->config.disk.mem_us;
+    if (sim->io.flush_count > 0) {
+        io_flush(sim);
+    }
+    if (sim->real.base != NULL) {
+        real_touch(sim, page_id, fault, write);
+    }
+}
+
+void simulate(Simulator *sim) {
+    Config *config = &sim->config;
+    int *seq = config->access_sequence;
+    int page_size = config->page_size;
+    
+    if (!config->quiet) {
+        printf("开始模拟...\n\n");
+    }
+    
+    if (config->policy->needs_next_use && sim->owns_next_use) {
+        opt_prepare(sim);
+    }
+    if (sim->real.base != NULL) {
+        real_begin(sim);
+    }
+    
+    for (long long i = 0; i < config->seq_length; i++) {
+        int instruction_index = seq[i];
+        int page_id = instruction_index / page_size;
+        
+        access_page(sim, page_id, i, sim->next_use != NULL ? sim->next_use[i] : 0,
+                    access_is_write(config, i));
+        
+        // 每200条指令打印一次进度（真实内存回放时不打印，避免计入回放用时）
+        if (!config->quiet && sim->real.base == NULL && i % 200 == 0 && i > 0) {
             print_progress(i, config->seq_length);
         }
     }
     
-    printf("\n模拟完成！\n\n");
+    if (sim->real.base != NULL) {
+        real_end(sim);
+    }
+    if (!config->quiet) {
+        printf("\n模拟完成！\n\n");
+    }
+}
+
+// ========== 二进制trace文件 ==========
+
+// 映射文件中[offset, offset+length)区间（偏移按系统页对齐），先解除*base处的旧窗口。
+// 返回区间起始地址，失败返回NULL
+static void *map_window(int fd, off_t offset, size_t length, int prot,
+                        void **base, size_t *map_len) {
+    long sys_page = sysconf(_SC_PAGESIZE);
+    off_t aligned = offset - offset % sys_page;
+    size_t len = length + (size_t)(offset - aligned);
+    
+    if (*base != NULL) {
+        munmap(*base, *map_len);
+    }
+    *base = mmap(NULL, len, prot, MAP_SHARED, fd, aligned);
+    if (*base == MAP_FAILED) {
+        perror("mmap");
+        *base = NULL;
+        *map_len = 0;
+        return NULL;
+    }
+    *map_len = len;
+    madvise(*base, len, MADV_WILLNEED);
+    
+    return (char*)*base + (offset - aligned);
+}
+
+// 记录中的原始页号（地址记录换算为页号），不做压缩编号
+static inline long long trace_raw_page(const TraceFile *trace, uint64_t record) {
+    record &= ~TRACE_WRITE_FLAG;
+    if (trace->record_type == TRACE_RECORD_ADDR) {
+        return (long long)(record / (uint64_t)trace->page_size);
+    }
+    return (long long)record;
+}
+
+static inline size_t pageid_hash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (size_t)key;
+}
+
+// 查找原始页号所在的槽位（不存在时为应插入的空槽）
+static inline size_t pageid_slot(const PageIdMap *ids, uint64_t key) {
+    size_t i = pageid_hash(key) & ids->mask;
+    while (ids->keys[i] != key && ids->keys[i] != PAGEID_EMPTY) {
+        i = (i + 1) & ids->mask;
+    }
+    return i;
+}
+
+// 模拟使用的页号：有压缩编号时查表，trace中的每个页面在扫描时都已编号
+static inline long long trace_page_id(const TraceFile *trace, uint64_t record) {
+    long long page = trace_raw_page(trace, record);
+    if (trace->ids != NULL) {
+        return trace->ids->values[pageid_slot(trace->ids, (uint64_t)page)];
+    }
+    return page;
+}
+
+int trace_open(TraceFile *trace, const char *path, int default_page_size) {
+    TraceHeader header;
+    struct stat st;
+    
+    trace->map_base = NULL;
+    trace->map_len = 0;
+    trace->ids = NULL;
+    trace->fd = open(path, O_RDONLY);
+    if (trace->fd < 0) {
+        perror("open trace");
+        return -1;
+    }
+    
+    if (pread(trace->fd, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+        header.version != TRACE_VERSION ||
+        (header.record_type != TRACE_RECORD_PAGE && header.record_type != TRACE_RECORD_ADDR)) {
+        fprintf(stderr, "不是有效的trace文件: %s\n", path);
+        close(trace->fd);
+        return -1;
+    }
+    
+    if (fstat(trace->fd, &st) < 0) {
+        perror("fstat trace");
+        close(trace->fd);
+        return -1;
+    }
+    
+    // 记录数为0表示由文件大小决定（写入时未知长度）
+    long long available = (st.st_size - (off_t)sizeof(header)) / (off_t)sizeof(uint64_t);
+    trace->num_records = header.num_records != 0 ? (long long)header.num_records : available;
+    if (trace->num_records > available) {
+        fprintf(stderr, "trace文件被截断: 应有%lld条记录，实际%lld条\n",
+                trace->num_records, available);
+        close(trace->fd);
+        return -1;
+    }
+    if (trace->num_records <= 0) {
+        fprintf(stderr, "trace文件为空: %s\n", path);
+        close(trace->fd);
+        return -1;
+    }
+    
+    trace->record_type = (int)header.record_type;
+    trace->page_size = header.page_size != 0 ? (long long)header.page_size : default_page_size;
+    
+    return 0;
+}
+
+// 映射第start条起的count条记录，返回记录数组；之前映射的窗口随之失效
+const uint64_t *trace_map(TraceFile *trace, long long start, long long count) {
+    return (const uint64_t*)map_window(trace->fd,
+                                       (off_t)sizeof(TraceHeader) + start * (off_t)sizeof(uint64_t),
+                                       count * sizeof(uint64_t), PROT_READ,
+                                       &trace->map_base, &trace->map_len);
+}
+
+static void pageid_alloc(PageIdMap *ids, size_t capacity) {
+    ids->keys = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    ids->values = (int*)malloc(capacity * sizeof(int));
+    ids->mask = capacity - 1;
+    ids->size = 0;
+    for (size_t i = 0; i < capacity; i++) {
+        ids->keys[i] = PAGEID_EMPTY;
+    }
+}
+
+void pageid_free(PageIdMap *ids) {
+    free(ids->keys);
+    free(ids->values);
+    ids->keys = NULL;
+    ids->values = NULL;
+    ids->size = 0;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// 正向扫描一遍trace，统计不同页面的个数作为页表大小。页号本来就是0..N-1时直接使用；
+// 否则（如未压缩的虚拟页号）按原始页号排序后压缩编号，建立的映射存入ids并设置
+// trace->ids，各种表都按不同页面数分配，与原始页号的大小无关。ids由调用者用pageid_free释放
+int trace_scan_pages(TraceFile *trace, PageIdMap *ids, int *num_pages) {
+    long long max_page = -1;
+    
+    trace->ids = NULL;
+    pageid_alloc(ids, 1 << 16);
+    for (long long start = 0; start < trace->num_records; start += TRACE_WINDOW_RECORDS) {
+        long long count = trace->num_records - start;
+        if (count > TRACE_WINDOW_RECORDS) {
+            count = TRACE_WINDOW_RECORDS;
+        }
+        const uint64_t *records = trace_map(trace, start, count);
+        if (records == NULL) {
+            pageid_free(ids);
+            return -1;
+        }
+        for (long long k = 0; k < count; k++) {
+            long long page_id = trace_raw_page(trace, records[k]);
+            size_t slot = pageid_slot(ids, (uint64_t)page_id);
+            if (ids->keys[slot] != PAGEID_EMPTY) {
+                continue;
+            }
+            if (ids->size == INT_MAX - 1) {
+                fprintf(stderr, "trace中不同的页面过多（超过%d个）\n", INT_MAX - 1);
+                pageid_free(ids);
+                return -1;
+            }
+            ids->keys[slot] = (uint64_t)page_id;
+            ids->size++;
+            if (page_id > max_page) {
+                max_page = page_id;
+            }
+            // 装填率超过一半时扩容
+            if ((size_t)ids->size * 2 > ids->mask + 1) {
+                PageIdMap old = *ids;
+                pageid_alloc(ids, (old.mask + 1) * 2);
+                for (size_t i = 0; i <= old.mask; i++) {
+                    if (old.keys[i] != PAGEID_EMPTY) {
+                        ids->keys[pageid_slot(ids, old.keys[i])] = old.keys[i];
+                    }
+                }
+                ids->size = old.size;
+                pageid_free(&old);
+            }
+        }
+    }
+    
+    *num_pages = ids->size;
+    if (max_page + 1 == ids->size) {
+        // 页号恰好是0..N-1，不需要映射
+        pageid_free(ids);
+        return 0;
+    }
+    
+    // 按原始页号排序后依次编号
+    uint64_t *sorted = (uint64_t*)malloc((size_t)ids->size * sizeof(uint64_t));
+    int n = 0;
+    for (size_t i = 0; i <= ids->mask; i++) {
+        if (ids->keys[i] != PAGEID_EMPTY) {
+            sorted[n++] = ids->keys[i];
+        }
+    }
+    qsort(sorted, n, sizeof(uint64_t), cmp_u64);
+    for (int r = 0; r < n; r++) {
+        ids->values[pageid_slot(ids, sorted[r])] = r;
+    }
+    free(sorted);
+    trace->ids = ids;
+    return 0;
+}
+
+void trace_close(TraceFile *trace) {
+    if (trace->map_base != NULL) {
+        munmap(trace->map_base, trace->map_len);
+        trace->map_base = NULL;
+    }
+    close(trace->fd);
+}
+
+// 以地址记录的形式导出访问序列：地址和页大小都按INSN_BYTES换算为字节，与程序实际访问的
+// trace单位相同，回放时页号不变，缓存模拟时与直接模拟生成的序列结果一致
+int trace_export(const char *path, const Config *config) {
+    const int *seq = config->access_sequence;
+    long long length = config->seq_length;
+    TraceHeader header;
+    uint64_t buffer[4096];
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        perror("fopen trace");
+        return -1;
+    }
+    
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header.version = TRACE_VERSION;
+    header.record_type = TRACE_RECORD_ADDR;
+    header.page_size = (uint64_t)config->page_size * INSN_BYTES;
+    header.num_records = (uint64_t)length;
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+        perror("fwrite trace");
+        fclose(fp);
+        return -1;
+    }
+    
+    for (long long start = 0; start < length; start += 4096) {
+        long long count = length - start < 4096 ? length - start : 4096;
+        for (long long k = 0; k < count; k++) {
+            buffer[k] = (uint64_t)seq[start + k] * INSN_BYTES;
+            if (access_is_write(config, start + k)) {
+                buffer[k] |= TRACE_WRITE_FLAG;
+            }
+        }
+        if (fwrite(buffer, sizeof(uint64_t), count, fp) != (size_t)count) {
+            perror("fwrite trace");
+            fclose(fp);
+            return -1;
+        }
+    }
+    
+    if (fclose(fp) != 0) {
+        perror("fclose trace");
+        return -1;
+    }
+    return 0;
+}
+
+// trace模式的OPT预处理：逐窗口反向扫描trace，把每次访问的下次使用位置写入
+// 临时文件（创建后即unlink），正向模拟时与trace窗口同步映射。返回文件描述符
+int opt_prepare_trace(Simulator *sim) {
+    Config *config = &sim->config;
+    TraceFile *trace = sim->trace;
+    long long n = trace->num_records;
+    const char *tmpdir = getenv("TMPDIR");
+    char path[256];
+    void *next_base = NULL;
+    size_t next_len = 0;
+    
+    snprintf(path, sizeof(path), "%s/page_replace_opt_XXXXXX", tmpdir ? tmpdir : "/tmp");
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return -1;
+    }
+    unlink(path);
+    if (ftruncate(fd, n * (off_t)sizeof(long long)) < 0) {
+        perror("ftruncate");
+        close(fd);
+        return -1;
+    }
+    
+    long long *last_seen = (long long*)malloc(config->num_pages * sizeof(long long));
+    for (int i = 0; i < config->num_pages; i++) {
+        last_seen[i] = n; // 未来不再使用
+    }
+    
+    for (long long start = (n - 1) / TRACE_WINDOW_RECORDS * TRACE_WINDOW_RECORDS;
+         start >= 0; start -= TRACE_WINDOW_RECORDS) {
+        long long count = n - start < TRACE_WINDOW_RECORDS ? n - start : TRACE_WINDOW_RECORDS;
+        const uint64_t *records = trace_map(trace, start, count);
+        long long *next_use = (long long*)map_window(fd, start * (off_t)sizeof(long long),
+                                                     count * sizeof(long long),
+                                                     PROT_READ | PROT_WRITE,
+                                                     &next_base, &next_len);
+        if (records == NULL || next_use == NULL) {
+            free(last_seen);
+            if (next_base != NULL) {
+                munmap(next_base, next_len);
+            }
+            close(fd);
+            return -1;
+        }
+        for (long long k = count - 1; k >= 0; k--) {
+            long long page_id = trace_page_id(trace, records[k]);
+            next_use[k] = last_seen[page_id];
+            last_seen[page_id] = start + k;
+        }
+    }
+    
+    munmap(next_base, next_len);
+    free(last_seen);
+    return fd;
+}
+
+// trace回放：按窗口映射trace文件逐条模拟，内存占用与trace长度无关
+int simulate_trace(Simulator *sim) {
+    Config *config = &sim->config;
+    TraceFile *trace = sim->trace;
+    long long n = trace->num_records;
+    int next_use_fd = sim->next_use_fd;
+    void *next_base = NULL;
+    size_t next_len = 0;
+    int last_percent = 0;
+    int ret = 0;
+    
+    if (!config->quiet) {
+        printf("开始模拟...\n\n");
+    }
+    
+    if (config->policy->needs_next_use && next_use_fd < 0) {
+        next_use_fd = opt_prepare_trace(sim);
+        if (next_use_fd < 0) {
+            return -1;
+        }
+    }
+    
+    for (long long start = 0; start < n; start += TRACE_WINDOW_RECORDS) {
+        long long count = n - start < TRACE_WINDOW_RECORDS ? n - start : TRACE_WINDOW_RECORDS;
+        const uint64_t *records = trace_map(trace, start, count);
+        const long long *next_use = NULL;
+        if (records == NULL) {
+            ret = -1;
+            break;
+        }
+        if (next_use_fd >= 0) {
+            next_use = (const long long*)map_window(next_use_fd, start * (off_t)sizeof(long long),
+                                                    count * sizeof(long long), PROT_READ,
+                                                    &next_base, &next_len);
+            if (next_use == NULL) {
+                ret = -1;
+                break;
+            }
+        }
+        
+        for (long long k = 0; k < count; k++) {
+            access_page(sim, (int)trace_page_id(trace, records[k]), start + k,
+                        next_use != NULL ? next_use[k] : 0,
+                        (records[k] & TRACE_WRITE_FLAG) != 0);
+        }
+        
+        // 每完成5%打印一次进度
+        int percent = (int)((start + count) * 100 / n);
+        if (percent / 5 > last_percent / 5 && start + count < n && !config->quiet) {
+            print_progress(start + count, n);
+            last_percent = percent;
+        }
+    }
+    
+    if (next_use_fd >= 0) {
+        if (next_base != NULL) {
+            munmap(next_base, next_len);
+        }
+        if (next_use_fd != sim->next_use_fd) {
+            close(next_use_fd);
+        }
+    }
+    if (ret < 0) {
+        return -1;
+    }
+    
+    if (!config->quiet) {
+        printf("\n模拟完成！\n\n");
+    }
+    return 0;
+}
+
+// ========== 流式输入 ==========
+
+// 标准输入（-）、FIFO、管道等不能mmap的输入按流读取
+bool trace_is_stream(const char *path) {
+    struct stat st;
+    if (strcmp(path, "-") == 0) {
+        return true;
+    }
+    return stat(path, &st) == 0 && !S_ISREG(st.st_mode);
+}
+
+// 读满len字节，返回实际读到的字节数（遇到文件结束时小于len），出错返回-1
+static ssize_t read_full(int fd, void *buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t got = read(fd, (char*)buf + done, len - done);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            break;
+        }
+        done += (size_t)got;
+    }
+    return (ssize_t)done;
+}
+
+// 打开流式输入并读入文件头。流中的记录数未知，num_records置为0
+int trace_open_stream(TraceFile *trace, const char *path, int default_page_size) {
+    TraceHeader header;
+    
+    trace->map_base = NULL;
+    trace->map_len = 0;
+    trace->ids = NULL;
+    trace->num_records = 0;
+    trace->fd = strcmp(path, "-") == 0 ? dup(STDIN_FILENO) : open(path, O_RDONLY);
+    if (trace->fd < 0) {
+        perror("open trace");
+        return -1;
+    }
+    
+    if (read_full(trace->fd, &header, sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+        header.version != TRACE_VERSION ||
+        (header.record_type != TRACE_RECORD_PAGE && header.record_type != TRACE_RECORD_ADDR)) {
+        fprintf(stderr, "不是有效的trace流: %s\n", path);
+        close(trace->fd);
+        return -1;
+    }
+    
+    trace->record_type = (int)header.record_type;
+    trace->page_size = header.page_size != 0 ? (long long)header.page_size : default_page_size;
+    return 0;
+}
+
+static volatile sig_atomic_t stream_stop = 0;
+
+static void stream_on_signal(int sig) {
+    (void)sig;
+    stream_stop = 1;
+}
+
+// 流式模拟：每次read一批记录（不完整的记录留到下一批），逐条更新策略状态，
+// 每report_interval次访问输出一次窗口缺页率。内存只与页号上限和页框数有关。
+// 页号超出上限的记录跳过并计数，会话不中断（trace_capture的页号随目标进程的内存增长）。
+// 收到SIGINT/SIGTERM时处理完当前一批后结束
+int simulate_stream(Simulator *sim) {
+    Config *config = &sim->config;
+    TraceFile *trace = sim->trace;
+    size_t capacity = STREAM_BATCH_RECORDS * sizeof(uint64_t);
+    uint64_t *buffer = (uint64_t*)malloc(capacity);
+    size_t carry = 0;           // 缓冲区开头不完整记录的字节数
+    long long n = 0;
+    long long skipped = 0;      // 页号超出上限而跳过的记录数
+    long long window_faults = 0; // 窗口开始时的缺页次数
+    struct sigaction sa, old_int, old_term;
+    int ret = 0;
+    
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stream_on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, &old_int);
+    sigaction(SIGTERM, &sa, &old_term);
+    
+    printf("开始流式模拟（输入关闭或Ctrl-C结束）...\n\n");
+    printf("%14s %12s %10s %10s %12s\n", "访问次数", "窗口缺页", "窗口缺页率", "累计缺页率",
+           "跳过记录");
+    fflush(stdout);
+    
+    while (!stream_stop) {
+        ssize_t got = read(trace->fd, (char*)buffer + carry, capacity - carry);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("read trace");
+            ret = -1;
+            break;
+        }
+        if (got == 0) {
+            if (carry > 0) {
+                fprintf(stderr, "输入结尾有不完整的记录（%zu字节），已忽略\n", carry);
+            }
+            break;
+        }
+        
+        size_t bytes = carry + (size_t)got;
+        size_t count = bytes / sizeof(uint64_t);
+        for (size_t k = 0; k < count; k++) {
+            long long page_id = trace_page_id(trace, buffer[k]);
+            if (page_id >= config->num_pages) {
+                if (skipped++ == 0) {
+                    fprintf(stderr, "页号%lld超出页号上限%d，超出的记录将跳过（用-N调整）\n",
+                            page_id, config->num_pages);
+                }
+                continue;
+            }
+            access_page(sim, (int)page_id, n, 0, (buffer[k] & TRACE_WRITE_FLAG) != 0);
+            n++;
+            if (n % config->report_interval == 0) {
+                long long faults = sim->page_faults - window_faults;
+                printf("%14lld %12lld %9.2f%% %9.2f%% %12lld\n", n, faults,
+                       (double)faults / config->report_interval * 100,
+                       (double)sim->page_faults / n * 100, skipped);
+                fflush(stdout);
+                window_faults = sim->page_faults;
+            }
+        }
+        carry = bytes - count * sizeof(uint64_t);
+        memmove(buffer, (char*)buffer + count * sizeof(uint64_t), carry);
+    }
+    
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+    free(buffer);
+    if (ret < 0) {
+        return -1;
+    }
+    if (n == 0) {
+        if (skipped > 0) {
+            fprintf(stderr, "全部%lld条记录的页号都超出页号上限%d（用-N调整）\n",
+                    skipped, config->num_pages);
+        } else {
+            fprintf(stderr, "没有读到任何访问记录\n");
+        }
+        return -1;
+    }
+    
+    config->seq_length = n;
+    printf("\n流式模拟结束，共%lld次访问", n);
+    if (skipped > 0) {
+        printf("，跳过%lld条页号超出上限%d的记录", skipped, config->num_pages);
+    }
+    printf("\n\n");
+    return 0;
+}
+
+// ========== 流水线模式 ==========
+
+// 生成线程按块生成访问序列，写入PIPE_SLOTS块的环形缓冲区；每个消费者依次处理每一块，
+// 对分给它的各个模拟逐一回放。生成线程只在最慢的消费者落后PIPE_SLOTS块时等待，
+// 消费者只在下一块尚未写入时等待，双方通过原子变量同步，不使用锁。
+// 内存占用与序列长度无关
+typedef struct {
+    int *slots;             // PIPE_SLOTS × PIPE_CHUNK次访问
+    long long seq_length;
+    long long head;         // 已写入的块数，只由生成线程递增
+    long long *tails;       // 各消费者已处理完的块数
+    int num_consumers;
+} AccessRing;
+
+typedef struct {
+    AccessRing *ring;
+    int id;
+    Simulator *sims;        // 这个消费者负责的模拟
+    int num_sims;
+} PipeConsumer;
+
+// 把第k块送入消费者的各个模拟
+static void pipeline_consume(PipeConsumer *c, long long k) {
+    AccessRing *ring = c->ring;
+    const int *chunk = ring->slots + (k % PIPE_SLOTS) * PIPE_CHUNK;
+    long long base = k * PIPE_CHUNK;
+    long long count = ring->seq_length - base < PIPE_CHUNK ? ring->seq_length - base : PIPE_CHUNK;
+    
+    for (int s = 0; s < c->num_sims; s++) {
+        Simulator *sim = &c->sims[s];
+        const Config *config = &sim->config;
+        int page_size = config->page_size;
+        for (long long i = 0; i < count; i++) {
+            access_page(sim, chunk[i] / page_size, base + i, 0, access_is_write(config, base + i));
+        }
+    }
+    __atomic_store_n(&ring->tails[c->id], k + 1, __ATOMIC_RELEASE);
+}
+
+static void *pipeline_worker(void *arg) {
+    PipeConsumer *c = (PipeConsumer*)arg;
+    AccessRing *ring = c->ring;
+    long long num_chunks = (ring->seq_length + PIPE_CHUNK - 1) / PIPE_CHUNK;
+    
+    for (long long k = 0; k < num_chunks; k++) {
+        while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) <= k) {
+            sched_yield();
+        }
+        pipeline_consume(c, k);
+    }
+    return NULL;
+}
+
+// 用gen_config生成访问序列，同时驱动sims中的各个模拟（均已初始化，序列参数与gen_config相同）。
+// 除生成线程（当前线程）外最多再用num_threads - 1个消费线程，模拟尽量平均分给各消费线程；
+// 没有消费线程（或创建失败）的模拟由生成线程每写完一块后自己处理
+int run_pipeline(const Config *gen_config, Simulator *sims, int num_sims, int num_threads) {
+    int num_workers = num_threads - 1 < num_sims ? num_threads - 1 : num_sims;
+    int num_consumers = num_workers > 0 ? num_workers : 1;
+    AccessRing ring;
+    
+    ring.slots = (int*)malloc((size_t)PIPE_SLOTS * PIPE_CHUNK * sizeof(int));
+    ring.seq_length = gen_config->seq_length;
+    ring.head = 0;
+    ring.tails = (long long*)calloc(num_consumers, sizeof(long long));
+    ring.num_consumers = num_consumers;
+    if (ring.slots == NULL || ring.tails == NULL) {
+        fprintf(stderr, "无法分配流水线缓冲区\n");
+        free(ring.slots);
+        free(ring.tails);
+        return -1;
+    }
+    
+    PipeConsumer *consumers = (PipeConsumer*)malloc(num_consumers * sizeof(PipeConsumer));
+    pthread_t *threads = (pthread_t*)malloc(num_consumers * sizeof(pthread_t));
+    for (int i = 0; i < num_consumers; i++) {
+        int first = (int)((long long)num_sims * i / num_consumers);
+        int last = (int)((long long)num_sims * (i + 1) / num_consumers);
+        consumers[i].ring = &ring;
+        consumers[i].id = i;
+        consumers[i].sims = sims + first;
+        consumers[i].num_sims = last - first;
+    }
+    
+    // 第一个创建失败的线程及之后的消费者都由生成线程处理
+    int num_started = 0;
+    while (num_started < num_workers &&
+           pthread_create(&threads[num_started], NULL, pipeline_worker,
+                          &consumers[num_started]) == 0) {
+        num_started++;
+    }
+    if (num_started < num_workers) {
+        perror("pthread_create");
+    }
+    
+    SeqGen gen;
+    seqgen_init(&gen, gen_config);
+    long long num_chunks = (ring.seq_length + PIPE_CHUNK - 1) / PIPE_CHUNK;
+    for (long long k = 0; k < num_chunks; k++) {
+        // 等待最慢的消费线程处理完即将覆盖的那一块
+        for (int i = 0; i < num_started; i++) {
+            while (k - __atomic_load_n(&ring.tails[i], __ATOMIC_ACQUIRE) >= PIPE_SLOTS) {
+                sched_yield();
+            }
+        }
+        
+        long long base = k * PIPE_CHUNK;
+        long long count = ring.seq_length - base < PIPE_CHUNK ? ring.seq_length - base : PIPE_CHUNK;
+        seqgen_fill(&gen, ring.slots + (k % PIPE_SLOTS) * PIPE_CHUNK, count);
+        __atomic_store_n(&ring.head, k + 1, __ATOMIC_RELEASE);
+        
+        for (int i = num_started; i < num_consumers; i++) {
+            pipeline_consume(&consumers[i], k);
+        }
+    }
+    seqgen_free(&gen);
+    
+    for (int i = 0; i < num_started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    free(consumers);
+    free(ring.tails);
+    free(ring.slots);
+    
+    return 0;
+}
+
+// ========== LRU栈距离与缺页曲线 ==========
+
+// 树状数组（Fenwick树），下标从1开始
+static void fenwick_add(int *tree, int n, int pos, int delta) {
+    for (; pos <= n; pos += pos & -pos) {
+        tree[pos] += delta;
+    }
+}
+
+static int fenwick_sum(const int *tree, int pos) {
+    int sum = 0;
+    for (; pos > 0; pos -= pos & -pos) {
+        sum += tree[pos];
+    }
+    return sum;
+}
+
+void stackdist_init(StackDist *sd, int num_pages, long long *hist) {
+    sd->num_pages = num_pages;
+    sd->capacity = num_pages * 2 + 1;
+    sd->now = 1;
+    sd->tree = (int*)calloc(sd->capacity + 1, sizeof(int));
+    sd->owner = (int*)malloc((sd->capacity + 1) * sizeof(int));
+    sd->stamp = (int*)calloc(num_pages, sizeof(int));
+    sd->hist = hist;
+    sd->cold_misses = 0;
+}
+
+// 时间戳用尽时，把仍有效的时间戳按先后顺序重新编号为1..k并重建树状数组。
+// 每次压缩后至少还能处理num_pages次访问，均摊O(1)
+static void stackdist_compact(StackDist *sd) {
+    int k = 0;
+    
+    for (int t = 1; t < sd->now; t++) {
+        int page_id = sd->owner[t];
+        if (page_id >= 0) {
+            k++;
+            sd->owner[k] = page_id;
+            sd->stamp[page_id] = k;
+        }
+    }
+    
+    // 线性时间重建：前k个位置为1
+    for (int i = 1; i <= sd->capacity; i++) {
+        sd->tree[i] = 0;
+    }
+    for (int i = 1; i <= sd->capacity; i++) {
+        if (i <= k) {
+            sd->tree[i] += 1;
+        }
+        int parent = i + (i & -i);
+        if (parent <= sd->capacity) {
+            sd->tree[parent] += sd->tree[i];
+        }
+    }
+    sd->now = k + 1;
+}
+
+// 把页面移到栈顶（记为最近一次访问），不统计栈距离
+static void stackdist_touch(StackDist *sd, int page_id) {
+    if (sd->now > sd->capacity) {
+        stackdist_compact(sd);
+    }
+    
+    int last = sd->stamp[page_id];
+    if (last != 0) {
+        fenwick_add(sd->tree, sd->capacity, last, -1);
+        sd->owner[last] = -1;
+    }
+    
+    fenwick_add(sd->tree, sd->capacity, sd->now, 1);
+    sd->owner[sd->now] = page_id;
+    sd->stamp[page_id] = sd->now;
+    sd->now++;
+}
+
+// 处理一次访问：两次访问之间置1的时间戳个数即其间访问过的不同页面数
+void stackdist_access(StackDist *sd, int page_id) {
+    int last = sd->stamp[page_id];
+    if (last == 0) {
+        sd->cold_misses++;
+    } else {
+        int distance = fenwick_sum(sd->tree, sd->now - 1) - fenwick_sum(sd->tree, last) + 1;
+        sd->hist[distance]++;
+    }
+    stackdist_touch(sd, page_id);
+}
+
+void stackdist_free(StackDist *sd) {
+    free(sd->tree);
+    free(sd->owner);
+    free(sd->stamp);
+}
+
+// 把第start条起的count次访问依次送入sd。first非NULL时按先后记录块内首次访问的页面。
+// trace由调用者提供，各线程使用各自的映射窗口
+static bool mrc_scan(Simulator *sim, TraceFile *trace, long long start, long long count,
+                     StackDist *sd, int *first) {
+    if (trace != NULL) {
+        long long end = start + count;
+        for (long long pos = start; pos < end; pos += TRACE_WINDOW_RECORDS) {
+            long long n = end - pos;
+            if (n > TRACE_WINDOW_RECORDS) {
+                n = TRACE_WINDOW_RECORDS;
+            }
+            const uint64_t *records = trace_map(trace, pos, n);
+            if (records == NULL) {
+                return false;
+            }
+            for (long long k = 0; k < n; k++) {
+                int page_id = (int)trace_page_id(trace, records[k]);
+                if (first != NULL && sd->stamp[page_id] == 0) {
+                    first[sd->cold_misses] = page_id;
+                }
+                stackdist_access(sd, page_id);
+            }
+        }
+    } else {
+        const int *seq = sim->config.access_sequence + start;
+        int page_size = sim->config.page_size;
+        for (long long i = 0; i < count; i++) {
+            int page_id = seq[i] / page_size;
+            if (first != NULL && sd->stamp[page_id] == 0) {
+                first[sd->cold_misses] = page_id;
+            }
+            stackdist_access(sd, page_id);
+        }
+    }
+    return true;
+}
+
+// 并行计算时的一块访问序列
+typedef struct {
+    Simulator *sim;
+    long long start;
+    long long count;
+    long long *hist;    // 块内复用（上一次访问也在块内）的栈距离直方图
+    int *first;         // 块内访问过的页面，按首次访问的先后
+    int *last;          // 同一批页面，按最后一次访问的先后
+    int num_distinct;
+    bool ok;
+} MrcChunk;
+
+static void *mrc_chunk_worker(void *arg) {
+    MrcChunk *chunk = (MrcChunk*)arg;
+    Simulator *sim = chunk->sim;
+    int num_pages = sim->config.num_pages;
+    StackDist sd;
+    
+    // 与其他线程共享文件描述符，映射窗口各自独立
+    TraceFile trace;
+    if (sim->trace != NULL) {
+        trace = *sim->trace;
+        trace.map_base = NULL;
+        trace.map_len = 0;
+    }
+    
+    stackdist_init(&sd, num_pages, chunk->hist);
+    chunk->ok = mrc_scan(sim, sim->trace != NULL ? &trace : NULL,
+                         chunk->start, chunk->count, &sd, chunk->first);
+    if (sim->trace != NULL && trace.map_base != NULL) {
+        munmap(trace.map_base, trace.map_len);
+    }
+    
+    // 有效时间戳从小到大即最后一次访问的先后
+    int k = 0;
+    for (int t = 1; t < sd.now; t++) {
+        if (sd.owner[t] >= 0) {
+            chunk->last[k++] = sd.owner[t];
+        }
+    }
+    chunk->num_distinct = k;
+    stackdist_free(&sd);
+    
+    return NULL;
+}
+
+// 分块并行计算栈距离，结果与串行扫描完全相同。
+// 块内复用的栈距离只取决于块内访问，由各线程独立算出；每块第一次访问某页时，
+// 其栈距离 = 块内此前访问过的不同页面数 + 之前各块中比它更晚访问、且本块尚未访问的页面数。
+// 合并阶段按块的顺序维护一个全局LRU栈：依次送入该块的首次访问，恰好得到上式
+// （本块已访问的页面都已移到栈顶），再按块内最后访问的先后把这些页面移到栈顶，
+// 得到该块结束时的栈。合并只处理每块的不同页面，代价O(块数 × 页数 × log 页数)
+static bool mrc_compute_parallel(Simulator *sim, int num_chunks, long long *hist,
+                                 long long *cold_misses) {
+    int num_pages = sim->config.num_pages;
+    long long total = sim->trace != NULL ? sim->trace->num_records : sim->config.seq_length;
+    MrcChunk *chunks = (MrcChunk*)calloc(num_chunks, sizeof(MrcChunk));
+    pthread_t *threads = (pthread_t*)malloc(num_chunks * sizeof(pthread_t));
+    bool *started = (bool*)calloc(num_chunks, sizeof(bool));
+    bool ok = true;
+    
+    for (int i = 0; i < num_chunks; i++) {
+        MrcChunk *chunk = &chunks[i];
+        chunk->sim = sim;
+        chunk->start = total * i / num_chunks;
+        chunk->count = total * (i + 1) / num_chunks - chunk->start;
+        chunk->hist = (long long*)calloc(num_pages + 1, sizeof(long long));
+        chunk->first = (int*)malloc(num_pages * sizeof(int));
+        chunk->last = (int*)malloc(num_pages * sizeof(int));
+        started[i] = pthread_create(&threads[i], NULL, mrc_chunk_worker, chunk) == 0;
+        if (!started[i]) {
+            // 创建线程失败时在当前线程计算该块
+            mrc_chunk_worker(chunk);
+        }
+    }
+    
+    StackDist sd;
+    stackdist_init(&sd, num_pages, hist);
+    
+    for (int i = 0; i < num_chunks; i++) {
+        MrcChunk *chunk = &chunks[i];
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+        ok = ok && chunk->ok;
+        
+        for (int d = 1; d <= num_pages; d++) {
+            hist[d] += chunk->hist[d];
+        }
+        for (int k = 0; k < chunk->num_distinct; k++) {
+            stackdist_access(&sd, chunk->first[k]);
+        }
+        for (int k = 0; k < chunk->num_distinct; k++) {
+            stackdist_touch(&sd, chunk->last[k]);
+        }
+        
+        free(chunk->hist);
+        free(chunk->first);
+        free(chunk->last);
+    }
+    
+    *cold_misses = sd.cold_misses;
+    stackdist_free(&sd);
+    free(chunks);
+    free(threads);
+    free(started);
+    
+    return ok;
+}
+
+// 计算LRU栈距离直方图：hist[d]为栈距离为d的访问次数（d从1开始），
+// cold_misses为首次访问次数。整体O(n log n)，trace模式按窗口正向扫描。
+// num_threads > 1且序列足够长时分块并行计算，每块至少MRC_MIN_CHUNK次访问且不少于页数，
+// 保证合并阶段的代价远小于扫描本身
+int mrc_compute(Simulator *sim, int num_threads, long long *hist, long long *cold_misses) {
+    Config *config = &sim->config;
+    TraceFile *trace = sim->trace;
+    long long total = trace != NULL ? trace->num_records : config->seq_length;
+    long long min_chunk = config->num_pages > MRC_MIN_CHUNK ? config->num_pages : MRC_MIN_CHUNK;
+    long long num_chunks = total / min_chunk;
+    
+    if (num_chunks > num_threads) {
+        num_chunks = num_threads;
+    }
+    if (num_chunks > 1) {
+        return mrc_compute_parallel(sim, (int)num_chunks, hist, cold_misses) ? 0 : -1;
+    }
+    
+    StackDist sd;
+    stackdist_init(&sd, config->num_pages, hist);
+    bool ok = mrc_scan(sim, trace, 0, total, &sd, NULL);
+    *cold_misses = sd.cold_misses;
+    stackdist_free(&sd);
+    
+    return ok ? 0 : -1;
+}
+
+// 页框数为c时，栈距离大于c的访问和首次访问都会缺页
+void mrc_print(Simulator *sim, const long long *hist, long long cold_misses) {
+    Config *config = &sim->config;
+    long long faults = config->seq_length - cold_misses; // 栈距离大于c的访问数
+    
+    printf("=== LRU缺页曲线 ===\n");
+    printf("%8s %10s %10s\n", "页框数", "缺页次数", "缺页率");
+    for (int c = 1; c <= config->num_pages; c++) {
+        faults -= hist[c];
+        long long total = faults + cold_misses;
+        printf("%8d %10lld %9.2f%%\n", c, total, (double)total / config->seq_length * 100);
+    }
+}
+
+// ========== SHARDS近似缺页曲线 ==========
+
+// 64位整数混合函数（splitmix64的最后一步），用于页号的空间哈希采样
+static inline uint64_t hash_page(long long page_id) {
+    uint64_t x = (uint64_t)page_id;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static void shards_alloc(Shards *sh, int capacity) {
+    sh->capacity = capacity;
+    sh->table_cap = 1;
+    while (sh->table_cap < capacity * 2) {
+        sh->table_cap <<= 1;
+    }
+    sh->table_keys = (long long*)malloc(sh->table_cap * sizeof(long long));
+    sh->table_slots = (int*)malloc(sh->table_cap * sizeof(int));
+    for (int i = 0; i < sh->table_cap; i++) {
+        sh->table_keys[i] = -1;
+    }
+    sh->slot_page = (long long*)malloc(capacity * sizeof(long long));
+    sh->slot_hash = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    sh->slot_stamp = (int*)malloc(capacity * sizeof(int));
+    sh->free_slots = (int*)malloc(capacity * sizeof(int));
+    sh->num_free = 0;
+    for (int i = capacity - 1; i >= 0; i--) {
+        sh->free_slots[sh->num_free++] = i;
+    }
+    sh->stamp_cap = capacity * 2 + 1;
+    sh->tree = (int*)calloc(sh->stamp_cap + 1, sizeof(int));
+    sh->owner = (int*)malloc((sh->stamp_cap + 1) * sizeof(int));
+    sh->heap = (int*)malloc(capacity * sizeof(int));
+    sh->heap_pos = (int*)malloc(capacity * sizeof(int));
+}
+
+static void shards_release(Shards *sh) {
+    free(sh->table_keys);
+    free(sh->table_slots);
+    free(sh->slot_page);
+    free(sh->slot_hash);
+    free(sh->slot_stamp);
+    free(sh->free_slots);
+    free(sh->tree);
+    free(sh->owner);
+    free(sh->heap);
+    free(sh->heap_pos);
+}
+
+// rate为固定采样率；max_samples大于0时为固定大小模式，从rate开始按需降低采样率。
+// 缺页曲线按bin_width个页框一档统计，共num_bins档，内存与trace长度和页数无关。
+// num_pages为0表示页数未知：从每档1个页框开始，栈距离超出范围时档宽加倍、相邻两档合并
+void shards_init(Shards *sh, double rate, int max_samples, int num_pages) {
+    sh->threshold = (uint64_t)(rate * SHARDS_MODULUS);
+    sh->max_samples = max_samples;
+    sh->num_samples = 0;
+    sh->heap_size = 0;
+    sh->now = 1;
+    shards_alloc(sh, max_samples > 0 ? max_samples + 1 : 1024);
+    
+    sh->num_pages = num_pages;
+    sh->max_distance = 0;
+    if (num_pages > 0) {
+        sh->num_bins = num_pages < SHARDS_BINS ? num_pages : SHARDS_BINS;
+        sh->bin_width = (num_pages + sh->num_bins - 1) / sh->num_bins;
+    } else {
+        sh->num_bins = SHARDS_BINS;
+        sh->bin_width = 1;
+    }
+    sh->hist = (double*)calloc(sh->num_bins + 1, sizeof(double)); // 最后一档为超出总页数
+    sh->cold_misses = 0;
+    sh->accesses = 0;
+    sh->sampled_refs = 0;
+    sh->weighted_refs = 0;
+}
+
+void shards_free(Shards *sh) {
+    shards_release(sh);
+    free(sh->hist);
+}
+
+static int shards_lookup(const Shards *sh, long long page_id) {
+    int mask = sh->table_cap - 1;
+    for (int i = (int)(hash_page(page_id) >> 32) & mask; sh->table_keys[i] != -1; i = (i + 1) & mask) {
+        if (sh->table_keys[i] == page_id) {
+            return sh->table_slots[i];
+        }
+    }
+    return -1;
+}
+
+static void shards_table_insert(Shards *sh, long long page_id, int slot) {
+    int mask = sh->table_cap - 1;
+    int i = (int)(hash_page(page_id) >> 32) & mask;
+    while (sh->table_keys[i] != -1) {
+        i = (i + 1) & mask;
+    }
+    sh->table_keys[i] = page_id;
+    sh->table_slots[i] = slot;
+}
+
+// 线性探测的删除：把后面同一探测链上的元素前移填补空位
+static void shards_table_remove(Shards *sh, long long page_id) {
+    int mask = sh->table_cap - 1;
+    int i = (int)(hash_page(page_id) >> 32) & mask;
+    while (sh->table_keys[i] != page_id) {
+        i = (i + 1) & mask;
+    }
+    for (int j = (i + 1) & mask; sh->table_keys[j] != -1; j = (j + 1) & mask) {
+        int home = (int)(hash_page(sh->table_keys[j]) >> 32) & mask;
+        // home不在(i, j]区间内时，j处的元素可以移到i
+        if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+            sh->table_keys[i] = sh->table_keys[j];
+            sh->table_slots[i] = sh->table_slots[j];
+            i = j;
+        }
+    }
+    sh->table_keys[i] = -1;
+}
+
+static void shards_heap_swap(Shards *sh, int a, int b) {
+    int sa = sh->heap[a];
+    int sb = sh->heap[b];
+    sh->heap[a] = sb;
+    sh->heap[b] = sa;
+    sh->heap_pos[sb] = a;
+    sh->heap_pos[sa] = b;
+}
+
+static void shards_heap_push(Shards *sh, int slot) {
+    int pos = sh->heap_size++;
+    sh->heap[pos] = slot;
+    sh->heap_pos[slot] = pos;
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (sh->slot_hash[sh->heap[parent]] >= sh->slot_hash[sh->heap[pos]]) {
+            break;
+        }
+        shards_heap_swap(sh, parent, pos);
+        pos = parent;
+    }
+}
+
+static int shards_heap_pop(Shards *sh) {
+    int top = sh->heap[0];
+    int pos = 0;
+    shards_heap_swap(sh, 0, --sh->heap_size);
+    for (;;) {
+        int left = pos * 2 + 1;
+        int largest = pos;
+        if (left < sh->heap_size && sh->slot_hash[sh->heap[left]] > sh->slot_hash[sh->heap[largest]]) {
+            largest = left;
+        }
+        if (left + 1 < sh->heap_size &&
+            sh->slot_hash[sh->heap[left + 1]] > sh->slot_hash[sh->heap[largest]]) {
+            largest = left + 1;
+        }
+        if (largest == pos) {
+            break;
+        }
+        shards_heap_swap(sh, pos, largest);
+        pos = largest;
+    }
+    return top;
+}
+
+// 时间戳用尽时重新编号，与StackDist相同
+static void shards_compact(Shards *sh) {
+    int k = 0;
+    
+    for (int t = 1; t < sh->now; t++) {
+        int slot = sh->owner[t];
+        if (slot >= 0) {
+            k++;
+            sh->owner[k] = slot;
+            sh->slot_stamp[slot] = k;
+        }
+    }
+    for (int i = 1; i <= sh->stamp_cap; i++) {
+        sh->tree[i] = 0;
+    }
+    for (int i = 1; i <= sh->stamp_cap; i++) {
+        if (i <= k) {
+            sh->tree[i] += 1;
+        }
+        int parent = i + (i & -i);
+        if (parent <= sh->stamp_cap) {
+            sh->tree[parent] += sh->tree[i];
+        }
+    }
+    sh->now = k + 1;
+}
+
+// 固定采样率模式下采样集合装满时扩容
+static void shards_grow(Shards *sh) {
+    Shards old = *sh;
+    
+    shards_alloc(sh, old.capacity * 2);
+    sh->num_free = 0;
+    for (int i = sh->capacity - 1; i >= old.capacity; i--) {
+        sh->free_slots[sh->num_free++] = i;
+    }
+    memcpy(sh->slot_page, old.slot_page, old.capacity * sizeof(long long));
+    memcpy(sh->slot_hash, old.slot_hash, old.capacity * sizeof(uint64_t));
+    memcpy(sh->slot_stamp, old.slot_stamp, old.capacity * sizeof(int));
+    for (int i = 0; i < old.table_cap; i++) {
+        if (old.table_keys[i] != -1) {
+            shards_table_insert(sh, old.table_keys[i], old.table_slots[i]);
+        }
+    }
+    for (int t = 1; t < old.now; t++) {
+        sh->owner[t] = old.owner[t];
+    }
+    sh->now = old.now;
+    shards_compact(sh);
+    shards_release(&old);
+}
+
+// 固定大小模式：移除哈希值最大的页面，并把阈值降到该哈希值，之后不再采样哈希值更大的页面
+static void shards_evict_max(Shards *sh) {
+    int slot = shards_heap_pop(sh);
+    uint64_t max_hash = sh->slot_hash[slot];
+    
+    for (;;) {
+        fenwick_add(sh->tree, sh->stamp_cap, sh->slot_stamp[slot], -1);
+        sh->owner[sh->slot_stamp[slot]] = -1;
+        shards_table_remove(sh, sh->slot_page[slot]);
+        sh->free_slots[sh->num_free++] = slot;
+        sh->num_samples--;
+        // 哈希值相同的页面一并移除
+        if (sh->heap_size == 0 || sh->slot_hash[sh->heap[0]] != max_hash) {
+            break;
+        }
+        slot = shards_heap_pop(sh);
+    }
+    sh->threshold = max_hash;
+}
+
+// 页数未知时档宽加倍：第2b和2b+1档合并为第b档
+static void shards_widen_bins(Shards *sh) {
+    for (int b = 0; b < sh->num_bins / 2; b++) {
+        sh->hist[b] = sh->hist[2 * b] + sh->hist[2 * b + 1];
+    }
+    for (int b = sh->num_bins / 2; b < sh->num_bins; b++) {
+        sh->hist[b] = 0;
+    }
+    sh->bin_width *= 2;
+}
+
+void shards_access(Shards *sh, long long page_id) {
+    uint64_t h = hash_page(page_id) % SHARDS_MODULUS;
+    
+    sh->accesses++;
+    if (h >= sh->threshold) {
+        return;
+    }
+    
+    double rate = (double)sh->threshold / SHARDS_MODULUS;
+    double weight = 1.0 / rate;
+    sh->sampled_refs++;
+    sh->weighted_refs += weight;
+    
+    if (sh->now > sh->stamp_cap) {
+        shards_compact(sh);
+    }
+    
+    int slot = shards_lookup(sh, page_id);
+    if (slot < 0) {
+        sh->cold_misses += weight;
+        if (sh->num_free == 0) {
+            shards_grow(sh);
+        }
+        slot = sh->free_slots[--sh->num_free];
+        sh->slot_page[slot] = page_id;
+        sh->slot_hash[slot] = h;
+        shards_table_insert(sh, page_id, slot);
+        sh->num_samples++;
+        if (sh->max_samples > 0) {
+            shards_heap_push(sh, slot);
+        }
+    } else {
+        // 采样页面之间的栈距离按采样率放大即为全体页面的栈距离
+        int last = sh->slot_stamp[slot];
+        int distance = fenwick_sum(sh->tree, sh->now - 1) - fenwick_sum(sh->tree, last) + 1;
+        long long scaled = (long long)(distance * weight);
+        long long bin = (scaled - 1) / sh->bin_width;
+        if (sh->num_pages == 0) {
+            if (scaled > sh->max_distance) {
+                sh->max_distance = scaled;
+            }
+            while (bin >= sh->num_bins) {
+                shards_widen_bins(sh);
+                bin = (scaled - 1) / sh->bin_width;
+            }
+        }
+        sh->hist[bin < sh->num_bins ? bin : sh->num_bins] += weight;
+        fenwick_add(sh->tree, sh->stamp_cap, last, -1);
+        sh->owner[last] = -1;
+    }
+    
+    fenwick_add(sh->tree, sh->stamp_cap, sh->now, 1);
+    sh->owner[sh->now] = slot;
+    sh->slot_stamp[slot] = sh->now;
+    sh->now++;
+    
+    if (sh->max_samples > 0 && sh->num_samples > sh->max_samples) {
+        shards_evict_max(sh);
+    }
+}
+
+// 按采样估计全体访问的缺页曲线。SHARDS_adj：加权后的采样引用数与实际访问数之差
+// 计入第一档，修正采样页面访问频率偏离平均水平带来的系统误差。
+// 误差为按二项分布估计的95%置信区间半宽，忽略了同一页面多次访问之间的相关性
+void shards_print(Shards *sh, int num_pages) {
+    double adjust = sh->accesses - sh->weighted_refs;
+    double rate = (double)sh->threshold / SHARDS_MODULUS;
+    double misses = sh->cold_misses + adjust;
+    
+    for (int b = 0; b <= sh->num_bins; b++) {
+        misses += sh->hist[b];
+    }
+    
+    printf("=== LRU缺页曲线（SHARDS采样估计）===\n");
+    printf("最终采样率: %.6f\n", rate);
+    printf("采样页面数: %d\n", sh->num_samples);
+    printf("采样引用数: %lld / %lld\n", sh->sampled_refs, sh->accesses);
+    printf("%8s %12s %10s %10s\n", "页框数", "估计缺页", "缺页率", "误差");
+    
+    // 页数未知时曲线画到见过的最大栈距离为止，之后缺页只剩冷缺页
+    long long limit = num_pages > 0 ? num_pages : (sh->max_distance > 0 ? sh->max_distance : 1);
+    for (int b = 0; b < sh->num_bins && b * sh->bin_width < limit; b++) {
+        // 页框数为c=(b+1)*bin_width时，前b+1档的访问命中
+        misses -= sh->hist[b] + (b == 0 ? adjust : 0);
+        long long c = (b + 1) * sh->bin_width;
+        if (c > limit) {
+            c = limit;
+        }
+        double ratio = misses / sh->accesses;
+        if (ratio < 0) {
+            ratio = 0;
+        } else if (ratio > 1) {
+            ratio = 1;
+        }
+        double error = sh->sampled_refs > 0 ?
+                       1.96 * sqrt(ratio * (1 - ratio) / sh->sampled_refs) : 1.0;
+        printf("%8lld %12.0f %9.2f%% %9.2f%%\n", c, ratio * sh->accesses, ratio * 100, error * 100);
+    }
+}
+
+// 以SHARDS采样方式遍历访问序列（或trace）并输出近似缺页曲线
+void shards_compute(Simulator *sim) {
+    Config *config = &sim->config;
+    TraceFile *trace = sim->trace;
+    Shards sh;
+    
+    shards_init(&sh, config->sample_rate, config->max_samples, config->num_pages);
+    
+    if (trace != NULL) {
+        for (long long start = 0; start < trace->num_records; start += TRACE_WINDOW_RECORDS) {
+            long long count = trace->num_records - start;
+            if (count > TRACE_WINDOW_RECORDS) {
+                count = TRACE_WINDOW_RECORDS;
+            }
+            const uint64_t *records = trace_map(trace, start, count);
+            if (records == NULL) {
+                break;
+            }
+            for (long long k = 0; k < count; k++) {
+                shards_access(&sh, trace_page_id(trace, records[k]));
+            }
+        }
+    } else {
+        int *seq = config->access_sequence;
+        int page_size = config->page_size;
+        for (long long i = 0; i < config->seq_length; i++) {
+            shards_access(&sh, seq[i] / page_size);
+        }
+    }
+    
+    shards_print(&sh, config->num_pages);
+    shards_free(&sh);
+}
+
+// ========== 地址转换（TLB与页表遍历） ==========
+
+static void tlbc_init(TlbCache *c, int entries, int ways) {
+    c->ways = ways;
+    c->sets = entries / ways;
+    c->tags = (uint64_t*)malloc(entries * sizeof(uint64_t));
+    c->stamp = (long long*)calloc(entries, sizeof(long long));
+    for (int i = 0; i < entries; i++) {
+        c->tags[i] = UINT64_MAX;
+    }
+    c->hits = 0;
+    c->misses = 0;
+}
+
+static void tlbc_free(TlbCache *c) {
+    free(c->tags);
+    free(c->stamp);
+}
+
+// 在set_key所在的组中查找key：命中时更新最近使用时间，缺失时替换组内最久未用
+// （或空）的一项装入key。now从1开始递增。返回是否命中
+static bool tlbc_access(TlbCache *c, uint64_t key, uint64_t set_key, long long now) {
+    int base = (int)(set_key % (uint64_t)c->sets) * c->ways;
+    uint64_t *tags = c->tags + base;
+    long long *stamp = c->stamp + base;
+    
+    for (int w = 0; w < c->ways; w++) {
+        if (tags[w] == key) {
+            stamp[w] = now;
+            c->hits++;
+            return true;
+        }
+    }
+    c->misses++;
+    int victim = min_index_scalar(stamp, c->ways);
+    tags[victim] = key;
+    stamp[victim] = now;
+    return false;
+}
+
+static void tlb_init(TlbSim *ts, const TlbModel *model, double huge_ratio) {
+    ts->huge_p32 = prob32(huge_ratio);
+    tlbc_init(&ts->l1, model->l1_entries, model->l1_ways);
+    tlbc_init(&ts->l1_huge, TLB_L1_HUGE_ENTRIES, TLB_L1_HUGE_WAYS);
+    tlbc_init(&ts->l2, model->l2_entries, model->l2_ways);
+    for (int level = 0; level < PT_LEVELS - 1; level++) {
+        tlbc_init(&ts->pwc[level], model->pwc_entries, model->pwc_entries);
+    }
+    ts->accesses = 0;
+    ts->huge_accesses = 0;
+    ts->walks = 0;
+    ts->walk_refs = 0;
+}
+
+static void tlb_free(TlbSim *ts) {
+    tlbc_free(&ts->l1);
+    tlbc_free(&ts->l1_huge);
+    tlbc_free(&ts->l2);
+    for (int level = 0; level < PT_LEVELS - 1; level++) {
+        tlbc_free(&ts->pwc[level]);
+    }
+}
+
+// 一次访问的地址转换：依次查L1、L2 TLB，都缺失时遍历页表。大页按2MB区域号的
+// 哈希选出，同一区域总是同一种映射
+static void tlb_access(TlbSim *ts, uint64_t vpn) {
+    uint64_t region = vpn >> HUGE_PAGE_SHIFT;
+    bool huge = ts->huge_p32 > 0 && (hash_page((long long)region) >> 32) < ts->huge_p32;
+    long long now = ++ts->accesses;
+    
+    if (huge) {
+        ts->huge_accesses++;
+        if (tlbc_access(&ts->l1_huge, region, region, now)) {
+            return;
+        }
+    } else if (tlbc_access(&ts->l1, vpn, vpn, now)) {
+        return;
+    }
+    
+    // L2 TLB中两种页面按各自的页号选组，标签的最低位区分页面大小
+    uint64_t page = huge ? region : vpn;
+    if (tlbc_access(&ts->l2, page << 1 | huge, page, now)) {
+        return;
+    }
+    
+    // 页表遍历：从叶表项的上一级开始向上查页表遍历缓存，第level级命中时
+    // 只需从第level+1级读到叶表项；都未命中则从PML4读起
+    int leaf = huge ? PT_LEVELS - 1 : PT_LEVELS;
+    int start = 0;
+    for (int level = leaf - 1; level >= 1; level--) {
+        uint64_t key = vpn >> (HUGE_PAGE_SHIFT * (PT_LEVELS - level));
+        if (tlbc_access(&ts->pwc[level - 1], key, key, now)) {
+            start = level;
+            break;
+        }
+    }
+    ts->walks++;
+    ts->walk_refs += leaf - start;
+}
+
+static double tlb_ratio(long long part, long long total) {
+    return total > 0 ? (double)part / total * 100 : 0;
+}
+
+static void tlb_print(const Config *config, const TlbSim *sims, int num_sims) {
+    const TlbModel *model = &config->tlb;
+    static const char *pwc_names[PT_LEVELS - 1] = { "PML4E", "PDPTE", "PDE" };
+    
+    printf("=== 地址转换模拟结果 ===\n");
+    printf("L1 TLB: 4KB页%d项%d路，2MB页%d项%d路\n", model->l1_entries, model->l1_ways,
+           TLB_L1_HUGE_ENTRIES, TLB_L1_HUGE_WAYS);
+    printf("L2 TLB: %d项%d路（两种页面共用）\n", model->l2_entries, model->l2_ways);
+    printf("页表遍历缓存: 每级%d项全相联\n", model->pwc_entries);
+    printf("访问次数: %lld\n\n", sims[0].accesses);
+    
+    printf("%-10s %9s %9s %9s %12s %9s %12s %10s\n", "大页比例", "大页访问", "L1命中率",
+           "L2命中率", "页表遍历", "遍历率", "遍历访存", "访存/访问");
+    for (int i = 0; i < num_sims; i++) {
+        const TlbSim *ts = &sims[i];
+        long long l1_hits = ts->l1.hits + ts->l1_huge.hits;
+        printf("%9.0f%% %8.2f%% %8.2f%% %8.2f%% %12lld %8.3f%% %12lld %10.4f\n",
+               i == 0 ? 0.0 : model->huge_ratio * 100,
+               tlb_ratio(ts->huge_accesses, ts->accesses),
+               tlb_ratio(l1_hits, ts->accesses),
+               tlb_ratio(ts->l2.hits, ts->l2.hits + ts->l2.misses),
+               ts->walks, tlb_ratio(ts->walks, ts->accesses), ts->walk_refs,
+               ts->accesses > 0 ? 1 + (double)ts->walk_refs / ts->accesses : 0);
+    }
+    
+    printf("\n页表遍历缓存命中率:\n");
+    printf("%-10s", "大页比例");
+    for (int level = 0; level < PT_LEVELS - 1; level++) {
+        printf(" %9s", pwc_names[level]);
+    }
+    printf(" %12s\n", "访存/遍历");
+    for (int i = 0; i < num_sims; i++) {
+        const TlbSim *ts = &sims[i];
+        printf("%9.0f%%", i == 0 ? 0.0 : model->huge_ratio * 100);
+        for (int level = 0; level < PT_LEVELS - 1; level++) {
+            const TlbCache *c = &ts->pwc[level];
+            printf(" %8.2f%%", tlb_ratio(c->hits, c->hits + c->misses));
+        }
+        printf(" %12.3f\n", ts->walks > 0 ? (double)ts->walk_refs / ts->walks : 0);
+    }
+    
+    if (num_sims > 1 && sims[0].walks > 0) {
+        printf("\n使用大页后页表遍历减少 %.1f%%，遍历访存减少 %.1f%%\n",
+               100 - tlb_ratio(sims[1].walks, sims[0].walks),
+               100 - tlb_ratio(sims[1].walk_refs, sims[0].walk_refs));
+    }
+}
+
+// 遍历访问序列（或trace）模拟地址转换。指定了大页比例时同时模拟只用4KB页的
+// 对照配置，便于比较大页的收益
+void tlb_compute(Simulator *sim) {
+    Config *config = &sim->config;
+    TraceFile *trace = sim->trace;
+    TlbSim sims[2];
+    int num_sims = config->tlb.huge_ratio > 0 ? 2 : 1;
+    
+    tlb_init(&sims[0], &config->tlb, 0);
+    if (num_sims > 1) {
+        tlb_init(&sims[1], &config->tlb, config->tlb.huge_ratio);
+    }
+    
+    if (trace != NULL) {
+        for (long long start = 0; start < trace->num_records; start += TRACE_WINDOW_RECORDS) {
+            long long count = trace->num_records - start;
+            if (count > TRACE_WINDOW_RECORDS) {
+                count = TRACE_WINDOW_RECORDS;
+            }
+            const uint64_t *records = trace_map(trace, start, count);
+            if (records == NULL) {
+                break;
+            }
+            for (long long k = 0; k < count; k++) {
+                uint64_t vpn = (uint64_t)trace_raw_page(trace, records[k]);
+                for (int i = 0; i < num_sims; i++) {
+                    tlb_access(&sims[i], vpn);
+                }
+            }
+        }
+    } else {
+        int *seq = config->access_sequence;
+        int page_size = config->page_size;
+        for (long long i = 0; i < config->seq_length; i++) {
+            for (int k = 0; k < num_sims; k++) {
+                tlb_access(&sims[k], (uint64_t)(seq[i] / page_size));
+            }
+        }
+    }
+    
+    tlb_print(config, sims, num_sims);
+    for (int i = 0; i < num_sims; i++) {
+        tlb_free(&sims[i]);
+    }
+}
+
+// ========== CPU缓存层次 ==========
+
+static const char *cache_policy_names[NUM_CACHE_POLICIES] = { "lru", "fifo", "plru", "srrip", "random" };
+static const char *cache_inclusion_names[] = { "nine", "incl", "excl" };
+
+static bool is_power_of_two(long long x) {
+    return x > 0 && (x & (x - 1)) == 0;
+}
+
+// 解析缓存层次：各级用/分隔，每级为“容量,路数[,策略][,包含性]”，容量可带K/M/G后缀，
+// 例如 32K,8,plru/1M,16,lru,incl/32M,16,srrip,excl。组数和行大小须为2的幂
+int parse_cache_spec(const char *spec, int line_size, CacheModel *model) {
+    char buffer[256];
+    char *save_level;
+    
+    if (!is_power_of_two(line_size)) {
+        fprintf(stderr, "缓存行大小必须为2的幂\n");
+        return -1;
+    }
+    snprintf(buffer, sizeof(buffer), "%s", spec);
+    model->line_size = line_size;
+    model->num_levels = 0;
+    
+    for (char *level = strtok_r(buffer, "/", &save_level); level != NULL;
+         level = strtok_r(NULL, "/", &save_level)) {
+        if (model->num_levels == CACHE_MAX_LEVELS) {
+            fprintf(stderr, "缓存最多%d级\n", CACHE_MAX_LEVELS);
+            return -1;
+        }
+        CacheLevelSpec *ls = &model->levels[model->num_levels];
+        int index = model->num_levels + 1;
+        char *save_field;
+        char *field = strtok_r(level, ",", &save_field);
+        char *end;
+        
+        ls->size = strtoll(field, &end, 10);
+        switch (*end) {
+            case 'K': case 'k': ls->size <<= 10; end++; break;
+            case 'M': case 'm': ls->size <<= 20; end++; break;
+            case 'G': case 'g': ls->size <<= 30; end++; break;
+        }
+        field = strtok_r(NULL, ",", &save_field);
+        if (*end != '\0' || field == NULL) {
+            fprintf(stderr, "第%d级缓存格式错误: 应为 容量,路数[,策略][,包含性]\n", index);
+            return -1;
+        }
+        ls->ways = atoi(field);
+        ls->policy = CACHE_LRU;
+        ls->inclusion = CACHE_NINE;
+        while ((field = strtok_r(NULL, ",", &save_field)) != NULL) {
+            bool known = false;
+            for (int i = 0; i < NUM_CACHE_POLICIES; i++) {
+                if (strcmp(field, cache_policy_names[i]) == 0) {
+                    ls->policy = i;
+                    known = true;
+                }
+            }
+            for (int i = 0; i <= CACHE_EXCLUSIVE; i++) {
+                if (strcmp(field, cache_inclusion_names[i]) == 0) {
+                    ls->inclusion = i;
+                    known = true;
+                }
+            }
+            if (!known) {
+                fprintf(stderr, "第%d级缓存: 未知的替换策略或包含性 %s\n", index, field);
+                return -1;
+            }
+        }
+        
+        if (ls->ways <= 0 || ls->ways > 64) {
+            fprintf(stderr, "第%d级缓存: 路数必须在1-64之间\n", index);
+            return -1;
+        }
+        long long lines = ls->size / line_size;
+        if (ls->size % ((long long)line_size * ls->ways) != 0 || !is_power_of_two(lines / ls->ways)) {
+            fprintf(stderr, "第%d级缓存: 容量/(行大小*路数)必须为2的幂\n", index);
+            return -1;
+        }
+        if (ls->policy == CACHE_PLRU && !is_power_of_two(ls->ways)) {
+            fprintf(stderr, "第%d级缓存: plru要求路数为2的幂\n", index);
+            return -1;
+        }
+        if (ls->inclusion == CACHE_EXCLUSIVE && model->num_levels == 0) {
+            fprintf(stderr, "第1级缓存不能为排他的\n");
+            return -1;
+        }
+        model->num_levels++;
+    }
+    
+    if (model->num_levels == 0) {
+        fprintf(stderr, "缓存层次为空\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void cache_init(CacheSim *cs, const CacheModel *model) {
+    cs->num_levels = model->num_levels;
+    cs->line_shift = __builtin_ctz(model->line_size);
+    cs->rng = 0x9E3779B97F4A7C15ULL;
+    cs->last_line = UINT64_MAX;
+    cs->refs = 0;
+    
+    for (int i = 0; i < model->num_levels; i++) {
+        const CacheLevelSpec *ls = &model->levels[i];
+        CacheLevel *c = &cs->levels[i];
+        long long sets = ls->size / model->line_size / ls->ways;
+        memset(c, 0, sizeof(*c));
+        c->ways = ls->ways;
+        c->set_bits = __builtin_ctzll(sets);
+        c->set_mask = (uint64_t)sets - 1;
+        c->policy = ls->policy;
+        c->inclusion = ls->inclusion;
+        c->lines = (uint64_t*)alloc_aligned(sets * ls->ways * sizeof(uint64_t));
+        memset(c->lines, 0, sets * ls->ways * sizeof(uint64_t));
+        if (c->policy == CACHE_PLRU) {
+            c->plru = (uint64_t*)calloc(sets, sizeof(uint64_t));
+        }
+    }
+}
+
+static void cache_free(CacheSim *cs) {
+    for (int i = 0; i < cs->num_levels; i++) {
+        free(cs->levels[i].lines);
+        free(cs->levels[i].plru);
+    }
+}
+
+static inline uint64_t cache_key(const CacheLevel *c, uint64_t line) {
+    return (line >> c->set_bits) << 8 | CACHE_VALID;
+}
+
+static inline int cache_find(const CacheLevel *c, const uint64_t *set, uint64_t key) {
+    for (int w = 0; w < c->ways; w++) {
+        if ((set[w] & ~CACHE_STATE_MASK) == key) {
+            return w;
+        }
+    }
+    return -1;
+}
+
+// 树形伪LRU：把从根到way路径上的节点指向另一侧
+static inline void plru_touch(uint64_t *bits, int ways, int way) {
+    int node = 1;
+    for (int half = ways / 2; half > 0; half /= 2) {
+        int right = (way & half) != 0;
+        if (right) {
+            *bits &= ~(1ULL << node);
+        } else {
+            *bits |= 1ULL << node;
+        }
+        node = node * 2 + right;
+    }
+}
+
+static inline int plru_victim(uint64_t bits, int ways) {
+    int node = 1;
+    while (node < ways) {
+        node = node * 2 + (int)((bits >> node) & 1);
+    }
+    return node - ways;
+}
+
+// 命中时更新替换状态。LRU的状态为次序（0为最近使用），比命中行更近的行次序加1
+static inline void cache_touch(CacheLevel *c, uint64_t *set, uint64_t set_index, int way) {
+    switch (c->policy) {
+        case CACHE_LRU: {
+            uint64_t rank = set[way] & CACHE_STATE_MASK;
+            if (rank == 0) {
+                return;
+            }
+            for (int w = 0; w < c->ways; w++) {
+                if ((set[w] & CACHE_VALID) && (set[w] & CACHE_STATE_MASK) < rank) {
+                    set[w]++;
+                }
+            }
+            set[way] &= ~CACHE_STATE_MASK;
+            break;
+        }
+        case CACHE_PLRU:
+            plru_touch(&c->plru[set_index], c->ways, way);
+            break;
+        case CACHE_SRRIP:
+            set[way] &= ~CACHE_STATE_MASK;
+            break;
+    }
+}
+
+// 删除一行。LRU/FIFO中次序在它之后的行次序减1，保持有效行的次序为0..n-1
+static inline void cache_remove(CacheLevel *c, uint64_t *set, int way) {
+    if (c->policy == CACHE_LRU || c->policy == CACHE_FIFO) {
+        uint64_t rank = set[way] & CACHE_STATE_MASK;
+        for (int w = 0; w < c->ways; w++) {
+            if ((set[w] & CACHE_VALID) && (set[w] & CACHE_STATE_MASK) > rank) {
+                set[w]--;
+            }
+        }
+    }
+    set[way] = 0;
+}
+
+// 选出换出的路：有空闲路时优先使用
+static int cache_victim(CacheSim *cs, CacheLevel *c, uint64_t *set, uint64_t set_index) {
+    for (int w = 0; w < c->ways; w++) {
+        if (!(set[w] & CACHE_VALID)) {
+            return w;
+        }
+    }
+    switch (c->policy) {
+        case CACHE_PLRU:
+            return plru_victim(c->plru[set_index], c->ways);
+        case CACHE_SRRIP:
+            // 找RRPV为3的行，没有则所有行的RRPV加1后重找
+            for (;;) {
+                for (int w = 0; w < c->ways; w++) {
+                    if ((set[w] & CACHE_STATE_MASK) == 3) {
+                        return w;
+                    }
+                }
+                for (int w = 0; w < c->ways; w++) {
+                    set[w]++;
+                }
+            }
+        case CACHE_RANDOM:
+            cs->rng ^= cs->rng << 13;
+            cs->rng ^= cs->rng >> 7;
+            cs->rng ^= cs->rng << 17;
+            return (int)(cs->rng % (uint64_t)c->ways);
+        default: {
+            // LRU/FIFO：次序最大的行
+            for (int w = 0; w < c->ways; w++) {
+                if ((set[w] & CACHE_STATE_MASK) == (uint64_t)c->ways - 1) {
+                    return w;
+                }
+            }
+            return 0;
+        }
+    }
+}
+
+// 在第level级查找一行，命中时更新替换状态；排他级命中的行移到上级，从本级删除
+static inline bool cache_lookup(CacheLevel *c, uint64_t line) {
+    uint64_t set_index = line & c->set_mask;
+    uint64_t *set = c->lines + set_index * c->ways;
+    int way = cache_find(c, set, cache_key(c, line));
+    
+    c->accesses++;
+    if (way < 0) {
+        return false;
+    }
+    c->hits++;
+    if (c->inclusion == CACHE_EXCLUSIVE) {
+        cache_remove(c, set, way);
+    } else {
+        cache_touch(c, set, set_index, way);
+    }
+    return true;
+}
+
+static bool cache_invalidate(CacheLevel *c, uint64_t line) {
+    uint64_t *set = c->lines + (line & c->set_mask) * c->ways;
+    int way = cache_find(c, set, cache_key(c, line));
+    if (way < 0) {
+        return false;
+    }
+    cache_remove(c, set, way);
+    return true;
+}
+
+// 把一行装入第level级。换出的有效行：本级包含上级时使上级中的同一行失效；
+// 下一级为排他的则装入下一级（可能继续向下换出）
+static void cache_fill(CacheSim *cs, int level, uint64_t line) {
+    CacheLevel *c = &cs->levels[level];
+    uint64_t set_index = line & c->set_mask;
+    uint64_t *set = c->lines + set_index * c->ways;
+    
+    if (c->inclusion == CACHE_EXCLUSIVE && cache_find(c, set, cache_key(c, line)) >= 0) {
+        return;
+    }
+    c->fills++;
+    
+    int way = cache_victim(cs, c, set, set_index);
+    bool evicted = (set[way] & CACHE_VALID) != 0;
+    uint64_t victim = (set[way] >> 8) << c->set_bits | set_index;
+    if (evicted) {
+        cache_remove(c, set, way);
+    }
+    
+    // 新行的初始状态：LRU/FIFO次序为0（其余行后移），SRRIP的RRPV为2
+    uint64_t state = 0;
+    if (c->policy == CACHE_LRU || c->policy == CACHE_FIFO) {
+        for (int w = 0; w < c->ways; w++) {
+            if (set[w] & CACHE_VALID) {
+                set[w]++;
+            }
+        }
+    } else if (c->policy == CACHE_SRRIP) {
+        state = 2;
+    } else if (c->policy == CACHE_PLRU) {
+        plru_touch(&c->plru[set_index], c->ways, way);
+    }
+    set[way] = cache_key(c, line) | state;
+    
+    if (!evicted) {
+        return;
+    }
+    c->evictions++;
+    if (c->inclusion == CACHE_INCLUSIVE) {
+        for (int j = 0; j < level; j++) {
+            if (cache_invalidate(&cs->levels[j], victim)) {
+                c->back_invalidations++;
+            }
+        }
+    }
+    if (level + 1 < cs->num_levels && cs->levels[level + 1].inclusion == CACHE_EXCLUSIVE) {
+        cache_fill(cs, level + 1, victim);
+    }
+}
+
+// 一次访问：逐级查找，命中（或从内存取回）后装入命中级以上所有非排他的级。
+// 连续访问同一行时该行已是L1中最近使用的行，再次访问不改变替换状态（SRRIP除外，
+// 新装入行的RRPV在第一次命中时才清零），只计数
+static inline void cache_access(CacheSim *cs, uint64_t addr) {
+    uint64_t line = addr >> cs->line_shift;
+    int hit_level = 0;
+    
+    cs->refs++;
+    if (line == cs->last_line && cs->levels[0].policy != CACHE_SRRIP) {
+        cs->levels[0].accesses++;
+        cs->levels[0].hits++;
+        return;
+    }
+    cs->last_line = line;
+    while (hit_level < cs->num_levels && !cache_lookup(&cs->levels[hit_level], line)) {
+        hit_level++;
+    }
+    for (int j = hit_level - 1; j >= 0; j--) {
+        if (cs->levels[j].inclusion != CACHE_EXCLUSIVE) {
+            cache_fill(cs, j, line);
+        }
+    }
+}
+
+static void cache_print(const Config *config, const CacheSim *cs, double seconds) {
+    const CacheModel *model = &config->cache;
+    
+    printf("=== 缓存模拟结果 ===\n");
+    printf("缓存行大小: %d 字节\n", model->line_size);
+    printf("访问次数: %lld\n\n", cs->refs);
+    printf("%-4s %10s %5s %-7s %-5s %12s %12s %9s %9s %12s %12s\n", "级", "容量", "路数",
+           "策略", "包含性", "访问次数", "命中次数", "局部缺失", "全局缺失", "换出", "上级失效");
+    for (int i = 0; i < cs->num_levels; i++) {
+        const CacheLevelSpec *ls = &model->levels[i];
+        const CacheLevel *c = &cs->levels[i];
+        long long misses = c->accesses - c->hits;
+        char size[32];
+        if (ls->size % (1 << 20) == 0) {
+            snprintf(size, sizeof(size), "%lldM", ls->size >> 20);
+        } else if (ls->size % (1 << 10) == 0) {
+            snprintf(size, sizeof(size), "%lldK", ls->size >> 10);
+        } else {
+            snprintf(size, sizeof(size), "%lldB", ls->size);
+        }
+        printf("L%-3d %10s %5d %-7s %-5s %12lld %12lld %8.2f%% %8.2f%% %12lld %12lld\n",
+               i + 1, size, ls->ways, cache_policy_names[ls->policy],
+               cache_inclusion_names[ls->inclusion], c->accesses, c->hits,
+               c->accesses > 0 ? (double)misses / c->accesses * 100 : 0,
+               cs->refs > 0 ? (double)misses / cs->refs * 100 : 0,
+               c->evictions, c->back_invalidations);
+    }
+    
+    const CacheLevel *last = &cs->levels[cs->num_levels - 1];
+    printf("\n访问内存次数: %lld\n", last->accesses - last->hits);
+    printf("模拟耗时: %.3f 秒（%.1f M次访问/秒）\n", seconds,
+           seconds > 0 ? cs->refs / seconds / 1e6 : 0);
+}
+
+// 遍历访问序列（或trace）模拟缓存层次。trace须为地址记录，地址按字节计
+int cache_compute(Simulator *sim) {
+    Config *config = &sim->config;
+    TraceFile *trace = sim->trace;
+    CacheSim cs;
+    struct timespec start_time, end_time;
+    
+    if (trace != NULL && trace->record_type != TRACE_RECORD_ADDR) {
+        fprintf(stderr, "缓存模拟需要地址记录的trace（页号记录没有行内地址）\n");
+        return -1;
+    }
+    
+    cache_init(&cs, &config->cache);
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    
+    if (trace != NULL) {
+        for (long long start = 0; start < trace->num_records; start += TRACE_WINDOW_RECORDS) {
+            long long count = trace->num_records - start;
+            if (count > TRACE_WINDOW_RECORDS) {
+                count = TRACE_WINDOW_RECORDS;
+            }
+            const uint64_t *records = trace_map(trace, start, count);
+            if (records == NULL) {
+                cache_free(&cs);
+                return -1;
+            }
+            for (long long k = 0; k < count; k++) {
+                cache_access(&cs, records[k] & ~TRACE_WRITE_FLAG);
+            }
+        }
+    } else {
+        int *seq = config->access_sequence;
+        for (long long i = 0; i < config->seq_length; i++) {
+            cache_access(&cs, (uint64_t)seq[i] * INSN_BYTES);
+        }
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    cache_print(config, &cs, (double)(end_time.tv_sec - start_time.tv_sec) +
+                (end_time.tv_nsec - start_time.tv_nsec) / 1e9);
+    cache_free(&cs);
+    return 0;
+}
+
+// ========== 参数扫描 ==========
+
+// 参数扫描中的一个配置及其结果
+typedef struct {
+    const PolicyOps *policy;
+    int num_frames;
+    int access_pattern;     // trace回放时为-1
+    float locality_factor;
+    int *sequence;          // 共享的只读访问序列（trace回放时为NULL）
+    long long *next_use;    // 共享的只读下次使用位置（策略不需要或trace回放时为NULL）
+    long long page_faults;
+    long long writebacks;   // 换出时同步写回次数
+    double eat_us;          // 有效访问时间
+    double seconds;
+    bool ok;
+} SweepJob;
+
+typedef struct {
+    const Config *base;     // 各配置共同的参数
+    const PageIdMap *trace_ids; // trace页号的压缩编号（NULL表示不需要）
+    int next_use_fd;        // trace的下次使用位置文件，所有OPT配置共享（-1表示不需要）
+    SweepJob *jobs;
+    int num_jobs;
+    int next_job;           // 下一个待领取的配置，各线程原子递增
+} SweepPool;
+
+// 解析整数取值列表：逗号分隔的每一项为单个值、区间lo-hi、带步长的区间lo-hi:step
+// 或按倍数增长的区间lo-hi*factor。返回取值个数，格式错误返回-1
+static int parse_int_values(const char *spec, int **values) {
+    int count = 0;
+    int capacity = 16;
+    int *out = (int*)malloc(capacity * sizeof(int));
+    const char *p = spec;
+    
+    while (*p != '\0') {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        long hi;
+        long step = 1;
+        bool geometric = false;
+        if (end == p) {
+            goto fail;
+        }
+        hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p) {
+                goto fail;
+            }
+            if (*end == ':' || *end == '*') {
+                geometric = *end == '*';
+                p = end + 1;
+                step = strtol(p, &end, 10);
+                if (end == p || step <= 0 || (geometric && (step < 2 || lo <= 0))) {
+                    goto fail;
+                }
+            }
+        }
+        if (hi < lo || lo < INT_MIN || hi > INT_MAX) {
+            goto fail;
+        }
+        for (long v = lo; v <= hi; v = geometric ? v * step : v + step) {
+            if (count == capacity) {
+                capacity *= 2;
+                out = (int*)realloc(out, capacity * sizeof(int));
+            }
+            out[count++] = (int)v;
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            goto fail;
+        }
+        p = end;
+    }
+    
+    if (count == 0) {
+        goto fail;
+    }
+    *values = out;
+    return count;
+    
+fail:
+    free(out);
+    return -1;
+}
+
+// 解析小数取值列表：逗号分隔的单个值或带步长的区间lo-hi:step
+static int parse_float_values(const char *spec, float **values) {
+    int count = 0;
+    int capacity = 16;
+    float *out = (float*)malloc(capacity * sizeof(float));
+    const char *p = spec;
+    
+    while (*p != '\0') {
+        char *end;
+        double lo = strtod(p, &end);
+        double hi;
+        double step = 0.1;
+        if (end == p) {
+            goto fail;
+        }
+        hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtod(p, &end);
+            if (end == p) {
+                goto fail;
+            }
+            if (*end == ':') {
+                p = end + 1;
+                step = strtod(p, &end);
+                if (end == p || step <= 0) {
+                    goto fail;
+                }
+            }
+        }
+        if (hi < lo) {
+            goto fail;
+        }
+        int n = (int)((hi - lo) / step + 1e-6) + 1;
+        for (int k = 0; k < n; k++) {
+            if (count == capacity) {
+                capacity *= 2;
+                out = (float*)realloc(out, capacity * sizeof(float));
+            }
+            out[count++] = (float)(lo + k * step);
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            goto fail;
+        }
+        p = end;
+    }
+    
+    if (count == 0) {
+        goto fail;
+    }
+    *values = out;
+    return count;
+    
+fail:
+    free(out);
+    return -1;
+}
+
+// 解析算法列表：逗号分隔的算法名，或all表示全部算法
+static int parse_policy_values(const char *spec, const PolicyOps ***values) {
+    int count = 0;
+    const PolicyOps **out = (const PolicyOps**)malloc(NUM_POLICIES * sizeof(PolicyOps*));
+    
+    if (strcmp(spec, "all") == 0) {
+        for (int i = 0; i < NUM_POLICIES; i++) {
+            out[count++] = &policies[i];
+        }
+        *values = out;
+        return count;
+    }
+    
+    char *copy = strdup(spec);
+    for (char *name = strtok(copy, ","); name != NULL; name = strtok(NULL, ",")) {
+        const PolicyOps *policy = find_policy(name);
+        if (policy == NULL) {
+            fprintf(stderr, "未知的算法: %s\n", name);
+            free(copy);
+            free(out);
+            return -1;
+        }
+        bool seen = false;
+        for (int i = 0; i < count; i++) {
+            seen = seen || out[i] == policy;
+        }
+        if (!seen) {
+            out[count++] = policy;
+        }
+    }
+    free(copy);
+    
+    if (count == 0) {
+        free(out);
+        return -1;
+    }
+    *values = out;
+    return count;
+}
+
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// 工作线程：不断领取下一个配置并独立运行，访问序列和trace文件只读共享
+static void *sweep_worker(void *arg) {
+    SweepPool *pool = (SweepPool*)arg;
+    
+    for (;;) {
+        int k = __atomic_fetch_add(&pool->next_job, 1, __ATOMIC_RELAXED);
+        if (k >= pool->num_jobs) {
+            break;
+        }
+        
+        SweepJob *job = &pool->jobs[k];
+        Config config = *pool->base;
+        config.policy = job->policy;
+        config.num_frames = job->num_frames;
+        config.access_pattern = job->access_pattern;
+        config.locality_factor = job->locality_factor;
+        config.access_sequence = job->sequence;
+        config.next_use = job->next_use;
+        config.quiet = true;
+        
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        
+        // 每个线程单独打开trace文件，各自映射窗口，页缓存由所有线程共享
+        TraceFile trace;
+        if (config.trace_path != NULL &&
+            trace_open(&trace, config.trace_path, config.page_size) < 0) {
+            job->ok = false;
+            continue;
+        }
+        trace.ids = pool->trace_ids;
+        
+        Simulator sim;
+        init_simulator(&sim, &config);
+        if (config.trace_path != NULL) {
+            sim.trace = &trace;
+            if (config.policy->needs_next_use) {
+                sim.next_use_fd = pool->next_use_fd;
+            }
+            job->ok = simulate_trace(&sim) == 0;
+            trace_close(&trace);
+        } else {
+            simulate(&sim);
+            job->ok = true;
+        }
+        job->page_faults = sim.page_faults;
+        job->writebacks = sim.io.writebacks;
+        job->eat_us = sim.io.clock_us / config.seq_length;
+        job->seconds = elapsed_seconds(&start);
+        cleanup(&sim);
+    }
+    
+    return NULL;
+}
+
+static void print_sweep_results(const Config *config, const SweepSpec *spec,
+                                const SweepJob *jobs, int num_jobs) {
+    bool json = strcmp(spec->format, "json") == 0;
+    
+    if (json) {
+        printf("[\n");
+    } else {
+        printf("algorithm,frames,pattern,locality,accesses,faults,fault_rate,seconds,writebacks,eat_us\n");
+    }
+    
+    for (int i = 0; i < num_jobs; i++) {
+        const SweepJob *job = &jobs[i];
+        double rate = (double)job->page_faults / config->seq_length;
+        if (json) {
+            printf("  {\"algorithm\": \"%s\", \"frames\": %d, \"pattern\": %d, \"locality\": %.3f, "
+                   "\"accesses\": %lld, \"faults\": %lld, \"fault_rate\": %.6f, \"seconds\": %.6f, "
+                   "\"writebacks\": %lld, \"eat_us\": %.6f}%s\n",
+                   job->policy->name, job->num_frames, job->access_pattern, job->locality_factor,
+                   config->seq_length, job->page_faults, rate, job->seconds,
+                   job->writebacks, job->eat_us, i + 1 < num_jobs ? "," : "");
+        } else {
+            printf("%s,%d,%d,%.3f,%lld,%lld,%.6f,%.6f,%lld,%.6f\n",
+                   job->policy->name, job->num_frames, job->access_pattern, job->locality_factor,
+                   config->seq_length, job->page_faults, rate, job->seconds,
+                   job->writebacks, job->eat_us);
+        }
+    }
+    
+    if (json) {
+        printf("]\n");
+    }
+}
+
+// 参数扫描：对-a/-f/-m/-l的所有取值组合，用线程池并行运行，结果按组合顺序输出。
+// 相同访问模式和局部性因子的配置共享同一条生成的访问序列（trace回放时共享trace文件）
+// 流水线参数扫描：jobs按（访问模式, 局部性因子）分为num_groups组，每组group_size个配置。
+// 逐组边生成访问序列边驱动组内所有配置的模拟，返回使用的线程数（含生成线程）
+static int sweep_pipelined(const Config *base, SweepJob *jobs, int num_groups, int group_size,
+                           int num_threads) {
+    Simulator *sims = (Simulator*)malloc(group_size * sizeof(Simulator));
+    
+    for (int g = 0; g < num_groups; g++) {
+        SweepJob *group = jobs + (long long)g * group_size;
+        Config config = *base;
+        config.access_pattern = group[0].access_pattern;
+        config.locality_factor = group[0].locality_factor;
+        config.access_sequence = NULL;
+        config.quiet = true;
+        
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < group_size; i++) {
+            Config sim_config = config;
+            sim_config.policy = group[i].policy;
+            sim_config.num_frames = group[i].num_frames;
+            init_simulator(&sims[i], &sim_config);
+        }
+        
+        bool ok = run_pipeline(&config, sims, group_size, num_threads) == 0;
+        double seconds = elapsed_seconds(&start);
+        for (int i = 0; i < group_size; i++) {
+            group[i].ok = ok;
+            group[i].page_faults = sims[i].page_faults;
+            group[i].writebacks = sims[i].io.writebacks;
+            group[i].eat_us = sims[i].io.clock_us / config.seq_length;
+            group[i].seconds = seconds;
+            cleanup(&sims[i]);
+        }
+    }
+    free(sims);
+    
+    return 1 + (num_threads - 1 < group_size ? num_threads - 1 : group_size);
+}
+
+int run_sweep(Config *config, const SweepSpec *spec) {
+    const PolicyOps **policy_values = NULL;
+    int *frame_values = NULL;
+    int *pattern_values = NULL;
+    float *locality_values = NULL;
+    int num_policies = parse_policy_values(spec->policy_spec ? spec->policy_spec : "fifo",
+                                           &policy_values);
+    int num_frame_values = 1;
+    int num_patterns = 1;
+    int num_localities = 1;
+    bool needs_next_use = false;
+    
+    if (num_policies < 0) {
+        fprintf(stderr, "算法列表格式错误\n");
+        return 1;
+    }
+    // -a all只展开为当前输入支持的算法：trace回放不支持需要整个序列的扫描版，流水线模式
+    // 不支持需要预知之后访问的算法。显式列出的不支持算法仍然报错
+    if (spec->policy_spec != NULL && strcmp(spec->policy_spec, "all") == 0) {
+        int kept = 0;
+        for (int i = 0; i < num_policies; i++) {
+            const PolicyOps *policy = policy_values[i];
+            bool supported = config->pipelined ? !policy->needs_next_use && !policy->needs_sequence
+                                               : config->trace_path == NULL || !policy->needs_sequence;
+            if (supported) {
+                policy_values[kept++] = policy;
+            }
+        }
+        num_policies = kept;
+    }
+    for (int i = 0; i < num_policies; i++) {
+        needs_next_use |= policy_values[i]->needs_next_use;
+    }
+    if (spec->frames_spec != NULL) {
+        num_frame_values = parse_int_values(spec->frames_spec, &frame_values);
+    } else {
+        frame_values = (int*)malloc(sizeof(int));
+        frame_values[0] = config->num_frames;
+    }
+    if (config->trace_path != NULL) {
+        // trace回放时访问模式和局部性因子不起作用
+        pattern_values = (int*)malloc(sizeof(int));
+        pattern_values[0] = -1;
+        locality_values = (float*)malloc(sizeof(float));
+        locality_values[0] = 0;
+    } else {
+        if (spec->pattern_spec != NULL) {
+            num_patterns = parse_int_values(spec->pattern_spec, &pattern_values);
+        } else {
+            pattern_values = (int*)malloc(sizeof(int));
+            pattern_values[0] = config->access_pattern;
+        }
+        if (spec->locality_spec != NULL) {
+            num_localities = parse_float_values(spec->locality_spec, &locality_values);
+        } else {
+            locality_values = (float*)malloc(sizeof(float));
+            locality_values[0] = config->locality_factor;
+        }
+    }
+    
+    int ret = 1;
+    int num_sequences = 0;
+    int **sequences = NULL;
+    long long **next_uses = NULL;
+    int next_use_fd = -1;
+    PageIdMap trace_ids = { NULL, NULL, 0, 0 };
+    const PageIdMap *shared_ids = NULL;
+    SweepJob *jobs = NULL;
+    int num_jobs = 0;
+    
+    if (num_frame_values < 0 || num_patterns < 0 || num_localities < 0) {
+        fprintf(stderr, "取值列表格式错误，参见 -h\n");
+        goto out;
+    }
+    for (int i = 0; i < num_frame_values; i++) {
+        if (frame_values[i] <= 0) {
+            fprintf(stderr, "页框数量必须为正数\n");
+            goto out;
+        }
+        if (config->prefetcher != NULL && frame_values[i] < 2) {
+            fprintf(stderr, "预取至少需要2个页框\n");
+            goto out;
+        }
+    }
+    for (int i = 0; i < num_patterns; i++) {
+        if (config->trace_path == NULL &&
+            (pattern_values[i] < 0 || pattern_values[i] >= NUM_PATTERNS)) {
+            fprintf(stderr, "访问模式必须为0-6之间的数字\n");
+            goto out;
+        }
+    }
+    for (int i = 0; i < num_localities; i++) {
+        if (locality_values[i] < 0 || locality_values[i] > 1) {
+            fprintf(stderr, "局部性因子必须在0-1之间\n");
+            goto out;
+        }
+    }
+    
+    if (config->trace_path != NULL) {
+        TraceFile trace;
+        for (int i = 0; i < num_policies; i++) {
+            if (policy_values[i]->needs_sequence) {
+                fprintf(stderr, "trace回放模式不支持%s\n", policy_values[i]->name);
+                goto out;
+            }
+        }
+        if (trace_open(&trace, config->trace_path, config->page_size) < 0) {
+            goto out;
+        }
+        if (trace_scan_pages(&trace, &trace_ids, &config->num_pages) < 0) {
+            trace_close(&trace);
+            goto out;
+        }
+        config->seq_length = trace.num_records;
+        shared_ids = trace.ids;
+        // 下次使用位置只取决于trace，预处理一次后各OPT配置只读映射同一个文件
+        if (needs_next_use) {
+            Simulator prep;
+            prep.config = *config;
+            prep.trace = &trace;
+            next_use_fd = opt_prepare_trace(&prep);
+            if (next_use_fd < 0) {
+                trace_close(&trace);
+                goto out;
+            }
+        }
+        trace_close(&trace);
+    } else {
+        if (config->total_instructions % config->page_size != 0) {
+            fprintf(stderr, "总指令数必须是页面大小的整数倍\n");
+            goto out;
+        }
+        // 与单次运行相同：只有流水线模式不保存整个序列，长度不受总指令数限制
+        if (!config->pipelined && config->seq_length > config->total_instructions) {
+            fprintf(stderr, "访问序列长度不能超过总指令数\n");
+            config->seq_length = config->total_instructions;
+        }
+        config->num_pages = config->total_instructions / config->page_size;
+    }
+    
+    if (config->pipelined) {
+        for (int i = 0; i < num_policies; i++) {
+            if (policy_values[i]->needs_next_use || policy_values[i]->needs_sequence) {
+                fprintf(stderr, "流水线模式不支持%s（需要预知之后的访问）\n", policy_values[i]->name);
+                goto out;
+            }
+        }
+    } else if (config->trace_path == NULL) {
+        // 每个（访问模式, 局部性因子）组合生成一条访问序列
+        sequences = (int**)calloc(num_patterns * num_localities, sizeof(int*));
+        next_uses = (long long**)calloc(num_patterns * num_localities, sizeof(long long*));
+        for (int m = 0; m < num_patterns; m++) {
+            for (int l = 0; l < num_localities; l++) {
+                Simulator gen;
+                gen.config = *config;
+                gen.config.access_pattern = pattern_values[m];
+                gen.config.locality_factor = locality_values[l];
+                gen.config.access_sequence = (int*)malloc(config->seq_length * sizeof(int));
+                generate_access_sequence(&gen);
+                // 同一条序列上的各OPT配置共享一份下次使用位置
+                if (needs_next_use) {
+                    gen.next_use = (long long*)malloc(config->seq_length * sizeof(long long));
+                    opt_prepare(&gen);
+                    next_uses[num_sequences] = gen.next_use;
+                }
+                sequences[num_sequences++] = gen.config.access_sequence;
+            }
+        }
+    }
+    
+    num_jobs = num_patterns * num_localities * num_policies * num_frame_values;
+    jobs = (SweepJob*)calloc(num_jobs, sizeof(SweepJob));
+    int k = 0;
+    for (int m = 0; m < num_patterns; m++) {
+        for (int l = 0; l < num_localities; l++) {
+            for (int a = 0; a < num_policies; a++) {
+                for (int f = 0; f < num_frame_values; f++) {
+                    jobs[k].policy = policy_values[a];
+                    jobs[k].num_frames = frame_values[f];
+                    jobs[k].access_pattern = pattern_values[m];
+                    jobs[k].locality_factor = locality_values[l];
+                    jobs[k].sequence = sequences != NULL ? sequences[m * num_localities + l] : NULL;
+                    if (policy_values[a]->needs_next_use && next_uses != NULL) {
+                        jobs[k].next_use = next_uses[m * num_localities + l];
+                    }
+                    k++;
+                }
+            }
+        }
+    }
+    
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int num_threads = spec->num_threads < num_jobs ? spec->num_threads : num_jobs;
+    if (config->pipelined) {
+        // 每组访问模式和局部性因子只生成一条序列，组内的配置流水线共用
+        num_threads = sweep_pipelined(config, jobs, num_patterns * num_localities,
+                                      num_policies * num_frame_values, spec->num_threads);
+    } else {
+        SweepPool pool = { config, shared_ids, next_use_fd, jobs, num_jobs, 0 };
+        pthread_t *threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+        
+        for (int i = 0; i < num_threads; i++) {
+            if (pthread_create(&threads[i], NULL, sweep_worker, &pool) != 0) {
+                perror("pthread_create");
+                num_threads = i;
+                break;
+            }
+        }
+        if (num_threads == 0) {
+            // 无法创建线程时在当前线程中运行
+            sweep_worker(&pool);
+        }
+        for (int i = 0; i < num_threads; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+    }
+    
+    ret = 0;
+    for (int i = 0; i < num_jobs; i++) {
+        if (!jobs[i].ok) {
+            fprintf(stderr, "配置 %s -f %d 运行失败\n", jobs[i].policy->name, jobs[i].num_frames);
+            ret = 1;
+        }
+    }
+    print_sweep_results(config, spec, jobs, num_jobs);
+    fprintf(stderr, "参数扫描完成: %d个配置, %d个线程, 用时%.3f秒, 随机种子%llu\n",
+            num_jobs, num_threads > 0 ? num_threads : 1, elapsed_seconds(&start),
+            (unsigned long long)config->seed);
+    
+out:
+    for (int i = 0; i < num_sequences; i++) {
+        free(sequences[i]);
+        free(next_uses[i]);
+    }
+    free(sequences);
+    free(next_uses);
+    if (next_use_fd >= 0) {
+        close(next_use_fd);
+    }
+    pageid_free(&trace_ids);
+    free(jobs);
+    free(policy_values);
+    free(frame_values);
+    free(pattern_values);
+    free(locality_values);
+    return ret;
+}
+
+// ========== 性能基准 ==========
+
+typedef struct {
+    const PolicyOps *policy;
+    int num_frames;
+    long long accesses;
+    long long page_faults;
+    double seconds;
+    long peak_rss_kb;
+} BenchResult;
+
+// 把峰值RSS重置为当前RSS（clear_refs写5），使每次运行的峰值可以单独测量
+static bool bench_reset_peak_rss(void) {
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write(fd, "5", 1) == 1;
+    close(fd);
+    return ok;
+}
+
+// 读取/proc/self/status中的VmHWM，不可用时退回getrusage（整个进程的峰值）
+static long bench_peak_rss_kb(void) {
+    char line[256];
+    long kb = -1;
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp != NULL) {
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) {
+                break;
+            }
+        }
+        fclose(fp);
+    }
+    if (kb < 0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        kb = usage.ru_maxrss;
+    }
+    return kb;
+}
+
+static void print_bench_result(const BenchSpec *spec, const BenchResult *r, int num_pages,
+                               bool last) {
+    double per_sec = r->seconds > 0 ? r->accesses / r->seconds : 0;
+    double ns = r->seconds * 1e9 / r->accesses;
+    
+    if (strcmp(spec->format, "json") == 0) {
+        printf("  {\"algorithm\": \"%s\", \"frames\": %d, \"pages\": %d, \"accesses\": %lld, "
+               "\"faults\": %lld, \"seconds\": %.6f, \"accesses_per_sec\": %.0f, "
+               "\"ns_per_access\": %.3f, \"peak_rss_kb\": %ld}%s\n",
+               r->policy->name, r->num_frames, num_pages, r->accesses, r->page_faults,
+               r->seconds, per_sec, ns, r->peak_rss_kb, last ? "" : ",");
+    } else {
+        printf("%s,%d,%d,%lld,%lld,%.6f,%.0f,%.3f,%ld\n",
+               r->policy->name, r->num_frames, num_pages, r->accesses, r->page_faults,
+               r->seconds, per_sec, ns, r->peak_rss_kb);
+    }
+    fflush(stdout);
+}
+
+// 基准测试：对每个算法、页框数和序列长度单线程运行simulate()，关闭所有过程输出，
+// 只计时模拟本身（OPT的预处理计入）。各长度的序列是同一条固定种子序列的前缀
+int run_bench(Config *config, const BenchSpec *spec) {
+    const PolicyOps **policy_values = NULL;
+    int *frame_values = NULL;
+    int *size_values = NULL;
+    int num_policies = parse_policy_values(spec->policy_spec ? spec->policy_spec : "all",
+                                           &policy_values);
+    int num_frame_values = parse_int_values(spec->frames_spec ? spec->frames_spec : "4,64,1024",
+                                            &frame_values);
+    int num_sizes = parse_int_values(spec->sizes_spec ? spec->sizes_spec : "100000,1000000",
+                                     &size_values);
+    int ret = 1;
+    int *sequence = NULL;
+    
+    if (num_policies < 0) {
+        fprintf(stderr, "算法列表格式错误\n");
+        goto out;
+    }
+    if (num_frame_values < 0 || num_sizes < 0) {
+        fprintf(stderr, "取值列表格式错误，参见 -h\n");
+        goto out;
+    }
+    // 未指定-a时不测扫描版：它们只作为正确性参照，每次缺页O(页框数)或O(序列长度)，
+    // 在默认的百万次访问、1024个页框上要运行很久；需要时可用-a显式指定
+    if (spec->policy_spec == NULL) {
+        int kept = 0;
+        for (int i = 0; i < num_policies; i++) {
+            const char *suffix = strrchr(policy_values[i]->name, '-');
+            if (suffix == NULL || strcmp(suffix, "-scan") != 0) {
+                policy_values[kept++] = policy_values[i];
+            }
+        }
+        num_policies = kept;
+    }
+    
+    // 页数取最大页框数的两倍，使页框数从小到大覆盖高缺页率到全部命中
+    int max_frames = 0;
+    long long max_size = 0;
+    for (int i = 0; i < num_frame_values; i++) {
+        if (frame_values[i] <= 0) {
+            fprintf(stderr, "页框数量必须为正数\n");
+            goto out;
+        }
+        if (config->prefetcher != NULL && frame_values[i] < 2) {
+            fprintf(stderr, "预取至少需要2个页框\n");
+            goto out;
+        }
+        if (frame_values[i] > max_frames) {
+            max_frames = frame_values[i];
+        }
+    }
+    for (int i = 0; i < num_sizes; i++) {
+        if (size_values[i] <= 0) {
+            fprintf(stderr, "访问序列长度必须为正数\n");
+            goto out;
+        }
+        if (size_values[i] > max_size) {
+            max_size = size_values[i];
+        }
+    }
+    int num_pages = max_frames * 2 > 64 ? max_frames * 2 : 64;
+    if ((long long)num_pages * config->page_size > INT_MAX) {
+        fprintf(stderr, "页框数过大：总指令数超出范围\n");
+        goto out;
+    }
+    
+    config->num_pages = num_pages;
+    config->total_instructions = num_pages * config->page_size;
+    config->seq_length = max_size;
+    config->quiet = true;
+    
+    sequence = (int*)malloc(max_size * sizeof(int));
+    if (sequence == NULL) {
+        fprintf(stderr, "无法为%lld次访问分配序列\n", max_size);
+        goto out;
+    }
+    Simulator gen;
+    gen.config = *config;
+    gen.config.access_sequence = sequence;
+    generate_access_sequence(&gen);
+    
+    bool reset_rss = bench_reset_peak_rss();
+    fprintf(stderr, "基准测试: 种子%llu, 访问模式%d, %d页, 页大小%d%s\n",
+            (unsigned long long)config->seed, config->access_pattern, num_pages, config->page_size,
+            reset_rss ? "" : "（无法重置峰值RSS，peak_rss_kb为进程峰值）");
+    
+    if (strcmp(spec->format, "json") == 0) {
+        printf("[\n");
+    } else {
+        printf("algorithm,frames,pages,accesses,faults,seconds,accesses_per_sec,ns_per_access,peak_rss_kb\n");
+    }
+    
+    int total_runs = num_policies * num_frame_values * num_sizes;
+    int run = 0;
+    for (int a = 0; a < num_policies; a++) {
+        for (int f = 0; f < num_frame_values; f++) {
+            for (int s = 0; s < num_sizes; s++) {
+                BenchResult result;
+                Config bench = *config;
+                bench.policy = policy_values[a];
+                bench.num_frames = frame_values[f];
+                bench.seq_length = size_values[s];
+                bench.access_sequence = sequence;
+                
+                if (reset_rss) {
+                    bench_reset_peak_rss();
+                }
+                Simulator sim;
+                init_simulator(&sim, &bench);
+                
+                struct timespec start;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                simulate(&sim);
+                
+                result.policy = bench.policy;
+                result.num_frames = bench.num_frames;
+                result.accesses = bench.seq_length;
+                result.page_faults = sim.page_faults;
+                result.seconds = elapsed_seconds(&start);
+                result.peak_rss_kb = bench_peak_rss_kb();
+                cleanup(&sim);
+                
+                run++;
+                print_bench_result(spec, &result, num_pages, run == total_runs);
+                fprintf(stderr, "[%d/%d] %s -f %d -s %lld: %.3f秒, %.1f ns/次\n",
+                        run, total_runs, bench.policy->name, bench.num_frames,
+                        bench.seq_length, result.seconds, result.seconds * 1e9 / result.accesses);
+            }
+        }
+    }
+    
+    if (strcmp(spec->format, "json") == 0) {
+        printf("]\n");
+    }
+    ret = 0;
+    
+out:
+    free(sequence);
+    free(policy_values);
+    free(frame_values);
+    free(size_values);
+    return ret;
+}
+
+// ========== 多进程模拟 ==========
+
+// 多个进程的访问序列按时间片轮转交织，共享num_frames个页框，每个进程有自己的页号空间。
+// 进程p的页面在全局页号空间中编号为p * num_pages + 进程内页号
+
+typedef struct {
+    int *sequence;          // 本进程的访问序列（指令地址）
+    int access_pattern;
+    long long vtime;        // 虚拟时间：本进程已执行的访问次数
+    long long faults;
+    long long steals;       // 被其他进程或空闲页框不足强制换出的页面数
+    long long last_fault;   // PFF：上一次缺页的虚拟时间
+    int resident_count;     // 当前驻留页数
+    double resident_sum;    // 每次访问时累加驻留页数和工作集大小，求平均值
+    double ws_sum;
+    IndexList resident;     // ws/pff：驻留页面，头部最近访问
+    IndexList ws;           // 工作集：最近Δ次（虚拟时间）访问过的页面，头部最近访问
+    Simulator *local;       // local：本进程独占的模拟器
+} Process;
+
+typedef struct {
+    MultiSpec spec;
+    Config config;          // 单个进程的配置
+    int num_procs;
+    Process *procs;
+    int total_pages;        // 所有进程的页面数之和
+    int *merged;            // 交织后的访问序列（全局指令地址）
+    long long length;
+    int *owner;             // 全局页号所属进程
+    long long *last_ref;    // 页面最近一次访问时所属进程的虚拟时间
+    bool *resident;         // ws/pff：页面是否驻留
+    bool *in_ws;
+    int *rprev, *rnext;     // 进程驻留链表
+    int *gprev, *gnext;     // 所有驻留页面按实际时间排序的链表，空闲页框不足时从尾部抢占
+    int *wprev, *wnext;     // 工作集链表
+    IndexList global_lru;
+    int free_frames;
+    long long ws_total;     // 所有进程的工作集大小之和
+    long long ws_peak;
+    Simulator *global;      // global：所有进程共享的模拟器
+    int *frame_owner;       // global：页框中页面所属的进程
+    long long rounds;       // 轮转的轮数，每轮结束时检查是否抖动
+    long long thrashing_rounds;
+} MultiSim;
+
+// 工作集（影子链表，与实际驻留无关）：对各模式都维护，用于抖动检测。
+// 每个页面至多进出链表一次/次访问，摊还O(1)
+static void multi_update_ws(MultiSim *ms, Process *proc, int g) {
+    long long t = proc->vtime;
+    
+    if (ms->in_ws[g]) {
+        ilist_remove(&proc->ws, ms->wprev, ms->wnext, g);
+    } else {
+        ms->in_ws[g] = true;
+        ms->ws_total++;
+    }
+    ms->last_ref[g] = t;
+    ilist_push_front(&proc->ws, ms->wprev, ms->wnext, g);
+    
+    while (proc->ws.tail != -1 && ms->last_ref[proc->ws.tail] <= t - ms->spec.window) {
+        int old = proc->ws.tail;
+        ilist_remove(&proc->ws, ms->wprev, ms->wnext, old);
+        ms->in_ws[old] = false;
+        ms->ws_total--;
+    }
+    if (ms->ws_total > ms->ws_peak) {
+        ms->ws_peak = ms->ws_total;
+    }
+}
+
+static void multi_evict(MultiSim *ms, int g) {
+    Process *proc = &ms->procs[ms->owner[g]];
+    ilist_remove(&proc->resident, ms->rprev, ms->rnext, g);
+    ilist_remove(&ms->global_lru, ms->gprev, ms->gnext, g);
+    ms->resident[g] = false;
+    proc->resident_count--;
+    ms->free_frames++;
+}
+
+// ws/pff模式下的一次访问
+static void multi_access_dynamic(MultiSim *ms, Process *proc, int g) {
+    long long t = proc->vtime;
+    
+    if (ms->spec.mode == MULTI_WS) {
+        // 换出最近Δ次访问中没有访问过的驻留页面
+        while (proc->resident.tail != -1 &&
+               ms->last_ref[proc->resident.tail] <= t - ms->spec.window) {
+            multi_evict(ms, proc->resident.tail);
+        }
+    }
+    
+    if (ms->resident[g]) {
+        ilist_remove(&proc->resident, ms->rprev, ms->rnext, g);
+        ilist_push_front(&proc->resident, ms->rprev, ms->rnext, g);
+        ilist_remove(&ms->global_lru, ms->gprev, ms->gnext, g);
+        ilist_push_front(&ms->global_lru, ms->gprev, ms->gnext, g);
+        return;
+    }
+    
+    proc->faults++;
+    if (ms->spec.mode == MULTI_PFF) {
+        // 缺页间隔大于阈值说明缺页频率低：换出上次缺页以来没有访问过的页面。
+        // 驻留链表按访问时间排序，这些页面都在尾部
+        if (t - proc->last_fault > ms->spec.pff_threshold) {
+            while (proc->resident.tail != -1 &&
+                   ms->last_ref[proc->resident.tail] < proc->last_fault) {
+                multi_evict(ms, proc->resident.tail);
+            }
+        }
+        proc->last_fault = t;
+    }
+    
+    // 需求超过物理内存：抢占全局最久未访问的页面
+    if (ms->free_frames == 0) {
+        int victim = ms->global_lru.tail;
+        ms->procs[ms->owner[victim]].steals++;
+        multi_evict(ms, victim);
+    }
+    
+    ms->resident[g] = true;
+    ms->free_frames--;
+    proc->resident_count++;
+    ilist_push_front(&proc->resident, ms->rprev, ms->rnext, g);
+    ilist_push_front(&ms->global_lru, ms->gprev, ms->gnext, g);
+}
+
+static void multi_access(MultiSim *ms, long long index) {
+    int inst = ms->merged[index];
+    int p = inst / ms->config.total_instructions;
+    int page_id = inst % ms->config.total_instructions / ms->config.page_size;
+    int g = p * ms->config.num_pages + page_id;
+    Process *proc = &ms->procs[p];
+    
+    multi_update_ws(ms, proc, g);
+    
+    switch (ms->spec.mode) {
+        case MULTI_GLOBAL: {
+            Simulator *sim = ms->global;
+            long long faults = sim->page_faults;
+            int used = sim->used_frames;
+            access_page(sim, g, index, sim->next_use != NULL ? sim->next_use[index] : 0, false);
+            if (sim->page_faults != faults) {
+                int frame = sim->page_table[g];
+                if (frame < used) {
+                    // 置换了已有页面，可能属于其他进程
+                    Process *victim = &ms->procs[ms->frame_owner[frame]];
+                    victim->resident_count--;
+                    if (victim != proc) {
+                        victim->steals++;
+                    }
+                }
+                ms->frame_owner[frame] = p;
+                proc->resident_count++;
+                proc->faults++;
+            }
+            break;
+        }
+        case MULTI_LOCAL: {
+            Simulator *sim = proc->local;
+            long long faults = sim->page_faults;
+            access_page(sim, page_id, proc->vtime,
+                        sim->next_use != NULL ? sim->next_use[proc->vtime] : 0, false);
+            proc->faults += sim->page_faults - faults;
+            proc->resident_count = sim->used_frames;
+            break;
+        }
+        default:
+            multi_access_dynamic(ms, proc, g);
+            break;
+    }
+    
+    proc->resident_sum += proc->resident_count;
+    proc->ws_sum += proc->ws.size;
+    proc->vtime++;
+}
+
+static void multi_print(MultiSim *ms) {
+    Config *config = &ms->config;
+    long long total_faults = 0;
+    
+    printf("=== 多进程模拟结果 ===\n");
+    printf("%-6s %-6s %12s %12s %9s %11s %11s %11s\n",
+           "进程", "模式", "访问次数", "缺页次数", "缺页率", "平均工作集", "平均驻留页", "被抢占页");
+    for (int p = 0; p < ms->num_procs; p++) {
+        Process *proc = &ms->procs[p];
+        double n = proc->vtime > 0 ? (double)proc->vtime : 1;
+        printf("%-6d %-6d %12lld %12lld %8.2f%% %11.1f %11.1f %11lld\n",
+               p, proc->access_pattern, proc->vtime, proc->faults,
+               proc->faults / n * 100, proc->ws_sum / n, proc->resident_sum / n, proc->steals);
+        total_faults += proc->faults;
+    }
+    
+    printf("\n总访问次数: %lld\n", ms->length);
+    printf("总缺页次数: %lld\n", total_faults);
+    printf("系统缺页率: %.2f%%\n", (double)total_faults / ms->length * 100);
+    printf("工作集总和峰值: %lld（页框数 %d）\n", ms->ws_peak, config->num_frames);
+    printf("抖动轮次: %lld / %lld（工作集总和超过页框数）\n",
+           ms->thrashing_rounds, ms->rounds);
+    if (ms->rounds > 0 && ms->thrashing_rounds * 2 > ms->rounds) {
+        printf("\n检测到抖动：多数时间片轮次中各进程工作集之和超过物理页框数，\n");
+        printf("应减少并发进程数（负载控制）或增加页框\n");
+    }
+}
+
+static void multi_free(MultiSim *ms) {
+    for (int p = 0; p < ms->num_procs; p++) {
+        if (ms->procs[p].local != NULL) {
+            cleanup(ms->procs[p].local);
+            free(ms->procs[p].local);
+        }
+        free(ms->procs[p].sequence);
+    }
+    if (ms->global != NULL) {
+        cleanup(ms->global);
+        free(ms->global);
+    }
+    free(ms->procs);
+    free(ms->merged);
+    free(ms->owner);
+    free(ms->last_ref);
+    free(ms->resident);
+    free(ms->in_ws);
+    free(ms->rprev);
+    free(ms->rnext);
+    free(ms->gprev);
+    free(ms->gnext);
+    free(ms->wprev);
+    free(ms->wnext);
+    free(ms->frame_owner);
+}
+
+int run_multi(Config *config, const MultiSpec *spec) {
+    int *pattern_values = NULL;
+    int num_patterns = 1;
+    int ret = 1;
+    MultiSim ms;
+    
+    memset(&ms, 0, sizeof(ms));
+    
+    if (spec->pattern_spec != NULL) {
+        num_patterns = parse_int_values(spec->pattern_spec, &pattern_values);
+    } else {
+        pattern_values = (int*)malloc(sizeof(int));
+        pattern_values[0] = config->access_pattern;
+    }
+    if (num_patterns < 0) {
+        fprintf(stderr, "取值列表格式错误，参见 -h\n");
+        goto out;
+    }
+    for (int i = 0; i < num_patterns; i++) {
+        if (pattern_values[i] < 0 || pattern_values[i] >= NUM_PATTERNS) {
+            fprintf(stderr, "访问模式必须为0-6之间的数字\n");
+            goto out;
+        }
+    }
+    if (config->total_instructions % config->page_size != 0) {
+        fprintf(stderr, "总指令数必须是页面大小的整数倍\n");
+        goto out;
+    }
+    if ((long long)config->total_instructions * spec->num_procs > INT_MAX) {
+        fprintf(stderr, "进程数过多：总指令数 × 进程数超出范围\n");
+        goto out;
+    }
+    if (spec->mode == MULTI_LOCAL && config->num_frames < spec->num_procs) {
+        fprintf(stderr, "局部置换时页框数不能少于进程数\n");
+        goto out;
+    }
+    if (config->seq_length > config->total_instructions) {
+        config->seq_length = config->total_instructions;
+    }
+    config->num_pages = config->total_instructions / config->page_size;
+    
+    ms.spec = *spec;
+    ms.config = *config;
+    ms.num_procs = spec->num_procs;
+    ms.total_pages = config->num_pages * spec->num_procs;
+    ms.length = config->seq_length * spec->num_procs;
+    ms.free_frames = config->num_frames;
+    ms.procs = (Process*)calloc(ms.num_procs, sizeof(Process));
+    
+    // 每个进程按自己的访问模式生成访问序列（-m给出多个值时轮流分配）
+    for (int p = 0; p < ms.num_procs; p++) {
+        Process *proc = &ms.procs[p];
+        Simulator gen;
+        gen.config = *config;
+        gen.config.access_pattern = pattern_values[p % num_patterns];
+        gen.config.seed = rng_stream_seed(config->seed, p + 1);
+        gen.config.access_sequence = (int*)malloc(config->seq_length * sizeof(int));
+        generate_access_sequence(&gen);
+        proc->sequence = gen.config.access_sequence;
+        proc->access_pattern = gen.config.access_pattern;
+        proc->last_fault = -spec->pff_threshold - 1;
+        ilist_init(&proc->resident);
+        ilist_init(&proc->ws);
+    }
+    
+    // 按时间片轮转交织：每个进程连续执行quantum次访问后切换到下一个进程
+    ms.merged = (int*)malloc(ms.length * sizeof(int));
+    long long k = 0;
+    for (long long start = 0; start < config->seq_length; start += spec->quantum) {
+        long long end = start + spec->quantum < config->seq_length ? start + spec->quantum
+                                                                    : config->seq_length;
+        for (int p = 0; p < ms.num_procs; p++) {
+            for (long long i = start; i < end; i++) {
+                ms.merged[k++] = p * config->total_instructions + ms.procs[p].sequence[i];
+            }
+        }
+    }
+    
+    ms.owner = (int*)malloc(ms.total_pages * sizeof(int));
+    for (int g = 0; g < ms.total_pages; g++) {
+        ms.owner[g] = g / config->num_pages;
+    }
+    ms.last_ref = (long long*)malloc(ms.total_pages * sizeof(long long));
+    ms.resident = (bool*)calloc(ms.total_pages, sizeof(bool));
+    ms.in_ws = (bool*)calloc(ms.total_pages, sizeof(bool));
+    ms.rprev = alloc_links(ms.total_pages);
+    ms.rnext = alloc_links(ms.total_pages);
+    ms.gprev = alloc_links(ms.total_pages);
+    ms.gnext = alloc_links(ms.total_pages);
+    ms.wprev = alloc_links(ms.total_pages);
+    ms.wnext = alloc_links(ms.total_pages);
+    ilist_init(&ms.global_lru);
+    
+    if (spec->mode == MULTI_GLOBAL) {
+        // 全局置换：所有进程的页面由同一个策略在全部页框中选择置换对象
+        Config global = *config;
+        global.quiet = true;
+        global.total_instructions = config->total_instructions * ms.num_procs;
+        global.num_pages = ms.total_pages;
+        global.seq_length = ms.length;
+        global.access_sequence = ms.merged;
+        ms.global = (Simulator*)malloc(sizeof(Simulator));
+        init_simulator(ms.global, &global);
+        if (global.policy->needs_next_use) {
+            opt_prepare(ms.global);
+        }
+        ms.frame_owner = (int*)malloc(config->num_frames * sizeof(int));
+    } else if (spec->mode == MULTI_LOCAL) {
+        // 局部置换：页框平均分给各进程，每个进程只在自己的页框中置换
+        for (int p = 0; p < ms.num_procs; p++) {
+            Config local = *config;
+            local.quiet = true;
+            local.num_frames = config->num_frames / ms.num_procs +
+                               (p < config->num_frames % ms.num_procs ? 1 : 0);
+            local.access_sequence = ms.procs[p].sequence;
+            ms.procs[p].local = (Simulator*)malloc(sizeof(Simulator));
+            init_simulator(ms.procs[p].local, &local);
+            if (local.policy->needs_next_use) {
+                opt_prepare(ms.procs[p].local);
+            }
+        }
+    }
+    
+    printf("=== 多进程页面置换模拟 ===\n");
+    printf("进程数: %d\n", ms.num_procs);
+    printf("随机种子: %llu\n", (unsigned long long)config->seed);
+    printf("页框数量: %d\n", config->num_frames);
+    printf("每个进程: %d页，访问序列长度%lld\n", config->num_pages, config->seq_length);
+    printf("时间片: %d次访问\n", spec->quantum);
+    printf("分配方式: %s\n", multi_mode_titles[spec->mode]);
+    if (spec->mode == MULTI_GLOBAL || spec->mode == MULTI_LOCAL) {
+        printf("使用算法: %s\n", config->policy->title);
+    } else if (spec->mode == MULTI_PFF) {
+        printf("PFF缺页间隔阈值: %lld\n", spec->pff_threshold);
+    }
+    printf("工作集窗口Δ: %lld\n", spec->window);
+    printf("=============================\n\n");
+    
+    // 每轮时间片结束时，工作集总和超过页框数即记为一次抖动
+    long long round_length = (long long)spec->quantum * ms.num_procs;
+    for (long long i = 0; i < ms.length; i++) {
+        multi_access(&ms, i);
+        if ((i + 1) % round_length == 0 || i + 1 == ms.length) {
+            ms.rounds++;
+            if (ms.ws_total > config->num_frames) {
+                ms.thrashing_rounds++;
+            }
+        }
+    }
+    
+    multi_print(&ms);
+    ret = 0;
+    
+out:
+    multi_free(&ms);
+    free(pattern_values);
+    return ret;
 }
 
-void print_progress(int current, int total) {
-    int percent = (current * 100) / total;
+void print_progress(long long current, long long total) {
+    int percent = (int)((current * 100) / total);
     printf("模拟进度: [");
     int bars = percent / 5;
     for (int i = 0; i < 20; i++) {
@@ -525,8 +6521,8 @@ void print_progress(int current, int total) {
 void print_frames(Simulator *sim) {
     printf("当前页框状态: ");
     for (int i = 0; i < sim->config.num_frames; i++) {
-        if (sim->frames[i].valid) {
-            printf("[框%d:页%d] ", i, sim->frames[i].page_id);
+        if (sim->frames.valid[i / 64] & (1ULL << (i % 64))) {
+            printf("[框%d:页%d] ", i, sim->frames.page_id[i]);
         } else {
             printf("[框%d:空] ", i);
         }
@@ -536,11 +6532,40 @@ void print_frames(Simulator *sim) {
 
 void print_results(Simulator *sim) {
     printf("=== 模拟结果 ===\n");
-    printf("总访问次数: %d\n", sim->config.seq_length);
-    printf("缺页次数: %d\n", sim->page_faults);
-    printf("命中次数: %d\n", sim->config.seq_length - sim->page_faults);
-    printf("缺页率: %.2f%%\n", (float)sim->page_faults / sim->config.seq_length * 100);
-    printf("命中率: %.2f%%\n", (float)(sim->config.seq_length - sim->page_faults) / sim->config.seq_length * 100);
+    printf("总访问次数: %lld\n", sim->config.seq_length);
+    printf("缺页次数: %lld\n", sim->page_faults);
+    printf("命中次数: %lld\n", sim->config.seq_length - sim->page_faults);
+    printf("缺页率: %.2f%%\n", (double)sim->page_faults / sim->config.seq_length * 100);
+    printf("命中率: %.2f%%\n", (double)(sim->config.seq_length - sim->page_faults) / sim->config.seq_length * 100);
+    
+    // I/O代价：有效访问时间包含缺页等待磁盘（读入以及同步写回脏页）的时间
+    const IoState *io = &sim->io;
+    printf("\n=== I/O代价 ===\n");
+    printf("写访问次数: %lld\n", io->writes);
+    printf("换出时同步写回: %lld\n", io->writebacks);
+    printf("后台刷写: %lld\n", io->flushes);
+    printf("等待磁盘时间: %.1f us\n", io->stall_us);
+    printf("有效访问时间: %.3f us\n", io->clock_us / sim->config.seq_length);
+    
+    // 准确率：预取的页面中被用到的比例；覆盖率：原本会缺页的访问中被预取消除的比例；
+    // 污染：被预取挤出、之后又缺页的次数
+    if (sim->config.prefetcher != NULL) {
+        const PrefetchStats *pf = &sim->prefetch;
+        printf("\n=== 预取 ===\n");
+        printf("预取器: %s（每次最多%d页，预取缓冲%d页）\n", sim->config.prefetcher->title,
+               pf->max, pf->capacity);
+        printf("预取页数: %lld\n", pf->issued);
+        printf("有用预取: %lld\n", pf->useful);
+        printf("未访问即换出: %lld\n", pf->unused);
+        printf("准确率: %.2f%%\n", pf->issued > 0 ? (double)pf->useful / pf->issued * 100 : 0);
+        printf("覆盖率: %.2f%%\n", pf->useful + sim->page_faults > 0 ?
+               (double)pf->useful / (pf->useful + sim->page_faults) * 100 : 0);
+        printf("污染缺页: %lld\n", pf->pollution);
+    }
+    
+    if (sim->real.base != NULL) {
+        real_print(sim);
+    }
     
     // 打印最终页框状态
     printf("\n最终页框状态:\n");
@@ -556,7 +6581,33 @@ void print_results(Simulator *sim) {
 
 void cleanup(Simulator *sim) {
     free(sim->large_array);
-    free(sim->frames);
+    if (sim->real.base != NULL) {
+        munmap(sim->real.base, sim->real.length);
+    }
+    free(sim->frames.page_id);
+    free(sim->frames.last_used);
+    free(sim->frames.load_time);
+    free(sim->frames.valid);
+    free(sim->frames.dirty);
+    free(sim->frames.prefetched);
+    free(sim->prefetch.pages);
+    free(sim->prefetch.evicted);
+    free(sim->prefetch.ready_us);
+    free(sim->prefetch.buf_prev);
+    free(sim->prefetch.buf_next);
+    if (sim->prefetch_state != NULL) {
+        sim->config.prefetcher->destroy(sim->prefetch_state);
+    }
+    free(sim->io.flush_frame);
+    free(sim->io.flush_page);
     free(sim->page_table);
-    free(sim->config.access_sequence);
+    if (sim->policy_state != NULL) {
+        sim->config.policy->destroy(sim->policy_state);
+    }
+    if (sim->owns_next_use) {
+        free(sim->next_use);
+    }
+    if (sim->owns_sequence) {
+        free(sim->config.access_sequence);
+    }
 }
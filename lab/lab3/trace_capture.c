@@ -0,0 +1,871 @@
+// trace_capture.c
+// 从运行中的进程采集页粒度的访问流，输出page_replace可回放的PGTRACE文件
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <dirent.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// 与page_replace.c中的trace格式保持一致
+#define TRACE_MAGIC "PGTRACE"
+#define TRACE_VERSION 1
+#define TRACE_RECORD_PAGE 0
+#define TRACE_RECORD_ADDR 1
+#define TRACE_WRITE_FLAG (1ULL << 63)   // 记录最高位：写访问
+
+typedef struct {
+    char magic[8];          // "PGTRACE\0"
+    uint32_t version;       // TRACE_VERSION
+    uint32_t record_type;   // TRACE_RECORD_PAGE / TRACE_RECORD_ADDR
+    uint64_t page_size;     // 地址记录的页大小
+    uint64_t num_records;   // 记录数
+} TraceHeader;
+
+#define MODE_FAULT 0        // perf_event缺页采样
+#define MODE_DIRTY 1        // pagemap soft-dirty周期扫描
+
+#define RING_PAGES 64               // perf环形缓冲区数据页数（必须是2的幂）
+#define MAX_EVENTS 1024             // 最多的perf环形缓冲区数（CPU数）
+#define WRITE_BUFFER_RECORDS 4096
+#define PAGEMAP_BATCH 512           // 每次pread的pagemap表项数
+#define PM_SOFT_DIRTY (1ULL << 55)
+
+static long page_size;
+static volatile sig_atomic_t stop_requested = 0;
+static FILE *log_fp;                // 状态信息（trace写到标准输出时为stderr）
+
+// ========== trace输出（可选的页号稠密化） ==========
+// 虚拟页号通常稀疏且很大，直接作为页号会让模拟器的页表过大，
+// 因此默认按首次出现顺序重编号为0..N-1
+typedef struct {
+    FILE *fp;
+    bool raw;                   // true: 写原始地址记录
+    bool stream;                // 输出为管道或FIFO：每批样本后立即刷出，结束时不回填记录数
+    uint64_t buffer[WRITE_BUFFER_RECORDS];
+    int buffered;
+    uint64_t records;
+    uint64_t *keys;             // 开放寻址哈希表：虚拟页号+1（0表示空槽）
+    uint64_t *ids;
+    uint64_t capacity;
+    uint64_t distinct;
+} TraceWriter;
+
+static inline uint64_t hash_vpage(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+int writer_open(TraceWriter *w, const char *path, bool raw) {
+    TraceHeader header;
+
+    memset(w, 0, sizeof(*w));
+    w->raw = raw;
+    w->fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if (w->fp == NULL) {
+        perror("fopen output");
+        return -1;
+    }
+    w->stream = lseek(fileno(w->fp), 0, SEEK_CUR) < 0;
+
+    // 记录数先写0（由文件大小决定），结束时再回填
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header.version = TRACE_VERSION;
+    header.record_type = raw ? TRACE_RECORD_ADDR : TRACE_RECORD_PAGE;
+    header.page_size = raw ? (uint64_t)page_size : 0;
+    if (fwrite(&header, sizeof(header), 1, w->fp) != 1) {
+        perror("fwrite header");
+        fclose(w->fp);
+        return -1;
+    }
+
+    if (!raw) {
+        w->capacity = 1 << 16;
+        w->keys = calloc(w->capacity, sizeof(uint64_t));
+        w->ids = malloc(w->capacity * sizeof(uint64_t));
+        if (w->keys == NULL || w->ids == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            fclose(w->fp);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int writer_grow(TraceWriter *w) {
+    uint64_t new_capacity = w->capacity * 2;
+    uint64_t *keys = calloc(new_capacity, sizeof(uint64_t));
+    uint64_t *ids = malloc(new_capacity * sizeof(uint64_t));
+    if (keys == NULL || ids == NULL) {
+        free(keys);
+        free(ids);
+        return -1;
+    }
+
+    for (uint64_t i = 0; i < w->capacity; i++) {
+        if (w->keys[i] == 0) {
+            continue;
+        }
+        uint64_t slot = hash_vpage(w->keys[i]) & (new_capacity - 1);
+        while (keys[slot] != 0) {
+            slot = (slot + 1) & (new_capacity - 1);
+        }
+        keys[slot] = w->keys[i];
+        ids[slot] = w->ids[i];
+    }
+
+    free(w->keys);
+    free(w->ids);
+    w->keys = keys;
+    w->ids = ids;
+    w->capacity = new_capacity;
+    return 0;
+}
+
+static uint64_t writer_dense_id(TraceWriter *w, uint64_t vpage) {
+    uint64_t key = vpage + 1;
+    uint64_t slot = hash_vpage(key) & (w->capacity - 1);
+
+    while (w->keys[slot] != 0) {
+        if (w->keys[slot] == key) {
+            return w->ids[slot];
+        }
+        slot = (slot + 1) & (w->capacity - 1);
+    }
+
+    w->keys[slot] = key;
+    w->ids[slot] = w->distinct;
+    w->distinct++;
+    if (w->distinct * 2 > w->capacity && writer_grow(w) < 0) {
+        fprintf(stderr, "Out of memory while renumbering pages\n");
+        exit(1);
+    }
+    return w->distinct - 1;
+}
+
+static int writer_flush(TraceWriter *w) {
+    if (w->buffered > 0 &&
+        fwrite(w->buffer, sizeof(uint64_t), w->buffered, w->fp) != (size_t)w->buffered) {
+        perror("fwrite trace");
+        return -1;
+    }
+    w->buffered = 0;
+    return 0;
+}
+
+static int writer_put(TraceWriter *w, uint64_t vaddr, bool write) {
+    uint64_t record = w->raw ? vaddr : writer_dense_id(w, vaddr / (uint64_t)page_size);
+    if (write) {
+        record |= TRACE_WRITE_FLAG;
+    }
+
+    w->buffer[w->buffered++] = record;
+    w->records++;
+    if (w->buffered == WRITE_BUFFER_RECORDS) {
+        return writer_flush(w);
+    }
+    return 0;
+}
+
+// 流式输出时把已采集的记录交给读端（page_replace -t -），不等缓冲区写满
+static int writer_sync(TraceWriter *w) {
+    if (!w->stream) {
+        return 0;
+    }
+    if (writer_flush(w) < 0 || fflush(w->fp) != 0) {
+        perror("flush trace");
+        return -1;
+    }
+    return 0;
+}
+
+int writer_close(TraceWriter *w) {
+    int ret = writer_flush(w);
+
+    // 回填记录数（管道无法回填，读端按流读到结束为止）
+    if (ret == 0 && !w->stream) {
+        uint64_t n = w->records;
+        if (fseek(w->fp, offsetof(TraceHeader, num_records), SEEK_SET) != 0 ||
+            fwrite(&n, sizeof(n), 1, w->fp) != 1) {
+            perror("finalize header");
+            ret = -1;
+        }
+    }
+    if (fclose(w->fp) != 0) {
+        perror("fclose output");
+        ret = -1;
+    }
+    free(w->keys);
+    free(w->ids);
+    return ret;
+}
+
+// ========== 目标进程 ==========
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 启动子进程，子进程阻塞在管道上直到采集端准备好再exec
+// quiet_stdout: trace写在标准输出上，目标进程的标准输出改到stderr
+pid_t launch_target(char **argv, int *go_fd, bool quiet_stdout) {
+    int pipefd[2];
+    if (pipe(pipefd) < 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        char c;
+        close(pipefd[1]);
+        if (read(pipefd[0], &c, 1) != 1) {
+            _exit(127);
+        }
+        close(pipefd[0]);
+        if (quiet_stdout) {
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+        }
+        execvp(argv[0], argv);
+        perror("execvp");
+        _exit(127);
+    }
+
+    close(pipefd[0]);
+    *go_fd = pipefd[1];
+    return pid;
+}
+
+static void release_target(int *go_fd) {
+    if (*go_fd >= 0) {
+        if (write(*go_fd, "x", 1) != 1) {
+            perror("write go pipe");
+        }
+        close(*go_fd);
+        *go_fd = -1;
+    }
+}
+
+// 目标是否仍在运行：自己启动的子进程用waitpid，附加的进程用kill(pid, 0)
+static bool target_alive(pid_t pid, bool launched) {
+    if (launched) {
+        int status;
+        return waitpid(pid, &status, WNOHANG) == 0;
+    }
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+// ========== 模式1：perf_event缺页采样 ==========
+// 软件事件PERF_COUNT_SW_PAGE_FAULTS在每次缺页时产生样本，PERF_SAMPLE_ADDR
+// 给出缺页地址。缺页只发生在首次访问和页被回收后再次访问时，因此得到的是
+// 缺页流而不是完整的访问流；-c可以按周期抽样进一步降低开销
+//
+// 内核不允许mmap按任务继承（inherit）且cpu=-1的事件，因此每个CPU一个环形缓冲区，
+// 事件都是按CPU的inherit事件，覆盖之后创建的所有线程和子进程：
+//   启动目标：每个CPU一个事件
+//   附加目标：每个已有线程在每个CPU上一个事件，同一CPU上的事件输出到同一个缓冲区。
+//             附加之后由这些线程创建的线程和子进程同样继承事件
+// 多个缓冲区的样本按时间戳排序后再写入
+typedef struct {
+    uint64_t time;
+    uint64_t addr;
+} FaultSample;
+
+typedef struct {
+    int *fds;                   // 所有事件
+    int nfds;
+    int ring_fds[MAX_EVENTS];   // 每个CPU上拥有环形缓冲区的事件
+    void *rings[MAX_EVENTS];
+    int nrings;
+    size_t map_len;
+    FaultSample *batch;
+    size_t batch_len;
+    size_t batch_cap;
+    uint64_t lost;
+} FaultCapture;
+
+static long perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu,
+                            int group_fd, unsigned long flags) {
+    return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+static int open_fault_event(pid_t pid, int cpu, int period, bool launched) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+    attr.sample_period = period;
+    attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_ADDR;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.wakeup_events = 64;
+    attr.inherit = 1;             // 跟随之后创建的线程和子进程
+    if (launched) {
+        attr.enable_on_exec = 1;  // 跳过exec之前采集端fork出的子进程自身的缺页
+    }
+
+    return (int)perf_event_open(&attr, pid, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void report_open_error(void) {
+    perror("perf_event_open");
+    if (errno == EACCES || errno == EPERM) {
+        fprintf(stderr, "Hint: check /proc/sys/kernel/perf_event_paranoid\n");
+    }
+}
+
+// 列出进程的所有线程，*tids由调用者释放
+static int list_threads(pid_t pid, pid_t **tids) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        perror("opendir task");
+        return -1;
+    }
+
+    int count = 0, capacity = 64;
+    *tids = malloc(capacity * sizeof(pid_t));
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] >= '0' && ent->d_name[0] <= '9') {
+            if (count == capacity) {
+                capacity *= 2;
+                *tids = realloc(*tids, capacity * sizeof(pid_t));
+            }
+            (*tids)[count++] = (pid_t)atoi(ent->d_name);
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+static int map_ring(FaultCapture *cap, int fd) {
+    void *ring = mmap(NULL, cap->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ring == MAP_FAILED) {
+        perror("mmap perf ring");
+        return -1;
+    }
+    cap->ring_fds[cap->nrings] = fd;
+    cap->rings[cap->nrings++] = ring;
+    return 0;
+}
+
+// 附加目标时事件数为线程数×CPU数，把文件描述符上限提高到硬上限
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static int open_fault_capture(FaultCapture *cap, pid_t pid, bool launched, int period) {
+    pid_t *tids = NULL;
+    int num_tids = 1;
+
+    memset(cap, 0, sizeof(*cap));
+    cap->map_len = (size_t)(RING_PAGES + 1) * page_size;
+
+    if (launched) {
+        tids = malloc(sizeof(pid_t));
+        tids[0] = pid;
+    } else {
+        num_tids = list_threads(pid, &tids);
+        if (num_tids <= 0) {
+            free(tids);
+            return -1;
+        }
+        raise_fd_limit();
+    }
+
+    long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    if (ncpu > MAX_EVENTS) {
+        ncpu = MAX_EVENTS;
+    }
+    cap->fds = malloc((size_t)ncpu * num_tids * sizeof(int));
+    for (int cpu = 0; cpu < ncpu; cpu++) {
+        int ring_fd = -1;
+        for (int i = 0; i < num_tids; i++) {
+            int fd = open_fault_event(tids[i], cpu, period, launched);
+            if (fd < 0) {
+                if (errno == ENODEV) {
+                    break;      // 离线CPU
+                }
+                // 线程可能在枚举之后退出了，只有主线程失败才是致命的
+                if (errno == ESRCH && tids[i] != pid) {
+                    continue;
+                }
+                report_open_error();
+                free(tids);
+                return -1;
+            }
+            cap->fds[cap->nfds++] = fd;
+            if (ring_fd < 0) {
+                if (map_ring(cap, fd) < 0) {
+                    free(tids);
+                    return -1;
+                }
+                ring_fd = fd;
+            } else if (ioctl(fd, PERF_EVENT_IOC_SET_OUTPUT, ring_fd) < 0) {
+                perror("PERF_EVENT_IOC_SET_OUTPUT");
+                free(tids);
+                return -1;
+            }
+        }
+    }
+    free(tids);
+
+    if (cap->nrings == 0) {
+        fprintf(stderr, "No perf events could be opened\n");
+        return -1;
+    }
+    cap->batch_cap = 4096;
+    cap->batch = malloc(cap->batch_cap * sizeof(FaultSample));
+    if (cap->batch == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void close_fault_capture(FaultCapture *cap) {
+    for (int i = 0; i < cap->nrings; i++) {
+        munmap(cap->rings[i], cap->map_len);
+    }
+    for (int i = 0; i < cap->nfds; i++) {
+        close(cap->fds[i]);
+    }
+    free(cap->fds);
+    free(cap->batch);
+}
+
+static int batch_push(FaultCapture *cap, uint64_t time, uint64_t addr) {
+    if (cap->batch_len == cap->batch_cap) {
+        size_t new_cap = cap->batch_cap * 2;
+        FaultSample *batch = realloc(cap->batch, new_cap * sizeof(FaultSample));
+        if (batch == NULL) {
+            return -1;
+        }
+        cap->batch = batch;
+        cap->batch_cap = new_cap;
+    }
+    cap->batch[cap->batch_len].time = time;
+    cap->batch[cap->batch_len].addr = addr;
+    cap->batch_len++;
+    return 0;
+}
+
+// 取出一个环形缓冲区中的所有样本放入批次
+static int drain_ring(FaultCapture *cap, struct perf_event_mmap_page *meta) {
+    char *data = (char*)meta + page_size;
+    uint64_t size = meta->data_size;
+    uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+    uint64_t tail = meta->data_tail;
+    char record[256];
+    int ret = 0;
+
+    while (tail < head) {
+        uint64_t offset = tail % size;
+        uint16_t len = ((struct perf_event_header*)(data + offset))->size;
+        if (len == 0 || len > sizeof(record)) {
+            break;
+        }
+
+        // 记录可能跨过缓冲区末尾，先拼接到本地
+        if (offset + len <= size) {
+            memcpy(record, data + offset, len);
+        } else {
+            uint64_t first = size - offset;
+            memcpy(record, data + offset, first);
+            memcpy(record + first, data, len - first);
+        }
+        struct perf_event_header *hdr = (struct perf_event_header*)record;
+
+        if (hdr->type == PERF_RECORD_SAMPLE) {
+            // sample_type = TID | TIME | ADDR
+            uint64_t fields[2];
+            memcpy(fields, record + sizeof(*hdr) + 2 * sizeof(uint32_t), sizeof(fields));
+            if (batch_push(cap, fields[0], fields[1]) < 0) {
+                ret = -1;
+            }
+        } else if (hdr->type == PERF_RECORD_LOST) {
+            uint64_t count;
+            memcpy(&count, record + sizeof(*hdr) + sizeof(uint64_t), sizeof(count));
+            cap->lost += count;
+        }
+        tail += len;
+    }
+
+    __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+    return ret;
+}
+
+static int compare_samples(const void *a, const void *b) {
+    uint64_t ta = ((const FaultSample*)a)->time;
+    uint64_t tb = ((const FaultSample*)b)->time;
+    return (ta > tb) - (ta < tb);
+}
+
+// 取出所有缓冲区的样本，按时间排序后写入trace
+static int drain_all(FaultCapture *cap, TraceWriter *w) {
+    int ret = 0;
+
+    cap->batch_len = 0;
+    for (int i = 0; i < cap->nrings; i++) {
+        if (drain_ring(cap, cap->rings[i]) < 0) {
+            ret = -1;
+        }
+    }
+    if (cap->nrings > 1) {
+        qsort(cap->batch, cap->batch_len, sizeof(FaultSample), compare_samples);
+    }
+    for (size_t i = 0; i < cap->batch_len; i++) {
+        if (writer_put(w, cap->batch[i].addr, false) < 0) {
+            ret = -1;
+            break;
+        }
+    }
+    return ret;
+}
+
+int run_fault_mode(pid_t pid, bool launched, int *go_fd, int period,
+                   double duration, TraceWriter *w) {
+    FaultCapture cap;
+    static struct pollfd pfds[MAX_EVENTS];
+    int ret = 0;
+
+    if (open_fault_capture(&cap, pid, launched, period) < 0) {
+        close_fault_capture(&cap);
+        return -1;
+    }
+
+    if (launched) {
+        release_target(go_fd);  // 事件在exec时自动启用
+    } else {
+        for (int i = 0; i < cap.nfds; i++) {
+            ioctl(cap.fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    fprintf(log_fp, "Capturing page faults of PID %d (%d event%s, period %d)\n",
+           (int)pid, cap.nfds, cap.nfds > 1 ? "s" : "", period);
+
+    for (int i = 0; i < cap.nrings; i++) {
+        pfds[i].fd = cap.ring_fds[i];
+        pfds[i].events = POLLIN;
+    }
+    double start = now_seconds();
+
+    while (!stop_requested) {
+        poll(pfds, cap.nrings, 100);
+        if (drain_all(&cap, w) < 0 || writer_sync(w) < 0) {
+            ret = -1;
+            break;
+        }
+        if (!target_alive(pid, launched)) {
+            break;
+        }
+        if (duration > 0 && now_seconds() - start >= duration) {
+            break;
+        }
+    }
+
+    for (int i = 0; i < cap.nfds; i++) {
+        ioctl(cap.fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    if (ret == 0 && drain_all(&cap, w) < 0) {
+        ret = -1;
+    }
+    if (cap.lost > 0) {
+        fprintf(stderr, "Warning: %lu samples lost (ring buffer overflow)\n",
+                (unsigned long)cap.lost);
+    }
+
+    close_fault_capture(&cap);
+    return ret;
+}
+
+// ========== 模式2：soft-dirty周期扫描 ==========
+// 每个周期向clear_refs写4清除soft-dirty位，间隔结束后扫描所有可写映射的
+// pagemap，把本周期内被写过的页按地址顺序输出（带写访问标志）。只能观察到写访问，
+// 周期内的访问顺序和重复次数会丢失，换来的是几乎不打扰目标进程
+static int clear_soft_dirty(pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/clear_refs", (int)pid);
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        perror("open clear_refs");
+        return -1;
+    }
+    int ok = write(fd, "4", 1) == 1;
+    if (!ok) {
+        perror("write clear_refs");
+    }
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+static long scan_soft_dirty(pid_t pid, int pagemap_fd, TraceWriter *w) {
+    char path[64];
+    char line[512];
+    uint64_t entries[PAGEMAP_BATCH];
+    long dirty = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+    FILE *maps = fopen(path, "r");
+    if (maps == NULL) {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), maps) != NULL) {
+        unsigned long start, end;
+        char perms[5];
+        if (sscanf(line, "%lx-%lx %4s", &start, &end, perms) != 3 || perms[1] != 'w') {
+            continue;
+        }
+
+        uint64_t first = start / page_size;
+        uint64_t last = end / page_size;
+        for (uint64_t vpage = first; vpage < last; vpage += PAGEMAP_BATCH) {
+            uint64_t count = last - vpage < PAGEMAP_BATCH ? last - vpage : PAGEMAP_BATCH;
+            ssize_t got = pread(pagemap_fd, entries, count * sizeof(uint64_t),
+                                (off_t)(vpage * sizeof(uint64_t)));
+            if (got <= 0) {
+                break;
+            }
+            for (uint64_t k = 0; k < (uint64_t)got / sizeof(uint64_t); k++) {
+                if (entries[k] & PM_SOFT_DIRTY) {
+                    if (writer_put(w, (vpage + k) * (uint64_t)page_size, true) < 0) {
+                        fclose(maps);
+                        return -1;
+                    }
+                    dirty++;
+                }
+            }
+        }
+    }
+
+    fclose(maps);
+    return dirty;
+}
+
+int run_dirty_mode(pid_t pid, bool launched, int *go_fd, int interval_ms,
+                   double duration, TraceWriter *w) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/pagemap", (int)pid);
+    int pagemap_fd = open(path, O_RDONLY);
+    if (pagemap_fd < 0) {
+        perror("open pagemap");
+        return -1;
+    }
+
+    release_target(go_fd);
+    fprintf(log_fp, "Scanning soft-dirty pages of PID %d every %d ms\n", (int)pid, interval_ms);
+
+    struct timespec interval = { interval_ms / 1000, (interval_ms % 1000) * 1000000L };
+    double start = now_seconds();
+    long epochs = 0;
+    long total_dirty = 0;
+    int ret = 0;
+
+    if (clear_soft_dirty(pid) < 0) {
+        close(pagemap_fd);
+        return -1;
+    }
+    while (!stop_requested) {
+        nanosleep(&interval, NULL);
+        if (!target_alive(pid, launched)) {
+            break;
+        }
+        long dirty = scan_soft_dirty(pid, pagemap_fd, w);
+        if (dirty >= 0 && writer_sync(w) < 0) {
+            ret = -1;
+            break;
+        }
+        if (dirty < 0 || clear_soft_dirty(pid) < 0) {
+            // 目标在扫描过程中退出时maps/clear_refs会失败
+            if (target_alive(pid, launched)) {
+                ret = -1;
+            }
+            break;
+        }
+        total_dirty += dirty;
+        epochs++;
+        if (duration > 0 && now_seconds() - start >= duration) {
+            break;
+        }
+    }
+
+    fprintf(log_fp, "Scanned %ld epochs\n", epochs);
+    if (epochs > 0 && total_dirty == 0) {
+        fprintf(stderr, "Warning: no soft-dirty pages seen, kernel may lack CONFIG_MEM_SOFT_DIRTY\n");
+    }
+    close(pagemap_fd);
+    return ret;
+}
+
+// ========== 主函数 ==========
+void show_usage(char *prog) {
+    printf("Usage: %s [options] (-p PID | -- COMMAND [ARGS...])\n", prog);
+    printf("  -m fault  : sample page faults via perf_event_open (default)\n");
+    printf("  -m dirty  : periodically scan soft-dirty bits in /proc/PID/pagemap\n");
+    printf("  -o FILE   : output trace file (default: trace.bin); - writes to stdout,\n");
+    printf("              which together with a FIFO feeds page_replace -t - online\n");
+    printf("  -p PID    : attach to a running process\n");
+    printf("  -c N      : fault mode, record one sample every N faults (default: 1)\n");
+    printf("  -i MS     : dirty mode, scan interval in milliseconds (default: 100)\n");
+    printf("  -d SEC    : stop after SEC seconds (default: until the target exits)\n");
+    printf("  -r        : write raw virtual addresses instead of dense page numbers;\n");
+    printf("              page_replace -t FILE compacts them when loading, the online\n");
+    printf("              mode (page_replace -t -) needs dense page numbers\n");
+    printf("Replay with: page_replace -t FILE -f FRAMES -a ALGORITHM\n");
+    printf("Online:      %s -o - -- COMMAND | page_replace -t - -f FRAMES\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    page_size = sysconf(_SC_PAGESIZE);
+    if (page_size == -1) {
+        perror("sysconf _SC_PAGESIZE");
+        return 1;
+    }
+
+    int mode = MODE_FAULT;
+    const char *output = "trace.bin";
+    pid_t pid = 0;
+    int period = 1;
+    int interval_ms = 100;
+    double duration = 0;
+    bool raw = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "+m:o:p:c:i:d:rh")) != -1) {
+        switch (opt) {
+            case 'm':
+                if (strcmp(optarg, "fault") == 0) {
+                    mode = MODE_FAULT;
+                } else if (strcmp(optarg, "dirty") == 0) {
+                    mode = MODE_DIRTY;
+                } else {
+                    fprintf(stderr, "Error: mode must be fault or dirty\n");
+                    return 1;
+                }
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'p':
+                pid = (pid_t)atoi(optarg);
+                break;
+            case 'c':
+                period = atoi(optarg);
+                break;
+            case 'i':
+                interval_ms = atoi(optarg);
+                break;
+            case 'd':
+                duration = atof(optarg);
+                break;
+            case 'r':
+                raw = true;
+                break;
+            case 'h':
+            default:
+                show_usage(argv[0]);
+                return 0;
+        }
+    }
+
+    bool launched = optind < argc;
+    if (launched == (pid > 0)) {
+        fprintf(stderr, "Error: specify either -p PID or a command to run\n");
+        show_usage(argv[0]);
+        return 1;
+    }
+    if (period < 1 || interval_ms < 1) {
+        fprintf(stderr, "Error: -c and -i must be positive\n");
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    // 读端退出时写trace返回EPIPE而不是直接被SIGPIPE终止
+    signal(SIGPIPE, SIG_IGN);
+
+    bool to_stdout = strcmp(output, "-") == 0;
+    log_fp = to_stdout ? stderr : stdout;
+
+    TraceWriter writer;
+    if (writer_open(&writer, output, raw) < 0) {
+        return 1;
+    }
+
+    int go_fd = -1;
+    if (launched) {
+        pid = launch_target(&argv[optind], &go_fd, to_stdout);
+        if (pid < 0) {
+            writer_close(&writer);
+            return 1;
+        }
+    }
+
+    int ret = mode == MODE_FAULT
+        ? run_fault_mode(pid, launched, &go_fd, period, duration, &writer)
+        : run_dirty_mode(pid, launched, &go_fd, interval_ms, duration, &writer);
+
+    // 准备失败时子进程还在等待，关闭管道让它直接退出
+    if (go_fd >= 0) {
+        close(go_fd);
+    }
+    if (launched) {
+        waitpid(pid, NULL, 0);
+    }
+
+    uint64_t records = writer.records;
+    uint64_t distinct = writer.distinct;
+    if (writer_close(&writer) < 0) {
+        ret = -1;
+    }
+
+    fprintf(log_fp, "Wrote %lu records to %s", (unsigned long)records,
+            to_stdout ? "stdout" : output);
+    if (!raw) {
+        fprintf(log_fp, " (%lu distinct pages)", (unsigned long)distinct);
+    }
+    fprintf(log_fp, "\n");
+    return ret < 0 ? 1 : 0;
+}
@@ -7,43 +7,245 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <sys/syscall.h>
 #include <dlfcn.h>
 #include <string.h>
+#include <errno.h>
 #include <getopt.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
 
 static long page_size;
 
-// 通用函数：通过 /proc/pid/pagemap 获取物理地址
-uint64_t get_phys_addr(pid_t pid, void *virt_addr) {
+// pagemap表项各位的含义（见内核文档 admin-guide/mm/pagemap.rst）
+#define PM_PFN_MASK     ((1ULL << 55) - 1)
+#define PM_SOFT_DIRTY   (1ULL << 55)
+#define PM_EXCLUSIVE    (1ULL << 56)
+#define PM_FILE         (1ULL << 61)
+#define PM_SWAP         (1ULL << 62)
+#define PM_PRESENT      (1ULL << 63)
+
+// 批量转换返回的页面标志
+#define PAGE_PRESENT    0x01
+#define PAGE_SWAPPED    0x02
+#define PAGE_FILE       0x04    // 文件页或共享匿名页
+#define PAGE_EXCLUSIVE  0x08    // 只被这一个进程映射
+#define PAGE_SOFT_DIRTY 0x10
+
+#define PAGEMAP_BATCH   8192    // 每次pread读取的表项数（64KB，一次系统调用覆盖32MB虚拟地址）
+
+// 保持打开的pagemap文件，批量转换时不必每个地址都open/close
+typedef struct {
+    pid_t pid;
+    int fd;
+    long reads;     // pread次数
+} Pagemap;
+
+// 失败返回-1（原因见errno），由调用者报告：扫描多个进程时内核线程等打不开是正常的
+int pagemap_open(Pagemap *pm, pid_t pid) {
     char pagemap_path[64];
     snprintf(pagemap_path, sizeof(pagemap_path), "/proc/%d/pagemap", (int)pid);
-    int fd = open(pagemap_path, O_RDONLY);
-    if (fd < 0) {
-        perror("open pagemap");
-        return 0;
+    pm->pid = pid;
+    pm->reads = 0;
+    pm->fd = open(pagemap_path, O_RDONLY);
+    return pm->fd < 0 ? -1 : 0;
+}
+
+void pagemap_close(Pagemap *pm) {
+    if (pm->fd >= 0) {
+        close(pm->fd);
+        pm->fd = -1;
     }
+}
 
-    uint64_t virt_page = (uintptr_t)virt_addr / page_size;
-    uint64_t entry;
-    off_t offset = virt_page * sizeof(entry);
+// 转换从vaddr所在页开始的npages个页面：pfn[i]为物理页号（不在内存中或无权限时为0），
+// flags[i]为PAGE_*标志。每次pread读PAGEMAP_BATCH个表项，直接读进pfn数组再原地解码。
+// 返回实际转换的页数（遇到地址空间末尾时可能少于npages），出错返回-1
+long pagemap_translate(Pagemap *pm, uint64_t vaddr, size_t npages, uint64_t *pfn, uint8_t *flags) {
+    uint64_t first_page = vaddr / page_size;
+    size_t done = 0;
 
-    if (pread(fd, &entry, sizeof(entry), offset) != sizeof(entry)) {
-        perror("pread pagemap");
-        close(fd);
+    while (done < npages) {
+        size_t count = npages - done < PAGEMAP_BATCH ? npages - done : PAGEMAP_BATCH;
+        off_t offset = (off_t)(first_page + done) * sizeof(uint64_t);
+        ssize_t got = pread(pm->fd, pfn + done, count * sizeof(uint64_t), offset);
+        pm->reads++;
+        if (got < 0) {
+            perror("pread pagemap");
+            return -1;
+        }
+        if (got == 0) {
+            break;
+        }
+        done += (size_t)got / sizeof(uint64_t);
+    }
+
+    for (size_t i = 0; i < done; i++) {
+        uint64_t entry = pfn[i];
+        flags[i] = ((entry & PM_PRESENT) ? PAGE_PRESENT : 0) |
+                   ((entry & PM_SWAP) ? PAGE_SWAPPED : 0) |
+                   ((entry & PM_FILE) ? PAGE_FILE : 0) |
+                   ((entry & PM_EXCLUSIVE) ? PAGE_EXCLUSIVE : 0) |
+                   ((entry & PM_SOFT_DIRTY) ? PAGE_SOFT_DIRTY : 0);
+        // 换出的页面低位是交换区位置而不是物理页号
+        pfn[i] = (entry & PM_PRESENT) ? (entry & PM_PFN_MASK) : 0;
+    }
+    return (long)done;
+}
+
+// 通用函数：通过 /proc/pid/pagemap 获取物理地址
+uint64_t get_phys_addr(pid_t pid, void *virt_addr) {
+    Pagemap pm;
+    uint64_t pfn;
+    uint8_t flags;
+
+    if (pagemap_open(&pm, pid) < 0) {
+        perror("open pagemap");
         return 0;
     }
-    close(fd);
+    long n = pagemap_translate(&pm, (uintptr_t)virt_addr, 1, &pfn, &flags);
+    pagemap_close(&pm);
 
-    if (!(entry & (1ULL << 63))) {
+    if (n != 1 || !(flags & PAGE_PRESENT)) {
         // printf("Page not present in RAM.\n");
         return 0;
     }
 
-    uint64_t pfn = entry & ((1ULL << 55) - 1);
     uint64_t page_offset = (uintptr_t)virt_addr % page_size;
     return (pfn << (__builtin_ctzll(page_size))) + page_offset;
 }
 
+// ========== 进程的虚拟内存区域 ==========
+#define VMA_PATH_MAX 256
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    char perms[5];
+    char path[VMA_PATH_MAX];    // 映射的文件或[heap]等，匿名映射为空
+} Vma;
+
+// 读取/proc/pid/maps中的所有区域，返回区域个数，出错返回-1（原因见errno）。*vmas由调用者释放
+int read_maps(pid_t pid, Vma **vmas) {
+    char maps_path[64];
+    char line[VMA_PATH_MAX + 128];
+    int count = 0, capacity = 64;
+
+    snprintf(maps_path, sizeof(maps_path), "/proc/%d/maps", (int)pid);
+    FILE *fp = fopen(maps_path, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    *vmas = malloc(capacity * sizeof(Vma));
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        Vma v;
+        int path_pos = 0;
+        if (sscanf(line, "%lx-%lx %4s %*s %*s %*s %n", &v.start, &v.end, v.perms,
+                   &path_pos) < 3) {
+            continue;
+        }
+        snprintf(v.path, sizeof(v.path), "%s", path_pos > 0 ? line + path_pos : "");
+        v.path[strcspn(v.path, "\n")] = '\0';
+        if (count == capacity) {
+            capacity *= 2;
+            *vmas = realloc(*vmas, capacity * sizeof(Vma));
+        }
+        (*vmas)[count++] = v;
+    }
+    fclose(fp);
+    return count;
+}
+
+// ========== 物理页的内核信息（kpageflags / kpagecount） ==========
+// kpageflags各位（见内核文档 admin-guide/mm/pagemap.rst）
+#define KPF_LRU         5
+#define KPF_ANON        12
+#define KPF_COMPOUND_HEAD 15
+#define KPF_COMPOUND_TAIL 16
+#define KPF_HUGE        17      // hugetlbfs大页
+#define KPF_THP         22
+#define KPF_ZERO_PAGE   24      // 共享零页（只读访问过的匿名页）
+
+#define KPAGE_CHUNK     512     // 按物理页号分块读取，每块一次pread（4KB）
+
+// 两个文件都按物理页号索引，每页8字节。进程的物理页号分散，按块缓存读过的部分，
+// 读取量不超过两个文件本身的大小
+typedef struct {
+    int flags_fd;
+    int count_fd;
+    uint64_t **flags;   // flags[块号]，未读过为NULL
+    uint64_t **count;
+    size_t num_chunks;
+    long reads;
+} KpageTable;
+
+int kpage_open(KpageTable *kt) {
+    kt->flags = NULL;
+    kt->count = NULL;
+    kt->num_chunks = 0;
+    kt->reads = 0;
+    kt->flags_fd = open("/proc/kpageflags", O_RDONLY);
+    kt->count_fd = open("/proc/kpagecount", O_RDONLY);
+    if (kt->flags_fd < 0 || kt->count_fd < 0) {
+        if (kt->flags_fd >= 0) {
+            close(kt->flags_fd);
+        }
+        if (kt->count_fd >= 0) {
+            close(kt->count_fd);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+void kpage_close(KpageTable *kt) {
+    for (size_t i = 0; i < kt->num_chunks; i++) {
+        free(kt->flags[i]);
+        free(kt->count[i]);
+    }
+    free(kt->flags);
+    free(kt->count);
+    close(kt->flags_fd);
+    close(kt->count_fd);
+}
+
+// 查询物理页的标志和映射次数，失败返回-1
+int kpage_lookup(KpageTable *kt, uint64_t pfn, uint64_t *flags, uint64_t *count) {
+    size_t chunk = pfn / KPAGE_CHUNK;
+
+    if (chunk >= kt->num_chunks) {
+        size_t n = kt->num_chunks > 0 ? kt->num_chunks : 1024;
+        while (n <= chunk) {
+            n *= 2;
+        }
+        kt->flags = realloc(kt->flags, n * sizeof(uint64_t*));
+        kt->count = realloc(kt->count, n * sizeof(uint64_t*));
+        memset(kt->flags + kt->num_chunks, 0, (n - kt->num_chunks) * sizeof(uint64_t*));
+        memset(kt->count + kt->num_chunks, 0, (n - kt->num_chunks) * sizeof(uint64_t*));
+        kt->num_chunks = n;
+    }
+    if (kt->flags[chunk] == NULL) {
+        off_t offset = (off_t)chunk * KPAGE_CHUNK * sizeof(uint64_t);
+        kt->flags[chunk] = calloc(KPAGE_CHUNK, sizeof(uint64_t));
+        kt->count[chunk] = calloc(KPAGE_CHUNK, sizeof(uint64_t));
+        // 物理内存末尾的块可能读不满，未读到的部分保持为0
+        if (pread(kt->flags_fd, kt->flags[chunk], KPAGE_CHUNK * sizeof(uint64_t), offset) < 0 ||
+            pread(kt->count_fd, kt->count[chunk], KPAGE_CHUNK * sizeof(uint64_t), offset) < 0) {
+            free(kt->flags[chunk]);
+            free(kt->count[chunk]);
+            kt->flags[chunk] = NULL;
+            kt->count[chunk] = NULL;
+            return -1;
+        }
+        kt->reads += 2;
+    }
+    *flags = kt->flags[chunk][pfn % KPAGE_CHUNK];
+    *count = kt->count[chunk][pfn % KPAGE_CHUNK];
+    return 0;
+}
+
 // 打印地址信息
 void print_info(const char *name, void *addr, pid_t pid) {
     uint64_t vaddr = (uint64_t)addr;
@@ -135,11 +337,1672 @@ void run_default() {
     print_info("dummy_function", (void*)dummy_function, pid);
 }
 
+// ========== 模式3：批量转换一段虚拟地址 ==========
+#define RANGE_WINDOW (1 << 20)  // 每轮转换的页数，结果数组大小固定（9MB），与区间长度无关
+
+// 解析 START-END 或 START+LEN（十六进制需带0x前缀），END不含
+int parse_range(const char *spec, uint64_t *start, uint64_t *end) {
+    char *p;
+    *start = strtoull(spec, &p, 0);
+    if (*p == '-') {
+        *end = strtoull(p + 1, &p, 0);
+    } else if (*p == '+') {
+        *end = *start + strtoull(p + 1, &p, 0);
+    } else if (*p == '\0') {
+        *end = *start + 1;
+    } else {
+        return -1;
+    }
+    return *p == '\0' && *end > *start ? 0 : -1;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void run_range(pid_t pid, uint64_t start, uint64_t end, int verbose) {
+    Pagemap pm;
+    if (pagemap_open(&pm, pid) < 0) {
+        perror("open pagemap");
+        exit(1);
+    }
+
+    uint64_t *pfn = malloc(RANGE_WINDOW * sizeof(uint64_t));
+    uint8_t *flags = malloc(RANGE_WINDOW);
+    if (pfn == NULL || flags == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    uint64_t first = start / page_size;
+    uint64_t last = (end + page_size - 1) / page_size;
+    uint64_t pages = 0, present = 0, swapped = 0, file = 0, exclusive = 0, soft_dirty = 0;
+    double t0 = now_seconds();
+
+    printf("[Mode 3] Translating 0x%lx-0x%lx of process %d\n\n", first * page_size,
+           last * page_size, (int)pid);
+    for (uint64_t page = first; page < last; page += RANGE_WINDOW) {
+        size_t count = last - page < RANGE_WINDOW ? last - page : RANGE_WINDOW;
+        long n = pagemap_translate(&pm, page * page_size, count, pfn, flags);
+        if (n < 0) {
+            break;
+        }
+        for (long i = 0; i < n; i++) {
+            present += (flags[i] & PAGE_PRESENT) != 0;
+            swapped += (flags[i] & PAGE_SWAPPED) != 0;
+            file += (flags[i] & PAGE_FILE) != 0;
+            exclusive += (flags[i] & PAGE_EXCLUSIVE) != 0;
+            soft_dirty += (flags[i] & PAGE_SOFT_DIRTY) != 0;
+            if (verbose && (flags[i] & (PAGE_PRESENT | PAGE_SWAPPED))) {
+                printf("0x%016lx  pfn 0x%-10lx %s%s%s%s\n", (page + i) * page_size, pfn[i],
+                       (flags[i] & PAGE_SWAPPED) ? "swap " : "",
+                       (flags[i] & PAGE_FILE) ? "file " : "anon ",
+                       (flags[i] & PAGE_EXCLUSIVE) ? "excl " : "",
+                       (flags[i] & PAGE_SOFT_DIRTY) ? "soft-dirty" : "");
+            }
+        }
+        pages += n;
+        if ((size_t)n < count) {
+            break;
+        }
+    }
+    double elapsed = now_seconds() - t0;
+
+    if (verbose) {
+        printf("\n");
+    }
+    printf("Pages translated:  %lu (%lu MB)\n", pages, pages * page_size >> 20);
+    printf("Present in RAM:    %lu\n", present);
+    printf("Swapped:           %lu\n", swapped);
+    printf("File/shared:       %lu\n", file);
+    printf("Exclusive:         %lu\n", exclusive);
+    printf("Soft-dirty:        %lu\n", soft_dirty);
+    printf("Elapsed:           %.3f ms, %ld preads, %.1f Mpages/s\n", elapsed * 1e3, pm.reads,
+           elapsed > 0 ? pages / elapsed / 1e6 : 0);
+    if (present > 0 && pid != getpid() && geteuid() != 0) {
+        printf("Note: PFNs read as 0 without CAP_SYS_ADMIN\n");
+    }
+
+    free(pfn);
+    free(flags);
+    pagemap_close(&pm);
+}
+
+// ========== 模式4：整个进程的物理内存分布 ==========
+// 合并kpageflags/kpagecount后得到的分类标志，与pagemap_translate的PAGE_*标志放在同一个字节中
+#define PAGE_ANON       0x20
+#define PAGE_SHARED     0x40    // 被多个进程（或多处）映射
+#define PAGE_THP        0x80    // 透明大页的一部分
+
+// -o输出的二进制格式：MapHeader + num_records条MapRecord（小端），只记录在内存或交换区中的页面
+#define MAP_MAGIC "VTOPMAP"
+#define MAP_VERSION 1
+
+typedef struct {
+    char magic[8];          // "VTOPMAP\0"
+    uint32_t version;
+    uint32_t page_size;
+    uint64_t pid;
+    uint64_t num_records;
+} MapHeader;
+
+typedef struct {
+    uint64_t vaddr;
+    uint64_t pfn_class;     // 低55位为物理页号，最高8位为分类标志
+} MapRecord;
+
+// 一个区域或整个进程的统计（页数）
+typedef struct {
+    uint64_t present, anon, file, shared, thp, swapped;
+    uint64_t runs;          // 物理页号连续的段数，衡量物理上的连续程度
+} MapStats;
+
+// 用kpageflags/kpagecount补充分类。没有权限读这两个文件时（非root）只能用pagemap的标志近似
+static uint8_t classify_page(KpageTable *kt, uint64_t pfn, uint8_t flags) {
+    uint64_t kflags, kcount;
+
+    if (!(flags & PAGE_PRESENT)) {
+        return flags;
+    }
+    if (kt != NULL && pfn != 0 && kpage_lookup(kt, pfn, &kflags, &kcount) == 0) {
+        flags |= (kflags & (1ULL << KPF_ANON)) ? PAGE_ANON : 0;
+        flags |= (kflags & (1ULL << KPF_THP)) ? PAGE_THP : 0;
+        flags |= kcount > 1 ? PAGE_SHARED : 0;
+    } else {
+        flags |= (flags & PAGE_FILE) ? 0 : PAGE_ANON;
+        flags |= (flags & PAGE_EXCLUSIVE) ? 0 : PAGE_SHARED;
+    }
+    return flags;
+}
+
+static void print_map_row(const char *start, const char *end, const char *perms,
+                          const MapStats *st, const char *path) {
+    uint64_t kb = page_size / 1024;
+    printf("%-16s %-16s %-4s %9lu %9lu %9lu %9lu %9lu %9lu %7lu  %s\n", start, end, perms,
+           st->present * kb, st->anon * kb, st->file * kb, st->shared * kb, st->thp * kb,
+           st->swapped * kb, st->runs, path);
+}
+
+void run_map(pid_t pid, const char *out_path) {
+    Vma *vmas;
+    int num_vmas = read_maps(pid, &vmas);
+    if (num_vmas < 0) {
+        perror("open maps");
+        exit(1);
+    }
+
+    Pagemap pm;
+    if (pagemap_open(&pm, pid) < 0) {
+        perror("open pagemap");
+        exit(1);
+    }
+    KpageTable kpage;
+    KpageTable *kt = kpage_open(&kpage) == 0 ? &kpage : NULL;
+
+    FILE *out = NULL;
+    MapHeader header = { MAP_MAGIC, MAP_VERSION, (uint32_t)page_size, (uint64_t)pid, 0 };
+    if (out_path != NULL) {
+        out = fopen(out_path, "wb");
+        if (out == NULL) {
+            perror("open output");
+            exit(1);
+        }
+        fwrite(&header, sizeof(header), 1, out);
+    }
+
+    uint64_t *pfn = malloc(RANGE_WINDOW * sizeof(uint64_t));
+    uint8_t *flags = malloc(RANGE_WINDOW);
+    MapRecord *records = malloc(RANGE_WINDOW * sizeof(MapRecord));
+    if (pfn == NULL || flags == NULL || records == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    MapStats total;
+    memset(&total, 0, sizeof(total));
+    uint64_t virt_pages = 0;
+    double t0 = now_seconds();
+
+    printf("[Mode 4] Physical memory map of process %d (sizes in KB)\n\n", (int)pid);
+    printf("%-16s %-16s %-4s %9s %9s %9s %9s %9s %9s %7s  %s\n", "START", "END", "PERM",
+           "RSS", "ANON", "FILE", "SHARED", "THP", "SWAP", "RUNS", "PATH");
+    for (int v = 0; v < num_vmas; v++) {
+        MapStats st;
+        memset(&st, 0, sizeof(st));
+        uint64_t prev_pfn = 0;
+
+        for (uint64_t page = vmas[v].start / page_size; page < vmas[v].end / page_size;
+             page += RANGE_WINDOW) {
+            uint64_t last = vmas[v].end / page_size;
+            size_t count = last - page < RANGE_WINDOW ? last - page : RANGE_WINDOW;
+            long n = pagemap_translate(&pm, page * page_size, count, pfn, flags);
+            if (n <= 0) {
+                break;
+            }
+            size_t num_records = 0;
+            for (long i = 0; i < n; i++) {
+                uint8_t c = classify_page(kt, pfn[i], flags[i]);
+                if (c & PAGE_PRESENT) {
+                    st.present++;
+                    st.anon += (c & PAGE_ANON) != 0;
+                    st.file += (c & PAGE_ANON) == 0;
+                    st.shared += (c & PAGE_SHARED) != 0;
+                    st.thp += (c & PAGE_THP) != 0;
+                    st.runs += pfn[i] == 0 || pfn[i] != prev_pfn + 1;
+                    prev_pfn = pfn[i];
+                } else {
+                    prev_pfn = 0;
+                }
+                st.swapped += (c & PAGE_SWAPPED) != 0;
+                if (c & (PAGE_PRESENT | PAGE_SWAPPED)) {
+                    records[num_records].vaddr = (page + i) * page_size;
+                    records[num_records].pfn_class = pfn[i] | (uint64_t)c << 56;
+                    num_records++;
+                }
+            }
+            if (out != NULL) {
+                fwrite(records, sizeof(MapRecord), num_records, out);
+            }
+            header.num_records += num_records;
+            virt_pages += n;
+            if ((size_t)n < count) {
+                break;
+            }
+        }
+
+        char start[20], end[20];
+        snprintf(start, sizeof(start), "%lx", vmas[v].start);
+        snprintf(end, sizeof(end), "%lx", vmas[v].end);
+        print_map_row(start, end, vmas[v].perms, &st, vmas[v].path);
+        total.present += st.present;
+        total.anon += st.anon;
+        total.file += st.file;
+        total.shared += st.shared;
+        total.thp += st.thp;
+        total.swapped += st.swapped;
+        total.runs += st.runs;
+    }
+    double elapsed = now_seconds() - t0;
+    print_map_row("TOTAL", "", "", &total, "");
+
+    printf("\nVMAs:              %d (%lu MB virtual)\n", num_vmas, virt_pages * page_size >> 20);
+    printf("Resident:          %lu MB\n", total.present * page_size >> 20);
+    printf("THP coverage:      %.1f%% of anonymous memory\n",
+           total.anon > 0 ? 100.0 * total.thp / total.anon : 0);
+    printf("Physical runs:     %lu (avg %.1f pages per contiguous run)\n", total.runs,
+           total.runs > 0 ? (double)total.present / total.runs : 0);
+    printf("Elapsed:           %.3f ms, %ld pagemap preads, %ld kpage preads\n", elapsed * 1e3,
+           pm.reads, kt != NULL ? kt->reads : 0);
+    if (kt == NULL) {
+        printf("Note: /proc/kpageflags not readable, THP unknown and anon/shared from pagemap only\n");
+    }
+    if (out != NULL) {
+        fseek(out, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, out);
+        fclose(out);
+        printf("Wrote %lu records to %s\n", header.num_records, out_path);
+    }
+
+    free(pfn);
+    free(flags);
+    free(records);
+    free(vmas);
+    if (kt != NULL) {
+        kpage_close(kt);
+    }
+    pagemap_close(&pm);
+}
+
+// ========== 模式5：多个进程之间的共享物理页 ==========
+#define SCAN_WINDOW (1 << 16)   // 每个工作线程每轮转换的页数（结果数组约576KB）
+#define PAIR_MAX 2048           // 进程数不超过此值时统计每对进程之间的共享量
+#define TOP_SHOW 20             // 共享量排行显示的条数
+
+// 一个进程中在内存里的页面
+typedef struct {
+    uint64_t pfn;
+    uint32_t vma;           // 在该进程的vmas中的下标
+} ScanPage;
+
+typedef struct {
+    pid_t pid;
+    char comm[32];
+    Vma *vmas;
+    int num_vmas;
+    ScanPage *pages;
+    size_t num_pages;
+    size_t capacity;
+    int ok;
+    // 合并后的结果（页数）
+    uint64_t uss;           // 只被这个进程映射的页
+    double pss;             // 每页按映射它的进程数均摊
+} ScanProc;
+
+typedef struct {
+    ScanProc *procs;
+    int num_procs;
+    int next;               // 下一个待扫描的进程，各线程原子递增
+} ScanPool;
+
+// 扫描一个进程：转换所有区域，记录在内存中的页面及其所属区域
+static void scan_process(ScanProc *p) {
+    char path[64];
+    Pagemap pm;
+
+    snprintf(path, sizeof(path), "/proc/%d/comm", (int)p->pid);
+    FILE *fp = fopen(path, "r");
+    p->comm[0] = '\0';
+    if (fp != NULL) {
+        if (fgets(p->comm, sizeof(p->comm), fp) != NULL) {
+            p->comm[strcspn(p->comm, "\n")] = '\0';
+        }
+        fclose(fp);
+    }
+
+    p->num_vmas = read_maps(p->pid, &p->vmas);
+    if (p->num_vmas < 0 || pagemap_open(&pm, p->pid) < 0) {
+        return;
+    }
+
+    uint64_t *pfn = malloc(SCAN_WINDOW * sizeof(uint64_t));
+    uint8_t *flags = malloc(SCAN_WINDOW);
+    for (int v = 0; v < p->num_vmas; v++) {
+        uint64_t last = p->vmas[v].end / page_size;
+        for (uint64_t page = p->vmas[v].start / page_size; page < last; page += SCAN_WINDOW) {
+            size_t count = last - page < SCAN_WINDOW ? last - page : SCAN_WINDOW;
+            long n = pagemap_translate(&pm, page * page_size, count, pfn, flags);
+            if (n <= 0) {
+                break;
+            }
+            for (long i = 0; i < n; i++) {
+                // 没有CAP_SYS_ADMIN时物理页号读出为0，无法比较
+                if (!(flags[i] & PAGE_PRESENT) || pfn[i] == 0) {
+                    continue;
+                }
+                if (p->num_pages == p->capacity) {
+                    p->capacity = p->capacity > 0 ? p->capacity * 2 : 4096;
+                    p->pages = realloc(p->pages, p->capacity * sizeof(ScanPage));
+                }
+                p->pages[p->num_pages].pfn = pfn[i];
+                p->pages[p->num_pages].vma = (uint32_t)v;
+                p->num_pages++;
+            }
+            if ((size_t)n < count) {
+                break;
+            }
+        }
+    }
+    free(pfn);
+    free(flags);
+    pagemap_close(&pm);
+    p->ok = 1;
+}
+
+static void *scan_worker(void *arg) {
+    ScanPool *pool = arg;
+    for (;;) {
+        int k = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+        if (k >= pool->num_procs) {
+            break;
+        }
+        scan_process(&pool->procs[k]);
+    }
+    return NULL;
+}
+
+// 解析逗号分隔的PID列表，all表示/proc下除自身外的所有进程。返回进程数
+static int parse_pids(const char *spec, pid_t **pids) {
+    int count = 0, capacity = 64;
+    *pids = malloc(capacity * sizeof(pid_t));
+
+    if (strcmp(spec, "all") == 0) {
+        DIR *dir = opendir("/proc");
+        struct dirent *de;
+        if (dir == NULL) {
+            perror("opendir /proc");
+            return -1;
+        }
+        while ((de = readdir(dir)) != NULL) {
+            pid_t pid = (pid_t)atoi(de->d_name);
+            if (pid <= 0 || pid == getpid()) {
+                continue;
+            }
+            if (count == capacity) {
+                capacity *= 2;
+                *pids = realloc(*pids, capacity * sizeof(pid_t));
+            }
+            (*pids)[count++] = pid;
+        }
+        closedir(dir);
+        return count;
+    }
+
+    const char *p = spec;
+    while (*p != '\0') {
+        char *end;
+        long pid = strtol(p, &end, 10);
+        if (end == p || pid <= 0 || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            *pids = realloc(*pids, capacity * sizeof(pid_t));
+        }
+        (*pids)[count++] = (pid_t)pid;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+// 物理页号 -> 映射它的页面链表（全局下标）的开放寻址哈希表
+typedef struct {
+    uint64_t pfn;           // 0表示空槽
+    int64_t head;
+} PfnSlot;
+
+static inline uint64_t hash_pfn(uint64_t pfn) {
+    pfn ^= pfn >> 33;
+    pfn *= 0xff51afd7ed558ccdULL;
+    pfn ^= pfn >> 33;
+    return pfn;
+}
+
+// 映射名（文件路径，匿名区域为[anon]）及其共享统计
+typedef struct {
+    char *name;
+    uint64_t shared_pages;  // 被两个以上进程映射的不同物理页数
+    uint64_t saved_pages;   // 共享省下的页数：每页（映射的进程数 - 1）
+} ScanMapping;
+
+// 映射名 -> maps下标的开放寻址哈希表（-1表示空槽）。装填率不超过一半，
+// maps与槽位同时扩容，容量为槽位数的一半
+typedef struct {
+    int *slots;
+    size_t capacity;
+} MappingIndex;
+
+static uint64_t hash_name(const char *name) {
+    uint64_t h = 0xcbf29ce484222325ULL;     // FNV-1a
+    for (const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++) {
+        h = (h ^ *c) * 0x100000001b3ULL;
+    }
+    return hash_pfn(h);
+}
+
+static size_t mapping_slot(const MappingIndex *index, const ScanMapping *maps, const char *name) {
+    size_t s = hash_name(name) & (index->capacity - 1);
+    while (index->slots[s] >= 0 && strcmp(maps[index->slots[s]].name, name) != 0) {
+        s = (s + 1) & (index->capacity - 1);
+    }
+    return s;
+}
+
+static int mapping_id(ScanMapping **maps, int *num_maps, MappingIndex *index, const char *name) {
+    if ((size_t)(*num_maps + 1) * 2 > index->capacity) {
+        MappingIndex grown = { NULL, index->capacity > 0 ? index->capacity * 2 : 256 };
+        grown.slots = malloc(grown.capacity * sizeof(int));
+        for (size_t i = 0; i < grown.capacity; i++) {
+            grown.slots[i] = -1;
+        }
+        for (int i = 0; i < *num_maps; i++) {
+            grown.slots[mapping_slot(&grown, *maps, (*maps)[i].name)] = i;
+        }
+        free(index->slots);
+        *index = grown;
+        *maps = realloc(*maps, index->capacity / 2 * sizeof(ScanMapping));
+    }
+    size_t s = mapping_slot(index, *maps, name);
+    if (index->slots[s] >= 0) {
+        return index->slots[s];
+    }
+    (*maps)[*num_maps].name = strdup(name);
+    (*maps)[*num_maps].shared_pages = 0;
+    (*maps)[*num_maps].saved_pages = 0;
+    index->slots[s] = *num_maps;
+    return (*num_maps)++;
+}
+
+typedef struct {
+    int a, b;
+    uint64_t pages;
+} ScanPair;
+
+// 按共享页数的最小堆，保留共享最多的TOP_SHOW对
+static void pair_heap_swap(ScanPair *heap, size_t i, size_t j) {
+    ScanPair t = heap[i];
+    heap[i] = heap[j];
+    heap[j] = t;
+}
+
+static void pair_heap_push(ScanPair *heap, size_t *n, ScanPair pair) {
+    size_t i = (*n)++;
+    heap[i] = pair;
+    while (i > 0 && heap[(i - 1) / 2].pages > heap[i].pages) {
+        pair_heap_swap(heap, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void pair_heap_replace_min(ScanPair *heap, size_t n, ScanPair pair) {
+    size_t i = 0;
+    heap[0] = pair;
+    for (;;) {
+        size_t smallest = i, l = 2 * i + 1, r = l + 1;
+        if (l < n && heap[l].pages < heap[smallest].pages) {
+            smallest = l;
+        }
+        if (r < n && heap[r].pages < heap[smallest].pages) {
+            smallest = r;
+        }
+        if (smallest == i) {
+            break;
+        }
+        pair_heap_swap(heap, i, smallest);
+        i = smallest;
+    }
+}
+
+static int cmp_pair(const void *x, const void *y) {
+    const ScanPair *a = x, *b = y;
+    return a->pages < b->pages ? 1 : a->pages > b->pages ? -1 : 0;
+}
+
+static int cmp_mapping(const void *x, const void *y) {
+    const ScanMapping *a = x, *b = y;
+    return a->saved_pages < b->saved_pages ? 1 : a->saved_pages > b->saved_pages ? -1 : 0;
+}
+
+void run_shared_scan(const char *pid_spec, int num_threads) {
+    pid_t *pids;
+    int num_procs = parse_pids(pid_spec, &pids);
+    if (num_procs <= 0) {
+        fprintf(stderr, "Error: no processes to scan (PID list: %s)\n", pid_spec);
+        exit(1);
+    }
+
+    ScanProc *procs = calloc(num_procs, sizeof(ScanProc));
+    for (int i = 0; i < num_procs; i++) {
+        procs[i].pid = pids[i];
+    }
+    free(pids);
+
+    // 阶段1：每个进程由一个工作线程独立扫描
+    double t0 = now_seconds();
+    ScanPool pool = { procs, num_procs, 0 };
+    if (num_threads > num_procs) {
+        num_threads = num_procs;
+    }
+    pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+    int started = 0;
+    while (started < num_threads &&
+           pthread_create(&threads[started], NULL, scan_worker, &pool) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        scan_worker(&pool);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    double t_scan = now_seconds() - t0;
+
+    // 阶段2：把所有页面按物理页号链入哈希表
+    size_t total = 0;
+    int scanned = 0;
+    for (int i = 0; i < num_procs; i++) {
+        total += procs[i].num_pages;
+        scanned += procs[i].ok;
+    }
+    if (scanned == 0) {
+        fprintf(stderr, "Error: none of the processes could be scanned (%s)\n", pid_spec);
+        exit(1);
+    }
+    if (total == 0) {
+        fprintf(stderr, "Error: no physical pages found (PFNs need CAP_SYS_ADMIN)\n");
+        exit(1);
+    }
+    size_t capacity = 1;
+    while (capacity < total * 2) {
+        capacity *= 2;
+    }
+    PfnSlot *table = calloc(capacity, sizeof(PfnSlot));
+    int64_t *next = malloc(total * sizeof(int64_t));
+    int32_t *owner = malloc(total * sizeof(int32_t));  // 全局下标 -> 进程
+    size_t base = 0, distinct = 0;
+    for (int p = 0; p < num_procs; p++) {
+        for (size_t i = 0; i < procs[p].num_pages; i++) {
+            uint64_t pfn = procs[p].pages[i].pfn;
+            size_t s = hash_pfn(pfn) & (capacity - 1);
+            while (table[s].pfn != 0 && table[s].pfn != pfn) {
+                s = (s + 1) & (capacity - 1);
+            }
+            if (table[s].pfn == 0) {
+                table[s].pfn = pfn;
+                table[s].head = -1;
+                distinct++;
+            }
+            next[base + i] = table[s].head;
+            table[s].head = (int64_t)(base + i);
+            owner[base + i] = p;
+        }
+        base += procs[p].num_pages;
+    }
+
+    // 全局下标 -> 映射名
+    size_t *proc_base = malloc(num_procs * sizeof(size_t));
+    ScanMapping *maps = NULL;
+    int num_maps = 0;
+    MappingIndex map_index = { NULL, 0 };
+    int **vma_map = malloc(num_procs * sizeof(int*));
+    base = 0;
+    for (int p = 0; p < num_procs; p++) {
+        proc_base[p] = base;
+        base += procs[p].num_pages;
+        vma_map[p] = malloc((procs[p].num_vmas > 0 ? procs[p].num_vmas : 1) * sizeof(int));
+        for (int v = 0; v < procs[p].num_vmas; v++) {
+            const char *name = procs[p].vmas[v].path[0] != '\0' ? procs[p].vmas[v].path : "[anon]";
+            vma_map[p][v] = mapping_id(&maps, &num_maps, &map_index, name);
+        }
+    }
+
+    // 阶段3：逐个物理页统计映射它的不同进程
+    int *stamp = malloc(num_procs * sizeof(int));
+    int *members = malloc(num_procs * sizeof(int));
+    for (int p = 0; p < num_procs; p++) {
+        stamp[p] = -1;
+    }
+    uint64_t *pairs = num_procs <= PAIR_MAX ? calloc((size_t)num_procs * num_procs, sizeof(uint64_t)) : NULL;
+    uint64_t total_rss = 0;
+    int *last_map = malloc(num_maps * sizeof(int));
+    for (int m = 0; m < num_maps; m++) {
+        last_map[m] = -1;
+    }
+    for (size_t s = 0, id = 0; s < capacity; s++) {
+        if (table[s].pfn == 0) {
+            continue;
+        }
+        int k = 0;
+        for (int64_t g = table[s].head; g >= 0; g = next[g]) {
+            int p = owner[g];
+            if (stamp[p] != (int)id) {
+                stamp[p] = (int)id;
+                members[k++] = p;
+            }
+        }
+        total_rss += k;
+        for (int i = 0; i < k; i++) {
+            procs[members[i]].pss += 1.0 / k;
+            if (k == 1) {
+                procs[members[i]].uss++;
+            }
+        }
+        if (k > 1) {
+            // 同一物理页在不同进程中可能属于不同映射名，每个映射名只计一次
+            for (int64_t g = table[s].head; g >= 0; g = next[g]) {
+                int p = owner[g];
+                int m = vma_map[p][procs[p].pages[g - proc_base[p]].vma];
+                if (last_map[m] != (int)id) {
+                    last_map[m] = (int)id;
+                    maps[m].shared_pages++;
+                    maps[m].saved_pages += k - 1;
+                }
+            }
+            if (pairs != NULL) {
+                for (int i = 0; i < k; i++) {
+                    for (int j = i + 1; j < k; j++) {
+                        int a = members[i] < members[j] ? members[i] : members[j];
+                        int b = members[i] < members[j] ? members[j] : members[i];
+                        pairs[(size_t)a * num_procs + b]++;
+                    }
+                }
+            }
+        }
+        id++;
+    }
+    double elapsed = now_seconds() - t0;
+
+    uint64_t kb = page_size / 1024;
+    printf("[Mode 5] Shared physical pages across %d processes (%d scanned, sizes in KB)\n\n",
+           num_procs, scanned);
+    printf("%8s %-16s %10s %10s %10s %10s\n", "PID", "COMM", "RSS", "PSS", "USS", "SHARED");
+    for (int p = 0; p < num_procs; p++) {
+        if (procs[p].num_pages == 0) {
+            continue;
+        }
+        printf("%8d %-16s %10lu %10.0f %10lu %10lu\n", (int)procs[p].pid, procs[p].comm,
+               procs[p].num_pages * kb, procs[p].pss * kb, procs[p].uss * kb,
+               (procs[p].num_pages - procs[p].uss) * kb);
+    }
+
+    qsort(maps, num_maps, sizeof(ScanMapping), cmp_mapping);
+    printf("\nTop shared mappings:\n%10s %10s  %s\n", "SHARED", "SAVED", "MAPPING");
+    for (int m = 0; m < num_maps && m < TOP_SHOW && maps[m].saved_pages > 0; m++) {
+        printf("%10lu %10lu  %s\n", maps[m].shared_pages * kb, maps[m].saved_pages * kb,
+               maps[m].name);
+    }
+
+    if (pairs != NULL) {
+        size_t num_pairs = 0;
+        ScanPair *top = malloc(TOP_SHOW * sizeof(ScanPair));
+        for (int a = 0; a < num_procs; a++) {
+            for (int b = a + 1; b < num_procs; b++) {
+                uint64_t n = pairs[(size_t)a * num_procs + b];
+                if (n == 0) {
+                    continue;
+                }
+                if (num_pairs < TOP_SHOW) {
+                    pair_heap_push(top, &num_pairs, (ScanPair){ a, b, n });
+                } else if (n > top[0].pages) {
+                    pair_heap_replace_min(top, num_pairs, (ScanPair){ a, b, n });
+                }
+            }
+        }
+        qsort(top, num_pairs, sizeof(ScanPair), cmp_pair);
+        printf("\nTop process pairs:\n%10s  %s\n", "SHARED", "PROCESSES");
+        for (size_t i = 0; i < num_pairs; i++) {
+            printf("%10lu  %d (%s) <-> %d (%s)\n", top[i].pages * kb,
+                   (int)procs[top[i].a].pid, procs[top[i].a].comm,
+                   (int)procs[top[i].b].pid, procs[top[i].b].comm);
+        }
+        free(top);
+    } else if (num_procs > PAIR_MAX) {
+        printf("\nTop process pairs: skipped, %d processes exceed the limit of %d "
+               "(the pair table would need %lu MB)\n", num_procs, PAIR_MAX,
+               (unsigned long)((uint64_t)num_procs * num_procs * sizeof(uint64_t) >> 20));
+    } else {
+        printf("\nTop process pairs: skipped, cannot allocate the pair table for %d processes\n",
+               num_procs);
+    }
+
+    printf("\nSum of RSS:        %lu MB\n", total_rss * kb >> 10);
+    printf("Physical footprint: %lu MB (distinct pages, = sum of PSS)\n", distinct * kb >> 10);
+    printf("Elapsed:           %.3f s (scan %.3f s, %d worker threads)\n", elapsed, t_scan,
+           started > 0 ? started : 1);
+
+    for (int p = 0; p < num_procs; p++) {
+        free(procs[p].vmas);
+        free(procs[p].pages);
+        free(vma_map[p]);
+    }
+    for (int m = 0; m < num_maps; m++) {
+        free(maps[m].name);
+    }
+    free(procs);
+    free(table);
+    free(next);
+    free(owner);
+    free(proc_base);
+    free(maps);
+    free(map_index.slots);
+    free(vma_map);
+    free(stamp);
+    free(members);
+    free(pairs);
+    free(last_map);
+}
+
+// ========== 模式6：工作集估计 ==========
+// 每个采样间隔开始时把目标进程驻留的LRU页面标记为空闲，间隔结束时读回：空闲标记被内核
+// 清除的页面在这段时间里被访问过。没有page_idle或读不了kpageflags时依次退回：
+//   soft-dirty：写clear_refs "4"清除软脏位，间隔结束时pagemap中重新置位的页面被写过
+//               （看不到只读访问）
+//   referenced：写clear_refs "1"清除页表访问位，间隔结束时读smaps的Referenced
+//               （只有每个区域的总量，没有逐页热度）
+#define IDLE_BITMAP "/sys/kernel/mm/page_idle/bitmap"
+#define IDLE_MAX_RUN 512        // 一次pread/pwrite最多的64位字数（4KB，覆盖32768个物理页）
+#define WS_BUCKETS 5            // 热度直方图：被访问的间隔占0、≤25%、≤50%、≤75%、≤100%
+
+enum { WS_IDLE, WS_SOFT_DIRTY, WS_REFERENCED };
+
+typedef struct {
+    uint64_t vpn;
+    uint64_t pfn;
+    uint8_t flags;
+    uint8_t tail;           // 复合页（THP）的尾页：空闲标记只记在头页上
+} WsPage;
+
+// 虚拟页号 -> 被访问过的间隔数的开放寻址哈希表
+typedef struct {
+    uint64_t *keys;         // vpn + 1，0表示空槽
+    uint32_t *counts;
+    size_t capacity;
+    size_t size;
+} WsCounter;
+
+static uint32_t *ws_slot(WsCounter *c, uint64_t vpn, int insert) {
+    if (insert && (c->size + 1) * 2 > c->capacity) {
+        WsCounter grown = { NULL, NULL, c->capacity > 0 ? c->capacity * 2 : 1 << 16, 0 };
+        grown.keys = calloc(grown.capacity, sizeof(uint64_t));
+        grown.counts = calloc(grown.capacity, sizeof(uint32_t));
+        for (size_t i = 0; i < c->capacity; i++) {
+            if (c->keys[i] != 0) {
+                *ws_slot(&grown, c->keys[i] - 1, 1) = c->counts[i];
+            }
+        }
+        free(c->keys);
+        free(c->counts);
+        *c = grown;
+    }
+    if (c->capacity == 0) {
+        return NULL;
+    }
+    size_t s = hash_pfn(vpn) & (c->capacity - 1);
+    while (c->keys[s] != 0 && c->keys[s] != vpn + 1) {
+        s = (s + 1) & (c->capacity - 1);
+    }
+    if (c->keys[s] == 0) {
+        if (!insert) {
+            return NULL;
+        }
+        c->keys[s] = vpn + 1;
+        c->size++;
+    }
+    return &c->counts[s];
+}
+
+// 收集目标进程当前驻留的页面（按虚拟地址排序）。kt非空时只保留空闲页跟踪覆盖的页面：
+// 位图对LRU以外的页面（零页、vDSO等）忽略写入、读回0，会被当成每个间隔都访问过。
+// 旧内核的THP尾页不带LRU标志，它们的结果取自头页，照样保留并标出
+static size_t ws_collect(Pagemap *pm, const Vma *vmas, int num_vmas, KpageTable *kt,
+                         WsPage **pages, size_t *capacity, uint64_t *pfn, uint8_t *flags) {
+    size_t count = 0;
+
+    for (int v = 0; v < num_vmas; v++) {
+        uint64_t last = vmas[v].end / page_size;
+        for (uint64_t page = vmas[v].start / page_size; page < last; page += SCAN_WINDOW) {
+            size_t n = last - page < SCAN_WINDOW ? last - page : SCAN_WINDOW;
+            long got = pagemap_translate(pm, page * page_size, n, pfn, flags);
+            if (got <= 0) {
+                break;
+            }
+            for (long i = 0; i < got; i++) {
+                if (!(flags[i] & PAGE_PRESENT)) {
+                    continue;
+                }
+                uint64_t kflags = 0, kcount;
+                if (kt != NULL) {
+                    if (pfn[i] == 0 || kpage_lookup(kt, pfn[i], &kflags, &kcount) < 0) {
+                        continue;
+                    }
+                    int tail = (kflags & (1ULL << KPF_COMPOUND_TAIL)) &&
+                               (kflags & (1ULL << KPF_THP));
+                    if (!(kflags & (1ULL << KPF_LRU)) && !tail) {
+                        continue;
+                    }
+                    if (kflags & (1ULL << KPF_ZERO_PAGE)) {
+                        continue;
+                    }
+                }
+                if (count == *capacity) {
+                    *capacity = *capacity > 0 ? *capacity * 2 : 4096;
+                    *pages = realloc(*pages, *capacity * sizeof(WsPage));
+                }
+                (*pages)[count].vpn = page + i;
+                (*pages)[count].pfn = pfn[i];
+                (*pages)[count].flags = flags[i];
+                (*pages)[count].tail = (kflags & (1ULL << KPF_COMPOUND_TAIL)) != 0;
+                count++;
+            }
+            if ((size_t)got < n) {
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+static int cmp_ws_pfn(const void *x, const void *y) {
+    const WsPage *a = x, *b = y;
+    return a->pfn < b->pfn ? -1 : a->pfn > b->pfn;
+}
+
+static int cmp_ws_vpn(const void *x, const void *y) {
+    const WsPage *a = x, *b = y;
+    return a->vpn < b->vpn ? -1 : a->vpn > b->vpn;
+}
+
+// 对按物理页号排序的页面分段访问空闲位图，每段内连续的64位字合在一次pread/pwrite里。
+// write为真时把这些页面标记为空闲；否则读回位图，被访问过（空闲位已清除）的页面
+// accessed置1。尾页沿用头页的结果：只有从头页起物理页号连续（同一个复合页）时才能确认
+// 头页在集合中，否则按未访问处理。返回系统调用次数，出错返回-1
+static long idle_bitmap_io(int fd, const WsPage *pages, size_t n, uint8_t *accessed, int write) {
+    uint64_t words[IDLE_MAX_RUN];
+    long calls = 0;
+    uint8_t head_accessed = 0;
+    uint64_t chain_end = 0;     // 当前复合页从头页起连续出现的最后一个物理页号（0表示没有）
+    size_t i = 0;
+
+    while (i < n && pages[i].pfn == 0) {
+        if (!write) {
+            accessed[i] = 0;
+        }
+        i++;
+    }
+    while (i < n) {
+        uint64_t first_word = pages[i].pfn / 64;
+        size_t j = i;
+        while (j < n && pages[j].pfn / 64 < first_word + IDLE_MAX_RUN) {
+            j++;
+        }
+        size_t num_words = pages[j - 1].pfn / 64 - first_word + 1;
+        off_t offset = (off_t)(first_word * sizeof(uint64_t));
+
+        if (write) {
+            memset(words, 0, num_words * sizeof(uint64_t));
+            for (size_t k = i; k < j; k++) {
+                words[pages[k].pfn / 64 - first_word] |= 1ULL << (pages[k].pfn % 64);
+            }
+            if (pwrite(fd, words, num_words * sizeof(uint64_t), offset) < 0) {
+                return -1;
+            }
+        } else {
+            if (pread(fd, words, num_words * sizeof(uint64_t), offset) < 0) {
+                return -1;
+            }
+            for (size_t k = i; k < j; k++) {
+                if (!pages[k].tail) {
+                    uint64_t word = words[pages[k].pfn / 64 - first_word];
+                    head_accessed = !(word & (1ULL << (pages[k].pfn % 64)));
+                    chain_end = pages[k].pfn;
+                } else if (chain_end != 0 && pages[k].pfn <= chain_end + 1) {
+                    chain_end = pages[k].pfn;
+                } else {
+                    head_accessed = 0;
+                    chain_end = 0;
+                }
+                accessed[k] = head_accessed;
+            }
+        }
+        calls++;
+        i = j;
+    }
+    return calls;
+}
+
+static int clear_refs(pid_t pid, const char *what) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/clear_refs", (int)pid);
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int ok = write(fd, what, strlen(what)) == (ssize_t)strlen(what);
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+// 内核没开CONFIG_MEM_SOFT_DIRTY时clear_refs "4"照样成功，pagemap的软脏位却永远为0。
+// 新建的映射总是软脏的，映射一页看看就知道
+static int soft_dirty_supported(void) {
+    char *probe = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                       -1, 0);
+    if (probe == MAP_FAILED) {
+        return 0;
+    }
+    probe[0] = 1;
+
+    Pagemap pm;
+    uint64_t pfn;
+    uint8_t flags = 0;
+    if (pagemap_open(&pm, getpid()) == 0) {
+        pagemap_translate(&pm, (uint64_t)(uintptr_t)probe, 1, &pfn, &flags);
+        pagemap_close(&pm);
+    }
+    munmap(probe, page_size);
+    return (flags & PAGE_SOFT_DIRTY) != 0;
+}
+
+// 选择采样方式：空闲页跟踪要靠kpageflags筛掉位图不覆盖的页面、标出THP尾页，两者都能
+// 打开时才使用，*kt返回打开的kpageflags，其余方式*idle_fd和*kt分别为-1和NULL
+static int ws_choose_method(int *idle_fd, KpageTable *kpage, KpageTable **kt) {
+    *kt = NULL;
+    *idle_fd = open(IDLE_BITMAP, O_RDWR);
+    if (*idle_fd >= 0) {
+        if (kpage_open(kpage) == 0) {
+            *kt = kpage;
+            return WS_IDLE;
+        }
+        close(*idle_fd);
+        *idle_fd = -1;
+    }
+    return soft_dirty_supported() ? WS_SOFT_DIRTY : WS_REFERENCED;
+}
+
+// 每个区域在各次采样中的统计（referenced方式）
+typedef struct {
+    Vma vma;
+    uint64_t rss_kb;        // 最后一次采样时驻留的大小
+    uint64_t ref_kb_sum;
+    uint64_t ref_kb_peak;
+} WsRegion;
+
+// 读一遍/proc/pid/smaps，把各区域的Rss和Referenced累加到*regions，返回所有区域
+// Referenced之和（KB），*rss_kb返回Rss之和。出错返回-1
+static int64_t ws_read_smaps(pid_t pid, WsRegion **regions, int *num_regions, uint64_t *rss_kb) {
+    char path[64];
+    char line[VMA_PATH_MAX + 128];
+    WsRegion *cur = NULL;
+    int64_t referenced = 0;
+    int hint = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/smaps", (int)pid);
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    *rss_kb = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        Vma v;
+        int path_pos = 0;
+        unsigned long kb;
+        if (sscanf(line, "%lx-%lx %4s %*s %*s %*s %n", &v.start, &v.end, v.perms,
+                   &path_pos) == 3) {
+            snprintf(v.path, sizeof(v.path), "%s", path_pos > 0 ? line + path_pos : "");
+            v.path[strcspn(v.path, "\n")] = '\0';
+            // 区域列表通常和上次一样，按顺序猜下一个，猜不中再整体查找
+            int r = hint < *num_regions && (*regions)[hint].vma.start == v.start ? hint : -1;
+            for (int i = 0; r < 0 && i < *num_regions; i++) {
+                if ((*regions)[i].vma.start == v.start && (*regions)[i].vma.end == v.end) {
+                    r = i;
+                }
+            }
+            if (r < 0) {
+                *regions = realloc(*regions, (*num_regions + 1) * sizeof(WsRegion));
+                r = (*num_regions)++;
+                (*regions)[r] = (WsRegion){ v, 0, 0, 0 };
+            }
+            (*regions)[r].vma = v;
+            (*regions)[r].rss_kb = 0;
+            cur = &(*regions)[r];
+            hint = r + 1;
+        } else if (cur != NULL && sscanf(line, "Rss: %lu kB", &kb) == 1) {
+            cur->rss_kb = kb;
+            *rss_kb += kb;
+        } else if (cur != NULL && sscanf(line, "Referenced: %lu kB", &kb) == 1) {
+            cur->ref_kb_sum += kb;
+            cur->ref_kb_peak = kb > cur->ref_kb_peak ? kb : cur->ref_kb_peak;
+            referenced += kb;
+        }
+    }
+    fclose(fp);
+    return referenced;
+}
+
+static void print_ws_region(const Vma *v) {
+    printf("%016lx-%016lx %-4s", (unsigned long)v->start, (unsigned long)v->end, v->perms);
+}
+
+void run_working_set(pid_t pid, int interval_ms, int samples) {
+    // 优先使用空闲页跟踪（需要root、CONFIG_IDLE_PAGE_TRACKING和kpageflags），其次soft-dirty，
+    // 最后是smaps的Referenced
+    static const char *method_names[] = {
+        "idle page tracking", "soft-dirty bits (writes only)",
+        "referenced bits from smaps (per VMA only)",
+    };
+    int idle_fd;
+    KpageTable kpage, *kt;
+    int method = ws_choose_method(&idle_fd, &kpage, &kt);
+    if (method != WS_IDLE && clear_refs(pid, method == WS_SOFT_DIRTY ? "4" : "1") < 0) {
+        fprintf(stderr, "Error: cannot open %s or write /proc/%d/clear_refs\n",
+                IDLE_BITMAP, (int)pid);
+        exit(1);
+    }
+
+    Pagemap pm;
+    if (pagemap_open(&pm, pid) < 0) {
+        perror("open pagemap");
+        exit(1);
+    }
+    uint64_t *pfn = malloc(SCAN_WINDOW * sizeof(uint64_t));
+    uint8_t *flags = malloc(SCAN_WINDOW);
+    Vma *vmas = NULL;
+    int num_vmas = 0;
+    WsPage *pages = NULL;
+    size_t capacity = 0, num_pages = 0;
+    uint8_t *accessed = NULL;
+    size_t accessed_capacity = 0;
+    WsCounter counter = { NULL, NULL, 0, 0 };
+    WsRegion *regions = NULL;
+    int num_regions = 0;
+    uint64_t total_wss = 0, peak_wss = 0;   // 页数
+    unsigned long kb = page_size / 1024;
+    double t_start = now_seconds();
+
+    printf("[Mode 6] Working set of process %d: %d samples of %d ms, using %s\n\n",
+           (int)pid, samples, interval_ms, method_names[method]);
+    printf("%8s %12s %12s %8s %10s %8s\n", "TIME(s)", "RESIDENT(MB)", "WSS(MB)", "WSS%",
+           "SCAN(ms)", "SYSCALLS");
+
+    for (int s = 0; s < samples; s++) {
+        double scan = 0;
+        long calls = 0;
+        uint64_t wss = 0;
+
+        if (method == WS_IDLE) {
+            // 标记：每次重新读maps和pagemap，跟上目标进程新映射和换出的页面
+            double t0 = now_seconds();
+            free(vmas);
+            num_vmas = read_maps(pid, &vmas);
+            if (num_vmas < 0) {
+                break;
+            }
+            num_pages = ws_collect(&pm, vmas, num_vmas, kt, &pages, &capacity, pfn, flags);
+            qsort(pages, num_pages, sizeof(WsPage), cmp_ws_pfn);
+            long writes = idle_bitmap_io(idle_fd, pages, num_pages, NULL, 1);
+            scan += now_seconds() - t0;
+
+            usleep(interval_ms * 1000);
+
+            t0 = now_seconds();
+            if (num_pages > accessed_capacity) {
+                accessed_capacity = num_pages;
+                accessed = realloc(accessed, accessed_capacity);
+            }
+            long reads = idle_bitmap_io(idle_fd, pages, num_pages, accessed, 0);
+            if (writes < 0 || reads < 0) {
+                perror("page_idle bitmap");
+                exit(1);
+            }
+            scan += now_seconds() - t0;
+            calls = writes + reads;
+        } else if (method == WS_SOFT_DIRTY) {
+            // 上一次clear_refs之后被写过的页面软脏位重新置位
+            usleep(interval_ms * 1000);
+
+            double t0 = now_seconds();
+            free(vmas);
+            num_vmas = read_maps(pid, &vmas);
+            if (num_vmas < 0) {
+                break;
+            }
+            num_pages = ws_collect(&pm, vmas, num_vmas, NULL, &pages, &capacity, pfn, flags);
+            if (num_pages > accessed_capacity) {
+                accessed_capacity = num_pages;
+                accessed = realloc(accessed, accessed_capacity);
+            }
+            for (size_t i = 0; i < num_pages; i++) {
+                accessed[i] = (pages[i].flags & PAGE_SOFT_DIRTY) != 0;
+            }
+            clear_refs(pid, "4");
+            scan += now_seconds() - t0;
+            calls = 1;
+        } else {
+            usleep(interval_ms * 1000);
+
+            double t0 = now_seconds();
+            uint64_t rss_kb;
+            int64_t referenced_kb = ws_read_smaps(pid, &regions, &num_regions, &rss_kb);
+            if (referenced_kb < 0) {
+                num_vmas = -1;
+                break;
+            }
+            clear_refs(pid, "1");
+            scan += now_seconds() - t0;
+            num_pages = rss_kb / kb;
+            wss = referenced_kb / kb;
+        }
+        calls += pm.reads;
+        pm.reads = 0;
+
+        for (size_t i = 0; method != WS_REFERENCED && i < num_pages; i++) {
+            if (accessed[i]) {
+                (*ws_slot(&counter, pages[i].vpn, 1))++;
+                wss++;
+            }
+        }
+        total_wss += wss;
+        peak_wss = wss > peak_wss ? wss : peak_wss;
+
+        printf("%8.1f %12.1f %12.1f %7.1f%% %10.2f ", now_seconds() - t_start,
+               (double)(num_pages * page_size) / (1 << 20), (double)(wss * page_size) / (1 << 20),
+               num_pages > 0 ? 100.0 * wss / num_pages : 0, scan * 1e3);
+        if (method == WS_REFERENCED) {
+            printf("%8s\n", "-");
+        } else {
+            printf("%8ld\n", calls);
+        }
+        fflush(stdout);
+    }
+    if (num_vmas < 0) {
+        fprintf(stderr, "Process %d exited\n", (int)pid);
+        exit(1);
+    }
+
+    if (method == WS_REFERENCED) {
+        // 没有逐页信息，只能给出每个区域被访问量的平均值和峰值
+        printf("\nReferenced KB per VMA:\n");
+        printf("%-38s %10s %10s %10s  %s\n", "RANGE", "RESIDENT", "AVG", "PEAK", "MAPPING");
+        for (int r = 0; r < num_regions; r++) {
+            if (regions[r].rss_kb == 0) {
+                continue;
+            }
+            print_ws_region(&regions[r].vma);
+            printf(" %10lu %10lu %10lu  %s\n", regions[r].rss_kb,
+                   regions[r].ref_kb_sum / samples, regions[r].ref_kb_peak,
+                   regions[r].vma.path[0] ? regions[r].vma.path : "[anon]");
+        }
+    } else {
+        // 热度直方图：最后一次采样时驻留的页面，按被访问过的间隔数所占比例分档
+        uint64_t (*hist)[WS_BUCKETS] = calloc(num_vmas, sizeof(*hist));
+        int v = 0;
+        qsort(pages, num_pages, sizeof(WsPage), cmp_ws_vpn);
+        for (size_t i = 0; i < num_pages; i++) {
+            while (pages[i].vpn >= vmas[v].end / page_size) {
+                v++;
+            }
+            uint32_t *c = ws_slot(&counter, pages[i].vpn, 0);
+            int bucket = c == NULL ? 0 : (int)((4ULL * *c + samples - 1) / samples);
+            hist[v][bucket]++;
+        }
+
+        printf("\nHotness per VMA (KB resident at the last sample, by share of samples accessed):\n");
+        printf("%-38s %10s %10s %10s %10s %10s  %s\n", "RANGE", "COLD", "<=25%", "<=50%",
+               "<=75%", "<=100%", "MAPPING");
+        for (v = 0; v < num_vmas; v++) {
+            uint64_t resident = 0;
+            for (int b = 0; b < WS_BUCKETS; b++) {
+                resident += hist[v][b];
+            }
+            if (resident == 0) {
+                continue;
+            }
+            print_ws_region(&vmas[v]);
+            printf(" %10lu %10lu %10lu %10lu %10lu  %s\n", hist[v][0] * kb, hist[v][1] * kb,
+                   hist[v][2] * kb, hist[v][3] * kb, hist[v][4] * kb,
+                   vmas[v].path[0] ? vmas[v].path : "[anon]");
+        }
+        free(hist);
+    }
+
+    printf("\nAverage WSS: %.1f MB, peak %.1f MB", (double)total_wss / samples * page_size / (1 << 20),
+           (double)(peak_wss * page_size) / (1 << 20));
+    if (method != WS_REFERENCED) {
+        printf(", %.1f MB accessed at least once", (double)(counter.size * page_size) / (1 << 20));
+    }
+    printf("\n");
+
+    if (kt != NULL) {
+        kpage_close(kt);
+    }
+    if (idle_fd >= 0) {
+        close(idle_fd);
+    }
+    pagemap_close(&pm);
+    free(pfn);
+    free(flags);
+    free(vmas);
+    free(pages);
+    free(accessed);
+    free(counter.keys);
+    free(counter.counts);
+    free(regions);
+}
+
+// ========== 模式7：NUMA节点分布与迁移 ==========
+// move_pages(2)的nodes参数为NULL时不迁移，只在status中返回每页所在的节点（页面不在内存中
+// 时为-ENOENT）。先用pagemap筛出驻留的页面再批量查询，避免对大片保留区逐页询问
+#define NUMA_BATCH 16384        // 每次move_pages查询/迁移的页数
+#define NUMA_MAX_NODES 64
+#define NUMA_HOT_PERCENT 50     // 只有smaps的Referenced可用时，被访问的比例达到该值的区域整体迁移
+
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)   // 只迁移只被这个进程映射的页面
+#endif
+
+typedef struct {
+    uint64_t pages[NUMA_MAX_NODES];
+    uint64_t other;             // 查不到节点的页面（如vdso、零页）
+    uint64_t moved;             // 迁移成功的页数
+} NumaStats;
+
+// 对一批地址调用move_pages；nodes为NULL时只查询。返回0成功，-1失败（原因见errno）
+static int numa_move_pages(pid_t pid, unsigned long count, void **addrs, const int *nodes,
+                           int *status, int flags) {
+    return syscall(SYS_move_pages, pid, count, addrs, nodes, status, flags) < 0 ? -1 : 0;
+}
+
+// 收集一个区域驻留的页面地址，返回页数。*addrs按需扩容
+static size_t numa_collect(Pagemap *pm, const Vma *v, void ***addrs, size_t *capacity,
+                           uint64_t *pfn, uint8_t *flags) {
+    size_t count = 0;
+    uint64_t last = v->end / page_size;
+
+    for (uint64_t page = v->start / page_size; page < last; page += SCAN_WINDOW) {
+        size_t n = last - page < SCAN_WINDOW ? last - page : SCAN_WINDOW;
+        long got = pagemap_translate(pm, page * page_size, n, pfn, flags);
+        if (got <= 0) {
+            break;
+        }
+        for (long i = 0; i < got; i++) {
+            if (!(flags[i] & PAGE_PRESENT)) {
+                continue;
+            }
+            if (count == *capacity) {
+                *capacity = *capacity > 0 ? *capacity * 2 : 4096;
+                *addrs = realloc(*addrs, *capacity * sizeof(void *));
+            }
+            (*addrs)[count++] = (void *)(uintptr_t)((page + i) * page_size);
+        }
+        if ((size_t)got < n) {
+            break;
+        }
+    }
+    return count;
+}
+
+static int cmp_u64(const void *x, const void *y) {
+    uint64_t a = *(const uint64_t *)x, b = *(const uint64_t *)y;
+    return a < b ? -1 : a > b;
+}
+
+// 采样一个间隔内被访问过的页面，*hot返回它们的虚拟页号（升序）。空闲页跟踪逐页记录
+// 读写，只含kt筛出的LRU页面；soft-dirty只记录写。返回页数，出错返回-1
+static long numa_sample_hot(pid_t pid, int method, int idle_fd, KpageTable *kt, int interval_ms,
+                            uint64_t **hot) {
+    Pagemap pm;
+    if (pagemap_open(&pm, pid) < 0) {
+        return -1;
+    }
+    uint64_t *pfn = malloc(SCAN_WINDOW * sizeof(uint64_t));
+    uint8_t *flags = malloc(SCAN_WINDOW);
+    Vma *vmas = NULL;
+    WsPage *pages = NULL;
+    size_t capacity = 0, num_pages = 0;
+    uint8_t *accessed = NULL;
+    int num_vmas;
+    long num_hot = -1;
+
+    if (method == WS_SOFT_DIRTY && clear_refs(pid, "4") < 0) {
+        goto out;
+    }
+    if (method == WS_IDLE) {
+        num_vmas = read_maps(pid, &vmas);
+        if (num_vmas < 0) {
+            goto out;
+        }
+        num_pages = ws_collect(&pm, vmas, num_vmas, kt, &pages, &capacity, pfn, flags);
+        qsort(pages, num_pages, sizeof(WsPage), cmp_ws_pfn);
+        if (idle_bitmap_io(idle_fd, pages, num_pages, NULL, 1) < 0) {
+            goto out;
+        }
+    }
+    usleep(interval_ms * 1000);
+    if (method == WS_IDLE) {
+        accessed = malloc(num_pages > 0 ? num_pages : 1);
+        if (idle_bitmap_io(idle_fd, pages, num_pages, accessed, 0) < 0) {
+            goto out;
+        }
+    } else {
+        // 采样结束时再读maps，采样期间新映射的页面也是新写入的
+        num_vmas = read_maps(pid, &vmas);
+        if (num_vmas < 0) {
+            goto out;
+        }
+        num_pages = ws_collect(&pm, vmas, num_vmas, NULL, &pages, &capacity, pfn, flags);
+        accessed = malloc(num_pages > 0 ? num_pages : 1);
+        for (size_t i = 0; i < num_pages; i++) {
+            accessed[i] = (pages[i].flags & PAGE_SOFT_DIRTY) != 0;
+        }
+    }
+
+    *hot = malloc((num_pages > 0 ? num_pages : 1) * sizeof(uint64_t));
+    num_hot = 0;
+    for (size_t i = 0; i < num_pages; i++) {
+        if (accessed[i]) {
+            (*hot)[num_hot++] = pages[i].vpn;
+        }
+    }
+    qsort(*hot, num_hot, sizeof(uint64_t), cmp_u64);
+
+out:
+    pagemap_close(&pm);
+    free(pfn);
+    free(flags);
+    free(vmas);
+    free(pages);
+    free(accessed);
+    return num_hot;
+}
+
+static int vpn_is_hot(const uint64_t *hot, size_t num_hot, uint64_t vpn) {
+    return bsearch(&vpn, hot, num_hot, sizeof(uint64_t), cmp_u64) != NULL;
+}
+
+// 查询一个区域的节点分布；target_node >= 0时把不在该节点上的页面迁移过去，hot非空时只迁移
+// 其中列出的页面，*moved返回迁移成功的页数。返回move_pages调用次数，出错返回-1
+static long numa_scan_vma(pid_t pid, void **addrs, size_t count, int *status, int *nodes,
+                          NumaStats *st, int target_node, const uint64_t *hot, size_t num_hot,
+                          uint64_t *moved) {
+    long calls = 0;
+
+    for (size_t i = 0; i < count; i += NUMA_BATCH) {
+        unsigned long n = count - i < NUMA_BATCH ? count - i : NUMA_BATCH;
+        if (numa_move_pages(pid, n, addrs + i, NULL, status, 0) < 0) {
+            if (errno != ENOSYS) {
+                return -1;
+            }
+            // 内核没开CONFIG_NUMA：所有内存都在节点0上，也无处可迁
+            st->pages[0] += n;
+            continue;
+        }
+        calls++;
+
+        // 把不在目标节点上的页面挪到批次前部，原地迁移
+        unsigned long to_move = 0;
+        for (unsigned long k = 0; k < n; k++) {
+            if (status[k] >= 0 && status[k] < NUMA_MAX_NODES) {
+                st->pages[status[k]]++;
+                if (target_node >= 0 && status[k] != target_node &&
+                    (hot == NULL ||
+                     vpn_is_hot(hot, num_hot, (uintptr_t)addrs[i + k] / page_size))) {
+                    addrs[i + to_move++] = addrs[i + k];
+                }
+            } else {
+                st->other++;
+            }
+        }
+        if (to_move == 0) {
+            continue;
+        }
+        for (unsigned long k = 0; k < to_move; k++) {
+            nodes[k] = target_node;
+        }
+        if (numa_move_pages(pid, to_move, addrs + i, nodes, status, MPOL_MF_MOVE) < 0) {
+            return -1;
+        }
+        calls++;
+        for (unsigned long k = 0; k < to_move; k++) {
+            *moved += status[k] == target_node;
+        }
+    }
+    return calls;
+}
+
+// 已上线的节点列表，如"0"或"0-1"
+static void read_online_nodes(char *buf, size_t size) {
+    FILE *fp = fopen("/sys/devices/system/node/online", "r");
+    if (fp == NULL || fgets(buf, (int)size, fp) == NULL) {
+        snprintf(buf, size, "0");
+    }
+    buf[strcspn(buf, "\n")] = '\0';
+    if (fp != NULL) {
+        fclose(fp);
+    }
+}
+
+static int cmp_region_referenced(const void *x, const void *y) {
+    const WsRegion *a = x, *b = y;
+    return a->ref_kb_sum < b->ref_kb_sum ? 1 : a->ref_kb_sum > b->ref_kb_sum ? -1 : 0;
+}
+
+void run_numa(pid_t pid, int target_node, int interval_ms) {
+    static const char *method_names[] = {
+        "idle page tracking", "soft-dirty bits (written pages only)",
+        "referenced bits from smaps (whole VMAs)",
+    };
+    char online[64];
+    read_online_nodes(online, sizeof(online));
+    unsigned long kb = page_size / 1024;
+
+    // 迁移时先采样一个间隔，只迁移这段时间里被访问过的页面，最热的区域先迁。方法的选择
+    // 同-w；只有smaps的Referenced时没有逐页信息，被访问比例足够高的区域才整体迁移
+    WsRegion *regions = NULL;
+    int num_regions = 0;
+    uint64_t rss_kb;
+    uint64_t *hot = NULL;
+    long num_hot = 0;
+    int method = WS_REFERENCED;
+    if (target_node >= 0) {
+        char node_path[64];
+        snprintf(node_path, sizeof(node_path), "/sys/devices/system/node/node%d", target_node);
+        if (access(node_path, F_OK) != 0) {
+            fprintf(stderr, "Error: node %d does not exist (online: %s)\n", target_node, online);
+            exit(1);
+        }
+        // 空闲页跟踪与-w一样只采样位图覆盖的LRU页面，否则零页、vDSO和THP尾页读回来都像
+        // 被访问过，会成为迁移对象
+        int idle_fd;
+        KpageTable kpage, *kt;
+        method = ws_choose_method(&idle_fd, &kpage, &kt);
+        if (method == WS_REFERENCED) {
+            if (clear_refs(pid, "1") < 0) {
+                perror("write clear_refs");
+                exit(1);
+            }
+            usleep(interval_ms * 1000);
+        } else {
+            num_hot = numa_sample_hot(pid, method, idle_fd, kt, interval_ms, &hot);
+            if (num_hot < 0) {
+                perror("sample accessed pages");
+                exit(1);
+            }
+        }
+        if (kt != NULL) {
+            kpage_close(kt);
+        }
+        if (idle_fd >= 0) {
+            close(idle_fd);
+        }
+    }
+    if (ws_read_smaps(pid, &regions, &num_regions, &rss_kb) < 0) {
+        perror("open smaps");
+        exit(1);
+    }
+    if (target_node >= 0) {
+        if (method != WS_REFERENCED) {
+            // 按采样到的页面重新计算各区域被访问的大小（smaps按地址顺序列出区域）
+            long h = 0;
+            for (int r = 0; r < num_regions; r++) {
+                uint64_t first = regions[r].vma.start / page_size;
+                uint64_t last = regions[r].vma.end / page_size;
+                while (h < num_hot && hot[h] < first) {
+                    h++;
+                }
+                regions[r].ref_kb_sum = 0;
+                for (; h < num_hot && hot[h] < last; h++) {
+                    regions[r].ref_kb_sum += kb;
+                }
+            }
+        }
+        qsort(regions, num_regions, sizeof(WsRegion), cmp_region_referenced);
+    }
+
+    Pagemap pm;
+    if (pagemap_open(&pm, pid) < 0) {
+        perror("open pagemap");
+        exit(1);
+    }
+
+    uint64_t *pfn = malloc(SCAN_WINDOW * sizeof(uint64_t));
+    uint8_t *flags = malloc(SCAN_WINDOW);
+    int *status = malloc(NUMA_BATCH * sizeof(int));
+    int *nodes = malloc(NUMA_BATCH * sizeof(int));
+    void **addrs = NULL;
+    size_t capacity = 0;
+    NumaStats *stats = calloc(num_regions > 0 ? num_regions : 1, sizeof(NumaStats));
+    NumaStats total = { { 0 }, 0, 0 };
+    uint64_t total_moved = 0, hot_pages = 0;
+    int max_node = 0;
+    long calls = 0;
+    double t0 = now_seconds();
+
+    for (int r = 0; r < num_regions; r++) {
+        size_t count = numa_collect(&pm, &regions[r].vma, &addrs, &capacity, pfn, flags);
+        int migrate = target_node >= 0 && regions[r].ref_kb_sum > 0;
+        if (migrate && method == WS_REFERENCED) {
+            migrate = regions[r].ref_kb_sum * 100 >= regions[r].rss_kb * NUMA_HOT_PERCENT;
+        }
+        long n = numa_scan_vma(pid, addrs, count, status, nodes, &stats[r],
+                               migrate ? target_node : -1, method == WS_REFERENCED ? NULL : hot,
+                               num_hot, &stats[r].moved);
+        if (n < 0) {
+            perror("move_pages");
+            exit(1);
+        }
+        calls += n;
+        if (migrate) {
+            hot_pages += method == WS_REFERENCED ? count : regions[r].ref_kb_sum / kb;
+        }
+        total_moved += stats[r].moved;
+        for (int k = 0; k < NUMA_MAX_NODES; k++) {
+            total.pages[k] += stats[r].pages[k];
+            max_node = stats[r].pages[k] > 0 && k > max_node ? k : max_node;
+        }
+        total.other += stats[r].other;
+    }
+    double elapsed = now_seconds() - t0;
+
+    printf("[Mode 7] NUMA placement of process %d (online nodes: %s), KB per node\n",
+           (int)pid, online);
+    if (target_node >= 0) {
+        printf("Accessed pages sampled over %d ms using %s\n", interval_ms, method_names[method]);
+    }
+    printf("\n");
+    printf("%-38s", "RANGE");
+    for (int k = 0; k <= max_node; k++) {
+        printf(" %9s%-2d", "NODE", k);
+    }
+    printf(" %10s%s  %s\n", "OTHER", target_node >= 0 ? "    REF(KB)   MOVED(KB)" : "",
+           "MAPPING");
+    for (int r = 0; r < num_regions; r++) {
+        uint64_t resident = stats[r].other;
+        for (int k = 0; k <= max_node; k++) {
+            resident += stats[r].pages[k];
+        }
+        if (resident == 0) {
+            continue;
+        }
+        print_ws_region(&regions[r].vma);
+        for (int k = 0; k <= max_node; k++) {
+            printf(" %11lu", stats[r].pages[k] * kb);
+        }
+        printf(" %10lu", stats[r].other * kb);
+        if (target_node >= 0) {
+            printf(" %11lu %11lu", regions[r].ref_kb_sum, stats[r].moved * kb);
+        }
+        printf("  %s\n", regions[r].vma.path[0] ? regions[r].vma.path : "[anon]");
+    }
+
+    uint64_t resident = total.other;
+    for (int k = 0; k <= max_node; k++) {
+        resident += total.pages[k];
+    }
+    printf("\nTotal:");
+    for (int k = 0; k <= max_node; k++) {
+        printf("  node%d %.1f MB (%.1f%%)", k, (double)(total.pages[k] * kb) / 1024,
+               resident > 0 ? 100.0 * total.pages[k] / resident : 0);
+    }
+    printf("  other %.1f MB\n", (double)(total.other * kb) / 1024);
+    if (target_node >= 0 && method == WS_REFERENCED) {
+        printf("Migrated %lu of %lu resident pages in VMAs with at least %d%% referenced to node %d "
+               "(pages already there or mapped by other processes stay)\n",
+               (unsigned long)total_moved, (unsigned long)hot_pages, NUMA_HOT_PERCENT, target_node);
+    } else if (target_node >= 0) {
+        printf("Migrated %lu of %lu accessed pages to node %d "
+               "(pages already there or mapped by other processes stay)\n",
+               (unsigned long)total_moved, (unsigned long)hot_pages, target_node);
+    }
+    printf("Elapsed: %.3f s, %ld pagemap reads, %ld move_pages calls\n", elapsed, pm.reads,
+           calls);
+
+    pagemap_close(&pm);
+    free(pfn);
+    free(flags);
+    free(status);
+    free(nodes);
+    free(addrs);
+    free(stats);
+    free(regions);
+    free(hot);
+}
+
 // ========== 主函数 ==========
 void show_usage(char *prog) {
-    printf("Usage: %s [-m MODE]\n", prog);
+    printf("Usage: %s [-m MODE] [-p PID] [-r RANGE [-v] | -a [-o FILE] | -w [-i MS] [-n N]\n"
+           "          | -N [-M NODE [-i MS]]] [-s PIDS [-j N]]\n", prog);
     printf("  -m 1 : Mode 1 - Same virtual address, different physical addresses (run twice)\n");
     printf("  -m 2 : Mode 2 - Shared library (printf) physical address (run twice)\n");
+    printf("  -r START-END | START+LEN : Mode 3 - Batch-translate a virtual range\n");
+    printf("         (-v lists every present or swapped page)\n");
+    printf("  -a : Mode 4 - Map every VMA to physical pages, classify them with\n");
+    printf("       /proc/kpageflags and /proc/kpagecount (THP, shared, anon, file, swap)\n");
+    printf("  -o FILE : With -a, also write per-page records in binary (VTOPMAP format)\n");
+    printf("  -w : Mode 6 - Estimate the working set: mark resident pages idle, sample which\n");
+    printf("       were accessed (page_idle bitmap, or soft-dirty bits when unavailable)\n");
+    printf("  -i MS : Sampling interval for -w and -M (default: 1000)\n");
+    printf("  -n N : Number of samples for -w (default: 5)\n");
+    printf("  -N : Mode 7 - NUMA node of every resident page (move_pages), per VMA\n");
+    printf("  -M NODE : Implies -N; migrate pages accessed during one interval to NODE\n");
+    printf("       (page_idle or soft-dirty; with only smaps, VMAs at least %d%% referenced)\n",
+           NUMA_HOT_PERCENT);
+    printf("  -p PID : Target process for -r/-a/-w/-N (default: this process)\n");
+    printf("  -s PID,PID,... | all : Mode 5 - Shared physical pages across processes:\n");
+    printf("       RSS/PSS/USS per process, shared bytes per mapping and per process pair\n");
+    printf("  -j N : Worker threads for -s (default: number of CPUs)\n");
     printf("  (no args): Default mode - show global var and function addresses\n");
 }
 
@@ -151,8 +2014,16 @@ int main(int argc, char *argv[]) {
     }
 
     int mode = 0;
+    pid_t pid = getpid();
+    uint64_t range_start = 0, range_end = 0;
+    int verbose = 0;
+    const char *out_path = NULL;
+    const char *pid_spec = NULL;
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int interval_ms = 1000, samples = 5;
+    int target_node = -1;
     int opt;
-    while ((opt = getopt(argc, argv, "m:h")) != -1) {
+    while ((opt = getopt(argc, argv, "m:p:r:vao:s:j:wi:n:NM:h")) != -1) {
         switch (opt) {
             case 'm':
                 mode = atoi(optarg);
@@ -161,6 +2032,68 @@ int main(int argc, char *argv[]) {
                     return 1;
                 }
                 break;
+            case 'p':
+                pid = (pid_t)atoi(optarg);
+                if (pid <= 0) {
+                    fprintf(stderr, "Error: invalid PID\n");
+                    return 1;
+                }
+                break;
+            case 'r':
+                if (parse_range(optarg, &range_start, &range_end) < 0) {
+                    fprintf(stderr, "Error: range must be START-END or START+LEN\n");
+                    return 1;
+                }
+                mode = 3;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'a':
+                mode = 4;
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 's':
+                pid_spec = optarg;
+                mode = 5;
+                break;
+            case 'j':
+                num_threads = atoi(optarg);
+                if (num_threads <= 0) {
+                    fprintf(stderr, "Error: thread count must be positive\n");
+                    return 1;
+                }
+                break;
+            case 'w':
+                mode = 6;
+                break;
+            case 'i':
+                interval_ms = atoi(optarg);
+                if (interval_ms <= 0) {
+                    fprintf(stderr, "Error: interval must be positive\n");
+                    return 1;
+                }
+                break;
+            case 'n':
+                samples = atoi(optarg);
+                if (samples <= 0) {
+                    fprintf(stderr, "Error: sample count must be positive\n");
+                    return 1;
+                }
+                break;
+            case 'N':
+                mode = 7;
+                break;
+            case 'M':
+                mode = 7;
+                target_node = atoi(optarg);
+                if (target_node < 0 || target_node >= NUMA_MAX_NODES) {
+                    fprintf(stderr, "Error: invalid node\n");
+                    return 1;
+                }
+                break;
             case 'h':
             default:
                 show_usage(argv[0]);
@@ -172,6 +2105,16 @@ int main(int argc, char *argv[]) {
         run_mode1();
     } else if (mode == 2) {
         run_mode2();
+    } else if (mode == 3) {
+        run_range(pid, range_start, range_end, verbose);
+    } else if (mode == 4) {
+        run_map(pid, out_path);
+    } else if (mode == 5) {
+        run_shared_scan(pid_spec, num_threads);
+    } else if (mode == 6) {
+        run_working_set(pid, interval_ms, samples);
+    } else if (mode == 7) {
+        run_numa(pid, target_node, interval_ms);
     } else {
         run_default();
     }